@@ -0,0 +1,209 @@
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "corpus.hpp"
+#include "tokenizer/tokenizer.hpp"
+
+namespace
+{
+
+const char *Words[] = {"reads", "the", "sensor", "port", "and", "scales", "result", "to", "millivolts", "before",
+                       "sending", "it", "out", "serial", "line", "at", "9600", "baud", "checks", "limits",
+                       "motor", "speed", "ramp", "timer", "loop", "button", "debounce", "state", "table", "lookup"};
+
+const int BitLimit = 150;   /* Bit variables allowed on top of the fixed ones (the BS2 has 26 bytes of RAM) */
+
+/* Generates one program; a fresh generator for each program keeps names and random choices repeatable */
+class TGenerator
+{
+public:
+  explicit TGenerator(const TCorpusSpec &ProgramSpec) : Spec(ProgramSpec), Random(ProgramSpec.Seed) {}
+
+  std::string Program(int *Units)
+  {
+    int Limit = (Spec.Size < MaxSourceSize - 64 ? Spec.Size : MaxSourceSize - 64);
+
+    Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\r";
+    Src += "' ==== Synthetic " + std::string(CorpusMixName(Spec.Mix)) + " program, seed " + std::to_string(Spec.Seed) + " ====\r";
+    Src += "idx     VAR Word\rval     VAR Byte\rcnt     VAR Nib\rflag    VAR Bit\r\rMain:\r";
+    for (*Units = 0; (int) Src.size() < Limit; )
+      {
+      size_t Mark = Src.size();
+      if ((Spec.Budget < 0) || (*Units < Spec.Budget))
+        {
+        Unit(Spec.Mix == cmMixed ? (TCorpusMix) Pick(cmMixed) : Spec.Mix);
+        (*Units)++;
+        }
+      else
+        Comment(Pick(60) + 40);
+      if ((int) Src.size() > Limit)
+        { /* Too big; stop short of the requested size */
+        Src.resize(Mark);
+        break;
+        }
+      }
+    Src += "END\r";
+    return Src;
+  }
+
+private:
+  const TCorpusSpec &Spec;
+  std::mt19937       Random;
+  std::string        Src;
+  int                Names = 0;
+  int                Bits = 0;
+
+  int Pick(int Count) { return (int) (Random() % (unsigned int) Count); }
+  std::string Name(const char *Prefix) { return Prefix + std::to_string(Names++); }
+  std::string Number(int Limit) { return std::to_string(Pick(Limit)); }
+
+  void Unit(TCorpusMix Mix)
+  {
+    switch (Mix)
+      {
+      case cmDebug        : Debug(); break;
+      case cmNesting      : Block(Pick(5) + 3, "  "); break;
+      case cmDeclarations : Declaration(); break;
+      case cmConditional  : Conditional(); break;
+      default             : if (Pick(3) == 0) Statement("", True); else Comment(Pick(100) + 40); break;
+      }
+  }
+
+  void Comment(int Length)
+  {
+    Src += "'";
+    while (Length > 0)
+      {
+      std::string Word = Words[Pick(sizeof(Words) / sizeof(Words[0]))];
+      Src += " " + Word;
+      Length -= (int) Word.size() + 1;
+      }
+    Src += "\r";
+  }
+
+  void Statement(const std::string &Indent, bool Remark)
+  {
+    static const char *Statements[] = {"val = val + 1", "idx = idx - val", "cnt = val // 10", "flag = ~flag",
+                                       "TOGGLE 3", "val = val * 3 / 2 MAX 200", "HIGH 5", "LOW 5"};
+    Src += Indent + Statements[Pick(sizeof(Statements) / sizeof(Statements[0]))];
+    if (Remark) { Src += "   "; Comment(Pick(40) + 10); } else Src += "\r";
+  }
+
+  void Debug()
+  {
+    switch (Pick(4))
+      {
+      case 0  : Src += "DEBUG \"Reading \", DEC val, \" of \", DEC5 idx, CR\r"; break;
+      case 1  : Src += "DEBUG HEX2 val, \" \", BIN8 val, \" \", SDEC idx, CR\r"; break;
+      case 2  : Src += "SEROUT 16, 84, [\"T:\", DEC3 val, \",\", HEX4 idx, CR]\r"; break;
+      default : Src += "DEBUG CLS, \"Step " + Number(1000) + "\", CR, \"flag=\", BIN1 flag, CR\r"; break;
+      }
+  }
+
+  void Block(int Depth, const std::string &Indent)
+  {
+    std::string Inner = Indent + "  ";
+    int Nested = Pick(3);
+
+    if (Pick(2) == 0)
+      {
+      Src += Indent + "IF val > " + Number(200) + " THEN\r";
+      Branch(Depth, Inner, Nested == 0);
+      Src += Indent + "ELSEIF val = " + Number(200) + " OR flag = 1 THEN\r";
+      Branch(Depth, Inner, Nested == 1);
+      Src += Indent + "ELSE\r";
+      Branch(Depth, Inner, Nested == 2);
+      Src += Indent + "ENDIF\r";
+      }
+    else
+      {
+      Src += Indent + "SELECT val\r";
+      Src += Indent + "  CASE " + Number(10) + "\r";
+      Branch(Depth, Inner + "  ", Nested == 0);
+      Src += Indent + "  CASE 20 TO " + std::to_string(Pick(100) + 21) + "\r";
+      Branch(Depth, Inner + "  ", Nested == 1);
+      Src += Indent + "  CASE ELSE\r";
+      Branch(Depth, Inner + "  ", Nested == 2);
+      Src += Indent + "ENDSELECT\r";
+      }
+  }
+
+  void Branch(int Depth, const std::string &Indent, bool Nest)
+  {
+    Statement(Indent, False);
+    if (Nest && (Depth > 1)) Block(Depth - 1, Indent);
+  }
+
+  void Declaration()
+  {
+    switch (Pick(6))
+      {
+      case 0  : Src += Name("Limit") + " CON " + Number(1000) + "\r"; break;
+      case 1  : Src += Name("Scale") + " CON " + Number(50) + " * 4 + " + Number(9) + "\r"; break;
+      case 2  : Src += Name("Alias") + (Pick(2) == 0 ? " VAR val\r" : " VAR idx.LOWBYTE\r"); break;
+      case 3  : if (Bits < BitLimit) { Src += Name("Ready") + " VAR Bit\r"; Bits++; }
+                else Src += Name("Level") + " CON " + Number(100) + "\r";
+                break;
+      case 4  : Src += Name("Table") + " DATA " + Number(256) + ", " + Number(256) + ", \"AB\"\r"; break;
+      default : Src += Name("Pin") + " PIN " + Number(16) + "\r"; break;
+      }
+  }
+
+  void Conditional()
+  {
+    std::string Option = Name("Option");
+
+    Src += "#DEFINE " + Option + " = " + Number(10) + "\r";
+    if (Pick(2) == 0)
+      {
+      Src += "#IF " + Option + " > 5 #THEN\r";
+      Statement("  ", False);
+      Src += "#ELSE\r";
+      Statement("  ", False);
+      Src += "#ENDIF\r";
+      }
+    else
+      {
+      Src += "#SELECT " + Option + "\r";
+      Src += "  #CASE 1, 2\r";
+      Statement("    ", False);
+      Src += "  #CASE 3 TO 6\r";
+      Statement("    ", False);
+      Src += "  #CASE #ELSE\r";
+      Statement("    ", False);
+      Src += "#ENDSELECT\r";
+      }
+  }
+};
+
+}  // namespace
+
+const char *CorpusMixName(TCorpusMix Mix)
+{
+  static const char *Names[cmNumElements] = {"debug", "nesting", "declarations", "conditional", "comments", "mixed"};
+  return Names[Mix];
+}
+
+std::string GenerateProgram(const TCorpusSpec &Spec)
+{
+  int Units;
+  return TGenerator(Spec).Program(&Units);
+}
+
+std::string GenerateCompilableProgram(TCorpusSpec Spec)
+{
+  auto Tokenizer = std::make_unique<tokenizer>();
+  auto Rec = std::make_unique<TModuleRec>();
+  int Units;
+
+  while (True)
+    {
+    std::string Src = TGenerator(Spec).Program(&Units);
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    if (Tokenizer->CompileView(Rec.get(), Src.data(), (int) Src.size(), False, True, NULL, NULL)) return Src;
+    if (Units == 0) return std::string();
+    Spec.Budget = Units * 3 / 4;
+    }
+}
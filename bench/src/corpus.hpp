@@ -0,0 +1,37 @@
+#ifndef __TOKENIZER_BENCH_CORPUS_H__
+#define __TOKENIZER_BENCH_CORPUS_H__
+
+#include <string>
+
+/* Kinds of synthetic PBASIC program, each weighted towards one part of the tokenizer */
+enum TCorpusMix
+{
+  cmDebug,          /* DEBUG and SEROUT statements with formatters and strings */
+  cmNesting,        /* Deeply nested IF..ELSEIF..ELSE and SELECT..CASE blocks */
+  cmDeclarations,   /* Many CON, VAR and DATA declarations */
+  cmConditional,    /* #DEFINE symbols and #IF/#SELECT conditional-compile blocks */
+  cmComments,       /* Long comment blocks and trailing comments */
+  cmMixed,          /* All of the above */
+  cmNumElements
+};
+
+/* Describes a synthetic program.  The same spec always generates the same program. */
+struct TCorpusSpec
+{
+  TCorpusMix   Mix;
+  int          Size;        /* Approximate source size in bytes (never more than MaxSourceSize-1) */
+  unsigned int Seed;
+  int          Budget;      /* Most units of the mix to emit before padding with comments; -1 = no limit */
+};
+
+/* Return the name of Mix, for benchmark labels */
+const char *CorpusMixName(TCorpusMix Mix);
+
+/* Generate the program described by Spec.  Programs target the BS2 in PBASIC 2.5. */
+std::string GenerateProgram(const TCorpusSpec &Spec);
+
+/* Generate the program described by Spec, lowering its Budget as needed until it compiles (a large program can't all
+   fit in the EEPROM or symbol table, so the rest of it is comments).  Returns an empty string if it never compiles. */
+std::string GenerateCompilableProgram(TCorpusSpec Spec);
+
+#endif
@@ -0,0 +1,161 @@
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "corpus.hpp"
+#include "tokenizer/tokenizer.hpp"
+
+namespace
+{
+
+const int Sizes[] = {1 << 10, 8 << 10, 60 << 10};
+
+/* Generate the program for a benchmark's (mix, size) arguments into a MaxSourceSize buffer */
+bool LoadProgram(benchmark::State &State, std::vector<char> &Buffer, int *SourceSize)
+{
+  TCorpusSpec Spec = {(TCorpusMix) State.range(0), (int) State.range(1), 2026u, -1};
+  std::string Src = GenerateCompilableProgram(Spec);
+
+  State.SetLabel(CorpusMixName(Spec.Mix));
+  if (Src.empty())
+    {
+    State.SkipWithError("generated program does not compile");
+    return False;
+    }
+  Buffer.assign(MaxSourceSize, 0);
+  std::memcpy(Buffer.data(), Src.data(), Src.size());
+  *SourceSize = (int) Src.size();
+  return True;
+}
+
+void Report(benchmark::State &State, int SourceSize)
+{
+  State.SetBytesProcessed((int64_t) State.iterations() * SourceSize);
+  State.counters["compiles/s"] = benchmark::Counter((double) State.iterations(), benchmark::Counter::kIsRate);
+  State.counters["source"] = SourceSize;
+}
+
+/* Report the average time per compile of each phase that ran, in nanoseconds */
+void ReportPhases(benchmark::State &State, const long long *PhaseTime)
+{
+  for (int Phase = 0; Phase < cpNumElements; Phase++)
+    if (PhaseTime[Phase] > 0)
+      State.counters[CompilePhases[Phase]] = benchmark::Counter((double) PhaseTime[Phase], benchmark::Counter::kAvgIterations);
+}
+
+/* Compile (or directives-only compile) in place.  Compile edits its source (it sanitizes it and terminates directive
+   arguments), so each iteration starts from a fresh copy; the copy is part of the timing, as it would be for a caller
+   that keeps its own source. */
+void CompileBench(benchmark::State &State, bool DirectivesOnly)
+{
+  auto Tokenizer = std::make_unique<tokenizer>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Program;
+  std::vector<char> Buffer(MaxSourceSize, 0);
+  int SourceSize;
+  long long PhaseTime[cpNumElements] = {};
+
+  if (!LoadProgram(State, Program, &SourceSize)) return;
+  for (auto _ : State)
+    {
+    std::memcpy(Buffer.data(), Program.data(), SourceSize + 1);
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    Rec->SourceSize = SourceSize;
+    if (!Tokenizer->Compile(Rec.get(), Buffer.data(), DirectivesOnly, True, NULL))
+      {
+      State.SkipWithError(Rec->Error);
+      break;
+      }
+#if defined(CompileStatistics)
+    TCompileStats Stats;
+    Tokenizer->GetCompileStats(&Stats);
+    for (int Phase = 0; Phase < cpNumElements; Phase++) PhaseTime[Phase] += Stats.PhaseTime[Phase];
+#endif
+    }
+  Report(State, SourceSize);
+  ReportPhases(State, PhaseTime);
+}
+
+void BM_Compile(benchmark::State &State) { CompileBench(State, False); }
+void BM_CompileDirectivesOnly(benchmark::State &State) { CompileBench(State, True); }
+
+void BM_CompileView(benchmark::State &State)
+{
+  auto Tokenizer = std::make_unique<tokenizer>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Buffer;
+  int SourceSize;
+
+  if (!LoadProgram(State, Buffer, &SourceSize)) return;
+  for (auto _ : State)
+    {
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    if (!Tokenizer->CompileView(Rec.get(), Buffer.data(), SourceSize, False, True, NULL, NULL))
+      {
+      State.SkipWithError(Rec->Error);
+      break;
+      }
+    }
+  Report(State, SourceSize);
+}
+
+void BM_ProbeDirectives(benchmark::State &State)
+{
+  auto Tokenizer = std::make_unique<tokenizer>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Buffer;
+  int SourceSize;
+
+  if (!LoadProgram(State, Buffer, &SourceSize)) return;
+  for (auto _ : State)
+    {
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    if (!Tokenizer->ProbeDirectives(Rec.get(), Buffer.data(), SourceSize, NULL))
+      {
+      State.SkipWithError(Rec->Error);
+      break;
+      }
+    }
+  Report(State, SourceSize);
+}
+
+void BM_GetReservedWords(benchmark::State &State)
+{
+  auto Tokenizer = std::make_unique<tokenizer>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Buffer(MaxSourceSize, 0);
+
+  for (auto _ : State)
+    {
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    Rec->TargetModule = (byte) State.range(0);
+    Rec->LanguageVersion = (int) State.range(1);
+    if (!Tokenizer->GetReservedWords(Rec.get(), Buffer.data()))
+      {
+      State.SkipWithError("GetReservedWords failed");
+      break;
+      }
+    benchmark::DoNotOptimize(Buffer.data());
+    }
+  State.SetBytesProcessed((int64_t) State.iterations() * Rec->SourceSize);
+  State.counters["calls/s"] = benchmark::Counter((double) State.iterations(), benchmark::Counter::kIsRate);
+}
+
+void CorpusArguments(benchmark::internal::Benchmark *Bench)
+{
+  Bench->ArgNames({"mix", "size"});
+  for (int Mix = 0; Mix < cmNumElements; Mix++)
+    for (int Size : Sizes) Bench->Args({Mix, Size});
+}
+
+}  // namespace
+
+BENCHMARK(BM_Compile)->Apply(CorpusArguments);
+BENCHMARK(BM_CompileDirectivesOnly)->Apply(CorpusArguments);
+BENCHMARK(BM_CompileView)->Apply(CorpusArguments);
+BENCHMARK(BM_ProbeDirectives)->Apply(CorpusArguments);
+BENCHMARK(BM_GetReservedWords)->ArgNames({"target", "version"})->Args({tmBS2, 200})->Args({tmBS2, 250})->Args({tmBS2pe, 250});
+
+BENCHMARK_MAIN();
@@ -14,6 +14,28 @@ if(BUILD_TESTING)
   add_subdirectory(test)
 endif()
 
+option(BUILD_BENCHMARKS "Build the tokenizer_bench benchmark suite"  OFF)
+if(BUILD_BENCHMARKS)
+  find_package(benchmark QUIET)
+  if(NOT benchmark_FOUND)
+    FetchContent_Declare(
+      benchmark
+      GIT_REPOSITORY https://github.com/google/benchmark.git
+      GIT_TAG v1.9.1
+    )
+    set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+    FetchContent_MakeAvailable(benchmark)
+  endif()
+  add_subdirectory(bench)
+endif()
+
+if(UNIX)
+  option(BUILD_SERVER "Build the tokenizer_server fork server" ON)
+  if(BUILD_SERVER)
+    add_subdirectory(server)
+  endif()
+endif()
+
 option(BUILD_MCSS_DOCS "Build documentation using Doxygen and m.css" OFF)
 if(BUILD_MCSS_DOCS)
   include(cmake/docs.cmake)
@@ -1,5 +1,8 @@
 # ---- local ----
 
+find_package(Threads REQUIRED)
+target_link_libraries(pbtokenizer_tokenizer PUBLIC Threads::Threads)
+
 # find_package(fetalib REQUIRED)
 # message("-- Package \"fetalib\" found: ${fetalib_FOUND}")
 # target_link_libraries(tokenizer_tokenizer fetalib::fetalib)
@@ -9,6 +9,11 @@
 #define DevDebug                          /*Uncomment this to enable the GetVariableItem, GetSymbolTableItem, GetElementListItem and
        	                                    GetGosubCount routines.  This is only for development support*/
 
+#define CompileStatistics                 /*Comment this out to remove GetCompileStats, SetTrace and the phase timers, counters and
+                                            trace points behind them.  Enabled, they cost two clock reads per compile phase, a
+                                            counter increment per element, cancelled element, EEPROM write and patch, and a
+                                            test per instruction (plus two clock reads if tracing)*/
+
 #define TokenizerVersion  130			  /*Version of this tokenizer; xyy means version x.yy*/
 
 class TOKENIZER_EXPORT tokenizer {
@@ -16,6 +21,11 @@ public:
 
   /*Define forward declarations*/
 
+  tokenizer() = default;
+  tokenizer(const tokenizer &) = delete;
+  tokenizer &operator=(const tokenizer &) = delete;
+  ~tokenizer();
+
   STDAPI TestRecAlignment(TModuleRec *Rec);
   STDAPI Version(void);
   #if defined(DevDebug)
@@ -26,13 +36,45 @@ public:
     STDAPI GetGosubCount(void);
   #endif
   STDAPI Compile(TModuleRec *Rec, char *Src, bool DirectivesOnly, bool ParseStampDirective, TSrcTokReference *Ref);
+  STDAPI CompileView(TModuleRec *Rec, const char *Src, int SrcSize, bool DirectivesOnly, bool ParseStampDirective, TSrcTokReference *Ref, TDirectiveViews *Views);
+  STDAPI ProbeDirectives(TModuleRec *Rec, const char *Src, int SrcSize, TDirectiveViews *Views);
+  STDAPI CompileFrontEnd(TModuleRec *Rec, const char *Src, int SrcSize);
+  STDAPI CompileBackEnd(const tokenizer *Front, TModuleRec *Rec, byte TargetModule, TSrcTokReference *Ref);
+  STDAPI ResolveFrontEnd(TModuleRec *Rec, const char *Src, int SrcSize, bool ParseStampDirective);
+  STDAPI CompileConditionals(const tokenizer *Front, TModuleRec *Rec, const TDefineSymbol *Defines, int DefineCount, TSrcTokReference *Ref);
+  STDAPI CompileRemainder(void);
+  bool   SameConditionals(tokenizer *Other);
   STDAPI GetReservedWords(TModuleRec *Rec, char *Src);
+  STDAPI GetSymbolStats(TSymbolStats *Stats);
+  STDAPI SetIncremental(bool Enable);
+  #if defined(CompileStatistics)
+    STDAPI GetCompileStats(TCompileStats *Stats);
+    STDAPI SetTrace(TCompileTrace *Trace);
+  #endif
 
   /*---Misc---*/
+  bool       CompileSource(bool DirectivesOnly, bool ParseStampDirective);
+  bool       CompileFront(bool DirectivesOnly, bool ParseStampDirective);
+  void       CompileTarget(bool ParseStampDirective);
+  void       CompileProgram(void);
+  void       BeginCompile(void);
+  bool       EndCompile(void);
+  bool       AttachView(TModuleRec *Rec, const char *Src, int SrcSize, TSrcTokReference *Ref, TDirectiveViews *Views);
+  bool       CopyFrontEnd(const tokenizer *Front, TModuleRec *Rec, TSrcTokReference *Ref, word ElementCount);
+  TErrorCode DefineSymbols(const TDefineSymbol *Defines, int Count);
+  bool       IsDefinedElement(int Idx);
   byte       ResWordTypeID(TElementType ElementType);
   void       InitializeRec(void);
+  void       InitializeDirectiveFields(void);
   void       ClearEEPROM(void);
   void       ClearSrcTokReference(void);
+  bool       ReuseResults(bool ParseStampDirective);
+  void       SaveResults(bool ParseStampDirective);
+  #if defined(CompileStatistics)
+    void       BeginPhase(void);
+    TErrorCode EndPhase(TCompilePhase Phase, TErrorCode Result);
+    void       TraceSpan(TTraceKind Kind, int Value, long long Start, int SrcStart, int SrcLength);
+  #endif
 
   /*---Expression Engine---(Compiles algebraic expressions)*/
   TErrorCode GetReadWrite(bool Write);
@@ -53,13 +95,19 @@ public:
   /*---Symbol Engine---(Builds and searches the Symbol Table)-*/
   TErrorCode InitSymbols(void);
   TErrorCode AdjustSymbols(void);
+  static void BuildSymbolImage(TSymbolImage *Image, byte TargetModule, bool Version250);
+  static const TSymbolImage *GetSymbolImage(byte TargetModule, bool Version250);
   TErrorCode EnterSymbol(TSymbolTable Symbol);
   TErrorCode EnterUndefSymbol(char *Name);
   bool       FindSymbol(TSymbolTable *Symbol);
   bool       ModifySymbolValue(const char *Name, word Value);
   int        GetSymbolVector(const char *Name);
   int        GetUndefSymbolVector(char *Name);
-  int        CalcSymbolHash(const char *SymbolName);
+  word       InternName(const char *Name);
+  int        GetNameVector(const char *Name, unsigned int Hash, byte Length);
+  unsigned int CalcSymbolHash(const char *SymbolName, byte *Length);
+  static int FindReservedWord(const char *Name, unsigned int Hash, byte Length);
+  bool       IsReservedWord(const char *Name);
 
   /*---Element Engine---(Elementizes the source code into the ElementList)-*/
   TErrorCode ElementError(bool IncLength, TErrorCode ErrorID);
@@ -69,12 +117,34 @@ public:
   TErrorCode GetSymbol(void);
   TErrorCode GetFilename(bool Quoted);
   TErrorCode GetDirective(void);
+  void       *ElementAlloc(size_t Size);
+  void       ResetElements(void);
+  TErrorCode GrowElements(TElementStore *Store);
   TErrorCode EnterElement(TElementType ElementType, word Value, bool IsEnd);
-  TErrorCode Elementize(bool LastPass);
+  TErrorCode GetSourceElement(void);
+  TErrorCode ElementizeDirective(int Position);
+  TErrorCode EndElements(void);
+  TErrorCode Elementize(TElementizePass Pass);
+  void       SanitizeLines(int Idx, int *SanitizedEnd);
+  TErrorCode ElementizeHeader(void);
+  void       *GrowCacheArray(void *Array, int *Capacity, int Count, size_t Size);
+  bool       CacheElements(TElementStore *Cache, const TElementStore *Store, int Count);
+  void       FreeElementCache(TElementCache *Cache);
+  void       BeginElementCache(void);
+  bool       OpenLexedLine(void);
+  void       CloseLexedLine(void);
+  void       CacheComment(int Position);
+  TErrorCode ReuseLines(void);
+  void       EndElementCache(void);
+  bool       SameElementCaches(const TElementCache *Old, const TElementCache *New);
+  bool       SameElements(const TElementStore *Old, const TElementStore *New, int Count);
+  int        MapPosition(int Position);
+  TErrorCode ResolveElements(void);
   bool       GetElement(TElementList *Element);
   bool       PreviewElement(TElementList *Preview);
   void       CancelElements(word Start, word Finish);
   void       VoidElements(word Start, word Finish);
+  void       CompactElements(void);
   void       GetSymbolName(int Start, int Length);
 
   /*---Directive Compilers---(These compile the compile-time items, editor directives and compiler directives)-*/
@@ -92,14 +162,23 @@ public:
   TErrorCode AppendExpression(byte SourceExpression, TOperatorCode AppendOperator);
   TErrorCode CompileCCCase(void);
   TErrorCode CompileCCEndSelect(void);
-  TErrorCode CompilePins(bool LastPass);
-  TErrorCode CompileConstants(bool LastPass);
+  TErrorCode IndexDeclarations(void);
+  void       AddDeclarationLine(TDeclarationKind Kind, word Start, word Key);
+  bool       GetDeclarationLine(TDeclarationKind Kind, int *LineIdx, word *StartOfLine);
+  TErrorCode CompilePins(void);
+  TErrorCode CompileConstants(void);
+  TErrorCode CompileDeclaration(TDeclarationKind Kind, int LineIdx);
+  TErrorCode ResolveDeclaration(TElementList *Element);
+  TErrorCode ResolveDependencies(TDeclarationKind Kind, int LineIdx);
   TErrorCode AssignSymbol(bool *SymbolFlag, word *EEPROMIdx);
   TErrorCode EnterData(TElementList *Element, word *EEPROMValue, word *EEPROMIdx, bool WordFlag, bool DefinedFlag, bool LastPass);
   TErrorCode CompileData(bool LastPass);
+  TErrorCode LayoutData(int LastLine);
+  TErrorCode CompileDataLine(bool LastPass, word StartOfLine, word *DataIdx);
   TErrorCode GetModifiers(TElementList *Element);
   TErrorCode CompileVar(bool LastPass);
   TErrorCode ResolveConstant(bool LastPass, bool CCDefine, bool *Resolved);
+  bool       ConstantOperation(TOperatorCode Operation, word *Value, word Operand);
   TErrorCode GetCCDirectiveExpression(int SplitExpression);
   int        GetExpBits(byte Bits, word *BitIdx);
   int        RaiseToPower(int Base, int Exponent);
@@ -216,12 +295,100 @@ public:
   bool       InBaseRange(char C, TBase Base);
   /*---Object Engine---(Generates the EEPROM and PacketBuffer data for successful compilations)-*/
   TErrorCode EnterEEPROM(byte Bits, word Data);
+  TErrorCode EnterEEPROMBits(byte Bits, uint64_t Data);
   void       EnterSrcTokRef(void);
   TErrorCode PatchAddress(word SourceAddress);
   TErrorCode PatchSkipLabels(bool Exits);
   TErrorCode PatchRemainingAddresses(void);
   void       PreparePackets(void);
 
+  /*---Compiler State---(Everything a compilation touches lives here, rather than in file-level globals, so that separate
+    tokenizer objects may compile concurrently on separate threads.  A single object is still NOT re-entrant)-*/
+  TModuleRec        *tzModuleRec;                         /*tzModuleRec is a pointer to an externally accessible structure*/
+  char              *tzSource;                            /*tzSource is a pointer to an externally accessible byte array, or to WorkSource*/
+  const char        *tzViewSource;                        /*tzViewSource is a pointer to CompileView's read-only source, or NULL*/
+  TDirectiveViews   *tzDirectiveViews;                    /*tzDirectiveViews is a pointer to CompileView's externally accessible directive views, or NULL*/
+  char              WorkSource[MaxSourceSize];            /*Sanitized copy of CompileView's source*/
+  TSrcTokReference  *tzSrcTokReference;                   /*tzSrcTokReference is a pointer to an externally accessible Source vs. Token Reference array*/
+  TSymbolTable      Symbol;
+  TSymbolTable      Symbol2;
+  TSymbolTable      SymbolTable[SymbolTableSize];
+  TSymbolKey        SymbolKeys[SymbolTableSize];          /*Hash and length of each entered SymbolTable record's Name*/
+  int               SymbolVectors[SymbolTableSize];       /*Vectors used for hashing into Symbol Table*/
+  int               SymbolTablePointer;
+  const TSymbolImage *ReservedImage;                      /*Image of the automatic symbols now in SymbolTable*/
+  TUndefSymbolTable UndefSymbolTable[SymbolTableSize];
+  int               UndefSymbolVectors[SymbolTableSize];  /*Vectors used for hashing into Undefined Symbol Table.  Used to distinguish between undefined DEFINE'd symbols and undefined DATA, VAR, CON or PIN symbols*/
+  int               UndefSymbolTablePointer;
+  TNameTable        NameTable[SymbolTableSize];           /*Names of undefined symbols' elements (see InternName)*/
+  int               NameVectors[SymbolTableSize];         /*Vectors used for hashing into Name Table*/
+  int               NameTablePointer;
+  TSymbolStats      SymbolStats;                          /*Symbol table search counts*/
+  #if defined(CompileStatistics)
+    TCompileStats   CompileStats;                         /*Phase times and counts of the last compile*/
+    long long       PhaseStart;                           /*Clock reading at the start of the current phase*/
+    TCompileTrace   *tzTrace = NULL;                      /*tzTrace is a pointer to an externally accessible trace of compiles, or NULL*/
+  #endif
+  TArenaBlock       *ElementArena = NULL;                 /*Storage of the element lists and the arrays sized by them, newest block first; emptied by each compile*/
+  TElementStore     SourceElements;                       /*Elements of source code*/
+  TElementStore     DirectiveElements;                    /*Elements of editor directive comments; gathered by single-pass Elementize*/
+  TElementStore     *ElementList;                         /*Element list being worked on (SourceElements or DirectiveElements)*/
+  word              ElementListIdx;
+  word              ElementListEnd;
+  word              SourceElementsEnd;                    /*ElementListEnd of SourceElements after single-pass Elementize*/
+  word              DirectiveElementsEnd;                 /*ElementListIdx of DirectiveElements during single-pass Elementize*/
+  word              *UnresolvedElements;                  /*SourceElements indexes of elements left for ResolveElements, in order; grows with SourceElements*/
+  word              UnresolvedCount;
+  TDeclarationLine  *DeclarationLines[dkNumElements];     /*Lines of SourceElements each declaration pass compiles, in order; allocated by IndexDeclarations*/
+  word              DeclarationCount[dkNumElements];
+  TDeclarationFrame *DeclarationStack;                    /*Explicit stack of ResolveDependencies; allocated by IndexDeclarations*/
+  int               DeclarationStackTop;
+  TIncrementalState *Incremental = NULL;                  /*Element caches and results kept between incremental compiles, or NULL (see SetIncremental)*/
+  TElementCache     *LexCache = NULL;                     /*Element cache being recorded by single-pass Elementize, or NULL*/
+  int               LexLine;                              /*Next line to consider reusing from the last compile's element cache*/
+  word              GosubLimitIdx;                        /*SourceElements index of the 256th GOSUB, if any*/
+  int               DataLayoutLine;                       /*Next DeclarationLines[dkData] line to lay out (see LayoutData)*/
+  word              DataLayoutIdx;                        /*EEPROM index where that line's data will go*/
+  bool              DataLayoutBusy;                       /*Indicates LayoutData is laying out a line*/
+  word              EEPROMPointers[EEPROMSize*2];
+  word              EEPROMIdx;
+  word              GosubCount;
+  word              PatchList[PatchListSize];
+  int               PatchListIdx;
+  TNestingStack     NestingStack[NestingStackSize];
+  byte              NestingStackIdx;                      /*Index of next available nesting stack element*/
+  byte              ForNextCount;                         /*Current count of Nested FOR..NEXT loops*/
+  byte              IfThenCount;                          /*Current count of Nested IF THENs*/
+  byte              DoLoopCount;                          /*Current count of Nested DO..LOOPs*/
+  byte              SelectCount;                          /*Current count of Nested SELECT CASEs*/
+  word              Expression[4][int(ExpressionSize / 16)]; /*4 arrays of (1 word size, N words data)*/
+  byte              ExpressionStack[256];
+  byte              ExpStackTop;
+  byte              ExpStackBottom;
+  byte              StackIdx;                             /*Run-time stack pointer*/
+  byte              ParenCount;
+  int               SrcIdx;                               /*Used by Element Engine*/
+  word              StartOfSymbol;                        /*Used by Element Engine*/
+  byte              CurChar;                              /*Used by Element Engine*/
+  TElementType      ElementType = etUndef;                /*Used by Element Engine*/
+  bool              EndEntered;                           /*Used by Element Engine.  Indicates if End was just entered.*/
+  bool              SinglePass;                           /*Used by Element Engine.  True while elementizing source and directives together*/
+  bool              DirectiveEndEntered;                  /*Used by Element Engine.  EndEntered for DirectiveElements*/
+  word              DirectiveStartOfSymbol;               /*Used by Element Engine.  StartOfSymbol after last directive comment*/
+  int               DirectiveResume;                      /*Used by Element Engine.  Source index where directive scan resumes*/
+  bool              DirectiveFailed;                      /*Used by Element Engine.  Indicates if error was in an editor directive*/
+  bool              LangSensitive;                        /*Used by Element Engine.  Indicates if a comma, # or $ has been elementized*/
+  bool              Relex;                                /*Used by Element Engine.  Indicates if Lang250 changed after LangSensitive*/
+  bool              ElementizedLang250;                   /*Used by Element Engine.  Lang250 the source was elementized for*/
+  TErrorCode        DeferredError;                        /*Used by Element Engine.  Error in source held for ResolveElements*/
+  int               DeferredErrorStart;
+  int               DeferredErrorLength;
+  bool              AllowStampDirective;                  /*Set by Compile routine*/
+  byte              VarBitCount;                          /*# of var bits; used by variable parsing routines*/
+  byte              VarBases[4];                          /*start of.. [0]=bits, [1]=nibbles, [2]=bytes, [3]=words*; used by variable parsing routines*/
+  bool              Lang250;                              /*False = PBASIC 2.00, True = PBASIC 2.50*/
+  int               SrcTokReferenceIdx;
+
 
 #ifdef WIN32
   /*------------------------------------------------------------------------------*/
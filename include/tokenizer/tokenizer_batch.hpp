@@ -0,0 +1,62 @@
+#ifndef __TOKENIZER_BATCH_H__
+#define __TOKENIZER_BATCH_H__
+
+#include <memory>
+#include <vector>
+
+#include "tokenizer/tokenizer_export.hpp"
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+
+/*Define batch compile job.  Source follows the same rules as tokenizer::Compile; it must point to a writable buffer of
+  MaxSourceSize bytes which is not shared with any other job, since the compiler marks up the source in place and
+  TModuleRec fields (ProjectFiles, Port, Error) may point back into it.  Alternatively, SharedSource follows the rules
+  of tokenizer::CompileView; it is only read, so any number of jobs may share it, but the TModuleRec pointer fields are
+  only good until the worker's next job, so use ErrorStart, ErrorLength and Views to find things in the source.*/
+struct TOKENIZER_EXPORT TBatchJob
+{
+    char              *Source;                  /*Source code buffer (MaxSourceSize bytes), if SharedSource is NULL*/
+    const char        *SharedSource;            /*Read-only source code (SourceSize bytes), or NULL to use Source*/
+    TDirectiveViews   *Views;                   /*Optional directive views for SharedSource, or NULL*/
+    int               SourceSize;               /*Length of source code in Source or SharedSource*/
+    bool              DirectivesOnly;           /*True = compile editor directives only*/
+    bool              ParseStampDirective;      /*True = target module comes from $STAMP directive*/
+    byte              TargetModule;             /*Target module to compile for when ParseStampDirective is False*/
+    TSrcTokReference  *SrcTokReference;         /*Optional Source vs. Token Reference array for this job, or NULL*/
+};
+
+/*Define batch compile statistics*/
+struct TOKENIZER_EXPORT TBatchStats
+{
+    int               JobCount;                 /*Number of jobs compiled*/
+    int               Succeeded;                /*Number of jobs that compiled successfully*/
+    int               ThreadCount;              /*Number of worker threads used*/
+    int               Steals;                   /*Number of jobs taken from another worker's queue*/
+    double            Seconds;                  /*Wall-clock time for the whole batch*/
+    double            JobsPerSecond;            /*JobCount / Seconds*/
+};
+
+/*The BatchCompiler spreads a list of compile jobs over a pool of worker threads, each with its own tokenizer object.
+  Jobs are dealt out to the workers in contiguous runs; a worker that finishes its own run steals from the tail of
+  another worker's run, so uneven job sizes don't leave cores idle.  Worker tokenizer objects are kept between calls.*/
+class TOKENIZER_EXPORT BatchCompiler {
+public:
+  explicit BatchCompiler(int ThreadCount = 0);  /*0 = one worker per hardware thread*/
+  ~BatchCompiler();
+
+  STDAPI Compile(TBatchJob *Jobs, TModuleRec *Results, int JobCount, TBatchStats *Stats);
+  int    ThreadCount(void);
+  #if defined(CompileStatistics)
+    void SetTraces(TCompileTrace *WorkerTraces);
+  #endif
+
+private:
+  int                                       Workers;
+  #if defined(CompileStatistics)
+    TCompileTrace                           *Traces;
+  #endif
+TOKENIZER_SUPPRESS_C4251
+  std::vector<std::unique_ptr<tokenizer>>   Tokenizers;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef __TOKENIZER_CACHE_H__
+#define __TOKENIZER_CACHE_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_export.hpp"
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+
+/*The CompileCache keeps compile results in a directory on disk, one file per result, named for a 128-bit hash of the
+  source bytes, the compile flags, the TargetModule (if not taken from a $STAMP directive) and the TokenizerVersion.  A
+  hit restores the TModuleRec outputs, the TSrcTokReference table and the directive views without compiling at all; a
+  miss compiles with CompileView and stores the result.  Any number of processes may share the directory: results are
+  written to a temporary file and renamed into place, so a reader only ever sees whole files, and files that don't
+  check out (wrong size, format or version) are treated as misses.  The directory must already exist.*/
+class TOKENIZER_EXPORT CompileCache {
+public:
+  explicit CompileCache(const char *Directory);
+  ~CompileCache();
+
+  STDAPI Compile(TModuleRec *Rec, const char *Src, int SrcSize, bool DirectivesOnly, bool ParseStampDirective, TSrcTokReference *Ref, TDirectiveViews *Views);
+  int    Hits(void);
+  int    Misses(void);
+
+private:
+  bool   Load(const std::string &FileName, const unsigned long long *Key, TModuleRec *Rec, TSrcTokReference *Ref, TDirectiveViews *Views);
+  void   Store(const std::string &FileName, const unsigned long long *Key, bool DirectivesOnly, const TModuleRec *Rec, const TSrcTokReference *Ref, const TDirectiveViews *Views);
+
+  int                                       HitCount;
+  int                                       MissCount;
+TOKENIZER_SUPPRESS_C4251
+  std::string                               Path;
+  std::unique_ptr<tokenizer>                Tokenizer;
+  std::vector<char>                         Strings;        /*Error, port and project file strings of the last hit*/
+  std::vector<TSrcTokReference>             References;     /*Reference table for a miss whose caller didn't want one*/
+};
+
+#endif
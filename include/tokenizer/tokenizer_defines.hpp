@@ -0,0 +1,55 @@
+#ifndef __TOKENIZER_DEFINES_H__
+#define __TOKENIZER_DEFINES_H__
+
+#include <memory>
+#include <vector>
+
+#include "tokenizer/tokenizer_export.hpp"
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+/*Define configuration structure; the symbols DEFINE'd ahead of the source for one build*/
+struct TOKENIZER_EXPORT TDefineSet
+{
+    const TDefineSymbol *Symbols;
+    int               Count;
+};
+
+/*Define configuration compile statistics*/
+struct TOKENIZER_EXPORT TDefineStats
+{
+    int               SetCount;                 /*Number of configurations compiled*/
+    int               Succeeded;                /*Number of configurations that compiled successfully*/
+    int               Compiled;                 /*Number of configurations compiled past conditional compilation; the rest shared their results*/
+    int               ThreadCount;              /*Number of threads used*/
+    double            FrontSeconds;             /*Wall-clock time for the shared front end*/
+    double            Seconds;                  /*Wall-clock time for the whole compile*/
+};
+
+/*The DefineCompiler compiles one source in several configurations, each with its own set of symbols DEFINE'd ahead of
+  the source (see tokenizer::DefineSymbols), as tokenizer::CompileView would with "#DEFINE Name = Value" lines in front.
+  The source is elementized, and its symbols adjusted for the target module, only once (see
+  tokenizer::ResolveFrontEnd); then each configuration's conditional-compile directives are compiled at once, one thread
+  per configuration (up to ThreadCount).  Configurations left with the same elements (see tokenizer::SameConditionals)
+  share the results of one compile of the rest.  A PBASIC 2.0 source has no conditional compilation; the sets are
+  ignored for it, so every configuration shares the results of the source compiled alone (where "#DEFINE" lines in
+  front would fail it with error 103).  Tokenizer objects are kept between calls.*/
+class TOKENIZER_EXPORT DefineCompiler {
+public:
+  explicit DefineCompiler(int ThreadCount = 0);  /*0 = one thread per hardware thread*/
+  ~DefineCompiler();
+
+  STDAPI Compile(const char *Src, int SrcSize, bool ParseStampDirective, byte TargetModule, const TDefineSet *Sets, int SetCount,
+                 TModuleRec *Results, TSrcTokReference *Refs, int *SharedWith, TDefineStats *Stats);
+  int    ThreadCount(void);
+
+private:
+  void   CopyResults(TModuleRec *Rec, const TModuleRec *From);
+
+  int                                       Workers;
+TOKENIZER_SUPPRESS_C4251
+  std::unique_ptr<tokenizer>                Front;          /*Compiles the shared front end*/
+  std::unique_ptr<TModuleRec>               FrontRec;
+  std::vector<std::unique_ptr<tokenizer>>   Tokenizers;     /*One per configuration*/
+};
+
+#endif
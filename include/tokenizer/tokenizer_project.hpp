@@ -0,0 +1,61 @@
+#ifndef __TOKENIZER_PROJECT_H__
+#define __TOKENIZER_PROJECT_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_export.hpp"
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+#define ProjectSlotCount  8                     /*Program slots of a multi-file project; the main source and up to 7 project files*/
+
+/*Define project file loader.  Fill Source (MaxSourceSize bytes) with the project file named FileName (as written in the
+  main source's $STAMP directive), set *SourceSize (less than MaxSourceSize) and return True, or return False if it
+  can't be loaded.  It is called from the thread that called ProjectCompiler::Compile, before any slot is compiled.*/
+typedef bool (*TProjectLoader)(void *Context, const char *FileName, char *Source, int *SourceSize);
+
+/*Define project slot results*/
+struct TOKENIZER_EXPORT TProjectSlot
+{
+    const char        *FileName;                /*Project file name from the main source's $STAMP directive (NULL for slot 0)*/
+    bool              Loaded;                   /*False if the loader couldn't supply the file (Rec is then failed, with no Error)*/
+    TModuleRec        Rec;                      /*Compile results, as tokenizer::CompileView would give them*/
+};
+
+/*Define project compile statistics*/
+struct TOKENIZER_EXPORT TProjectStats
+{
+    int               SlotCount;                /*Number of slots compiled (1 + number of project files)*/
+    int               Succeeded;                /*Number of slots that compiled successfully*/
+    int               ThreadCount;              /*Number of threads used*/
+    double            Seconds;                  /*Wall-clock time for the whole project*/
+};
+
+/*The ProjectCompiler compiles a BS2e, BS2sx, BS2p or BS2pe multi-file project: the main source (slot 0) and the project
+  files its $STAMP directive lists (slots 1..7), loaded through a caller's loader.  The slots are compiled at once, one
+  thread per slot (up to ThreadCount), largest first, so a project takes about as long as its largest slot.  Project
+  files are compiled for the main source's target module; their own $STAMP directives are ignored.  All slots use the
+  same shared reserved-word image for that target (see tokenizer::GetSymbolImage).  Slot tokenizer objects and source
+  buffers are kept between calls.*/
+class TOKENIZER_EXPORT ProjectCompiler {
+public:
+  explicit ProjectCompiler(int ThreadCount = 0);  /*0 = one thread per hardware thread*/
+  ~ProjectCompiler();
+
+  STDAPI Compile(const char *Src, int SrcSize, TProjectLoader Loader, void *Context, TProjectSlot *Slots, TSrcTokReference *Refs, TProjectStats *Stats);
+  int    ThreadCount(void);
+
+private:
+  int    FindProjectFiles(const TModuleRec *Rec, std::string *Names);
+  void   CompileSlots(const char *Src, int SrcSize, int First, int SlotCount, byte TargetModule, TProjectLoader Loader, void *Context,
+                      TProjectSlot *Slots, TSrcTokReference *Refs, int *ThreadsUsed);
+
+  int                                       Workers;
+TOKENIZER_SUPPRESS_C4251
+  std::string                               FileNames[ProjectSlotCount];
+  std::vector<std::unique_ptr<tokenizer>>   Tokenizers;     /*One per slot*/
+  std::vector<std::vector<char>>            Sources;        /*Project file buffers, one per slot (slot 0's is unused)*/
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __TOKENIZER_SESSION_H__
+#define __TOKENIZER_SESSION_H__
+
+#include <memory>
+#include <vector>
+
+#include "tokenizer/tokenizer_export.hpp"
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+
+/*The CompileSession keeps one source open for editing, such as an editor's buffer, along with a tokenizer object that
+  compiles it incrementally (see tokenizer::SetIncremental).  Apply each change to the buffer with Edit, then Compile;
+  only the lines an edit touched are elementized again, and if it touched nothing but comments or spacing the passes
+  after the editor directives are skipped as well.  Results are exactly those of tokenizer::CompileView on the edited
+  source, so the TModuleRec pointer fields are only good until the next Compile.*/
+class TOKENIZER_EXPORT CompileSession {
+public:
+  CompileSession();
+  ~CompileSession();
+
+  STDAPI Open(const char *Src, int SrcSize, bool ParseStampDirective, byte TargetModule);
+  STDAPI Edit(int Offset, int RemovedLength, const char *Text, int TextLength);
+  STDAPI Compile(TModuleRec *Rec, TSrcTokReference *Ref, TDirectiveViews *Views);
+  const char *Source(void);
+  int         SourceSize(void);
+  #if defined(CompileStatistics)
+    STDAPI GetCompileStats(TCompileStats *Stats);
+  #endif
+
+private:
+  bool                                      ParseStamp;
+  byte                                      Target;
+TOKENIZER_SUPPRESS_C4251
+  std::unique_ptr<tokenizer>                Tokenizer;
+  std::vector<char>                         Buffer;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef __TOKENIZER_TARGETS_H__
+#define __TOKENIZER_TARGETS_H__
+
+#include <memory>
+#include <vector>
+
+#include "tokenizer/tokenizer_export.hpp"
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+/*Define multi-target compile statistics*/
+struct TOKENIZER_EXPORT TTargetStats
+{
+    int               TargetCount;              /*Number of target modules compiled for*/
+    int               Succeeded;                /*Number of target modules the source compiled successfully for*/
+    int               ThreadCount;              /*Number of threads used*/
+    double            FrontSeconds;             /*Wall-clock time for the shared front end*/
+    double            Seconds;                  /*Wall-clock time for the whole compile*/
+};
+
+/*The TargetCompiler compiles one source for several target modules, as tokenizer::CompileView would with
+  ParseStampDirective = False and Rec->TargetModule set to each, but sanitizes, elementizes and compiles the editor
+  directives of the source only once (see tokenizer::CompileFrontEnd).  Adjusting symbols for each target, resolving
+  the elements that depend on it and the passes after are done for each target at once, one thread per target (up to
+  ThreadCount).  Tokenizer objects are kept between calls.*/
+class TOKENIZER_EXPORT TargetCompiler {
+public:
+  explicit TargetCompiler(int ThreadCount = 0);  /*0 = one thread per hardware thread*/
+  ~TargetCompiler();
+
+  STDAPI Compile(const char *Src, int SrcSize, const byte *Targets, int TargetCount, TModuleRec *Results, TSrcTokReference *Refs, TTargetStats *Stats);
+  int    ThreadCount(void);
+
+private:
+  void   CopyFailure(TModuleRec *Rec, byte TargetModule);
+
+  int                                       Workers;
+TOKENIZER_SUPPRESS_C4251
+  std::unique_ptr<tokenizer>                Front;          /*Compiles the shared front end*/
+  std::unique_ptr<TModuleRec>               FrontRec;
+  std::vector<std::unique_ptr<tokenizer>>   Tokenizers;     /*One per target*/
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef __TOKENIZER_TRACE_H__
+#define __TOKENIZER_TRACE_H__
+
+#include "tokenizer/tokenizer_export.hpp"
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+#if defined(CompileStatistics)
+
+/*Write Traces[0..TraceCount-1] (see tokenizer::SetTrace) to FileName as Chrome trace-event JSON, which Perfetto and
+  chrome://tracing can open.  Each trace is shown as its own thread, so pass one trace per BatchCompiler worker to see
+  a whole batch.  Returns True if successful, False if the file couldn't be written.*/
+TOKENIZER_EXPORT STDAPI WriteTraceFile(const char *FileName, const TCompileTrace *Traces, int TraceCount);
+
+#endif
+
+#endif
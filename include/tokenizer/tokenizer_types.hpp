@@ -27,6 +27,7 @@
 
 #include <limits.h>
 #include <cstdint>
+#include <stddef.h>
 
 
 /* Simple Defines */
@@ -47,11 +48,15 @@ typedef unsigned short int word;
 #include "tokenizer/tokenizer_export.hpp"
 
 #define SymbolSize		      32		            // Maximum size of symbol (in characters)
+#define CommonSymbolTableSize 363                   // Number of automatic symbols common to all Stamps
 #define SymbolTableSize     1024                    // Maximum symbols allowed in symbol table (MUST BE POWER OF 2 FOR CalcSymbolHash TO WORK)
 #define MaxSourceSize       0x10000                 // Maximum source file size
 #define EEPROMSize		      0x800	                // 224lc16b eeprom - 2k bytes / 16k bits
 #define SrcTokRefSize       ((EEPROMSize*8-14) / 7) // Max size of Source-Token Crossreference list int((# EEPROM Bits - Overhead) / CommandSize)
-#define ElementListSize     10240                   // Size of element list
+#define ElementListSize     0xFFFF                  // Maximum size of element list (elements are indexed by a word)
+#define ElementListGrowth   1024                    // Initial size of an element list; it doubles as needed (see tokenizer::GrowElements)
+#define ElementArenaSize    0x8000                  // Size of the first block of element storage (see tokenizer::ElementAlloc)
+#define UninternedName      0xFFFF                  // Element value of an undefined symbol whose name isn't in the name table (see tokenizer::InternName)
 #define PatchListSize       0x400*2                 // Size of address patch list
 #define ForNextStackSize    16                      // Max number of nested FOR..NEXT loops (Limited by firmware)
 #define IfThenStackSize     16                      // Max number of nested IF..THENs
@@ -104,11 +109,28 @@ typedef unsigned short int word;
 
 #define IsMultiFileCapable(Module) ( (Module == tmBS2e) || (Module == tmBS2sx) || (Module == tmBS2p) || (Module == tmBS2pe) )
 
+/*Shared symbol images are kept for common symbols only (image 0) and for each supported target module (tmBS2..tmBS2pe)
+  in each PBASIC Language version (2.0, 2.5)*/
+#define SymbolImageCount                        (1 + (tmNumElements-tmBS2)*2)
+#define SymbolImageIndex(Module,Version250)     (1 + ((Module)-tmBS2)*2 + ((Version250) ? 1 : 0))
+
 
 /* Types */
 /*Define Bases*/
 typedef enum TBase {bBinary, bDecimal, bHexadecimal, bNumElements} TBase;
 
+/*Define Elementize passes (see tokenizer::Elementize)*/
+typedef enum TElementizePass {epDirectives, epSource, epAll} TElementizePass;
+
+/*Define Compile phases (see tokenizer::CompileSource).  NOTE: If TCompilePhase is changed, change CompilePhases
+  appropriately.*/
+typedef enum TCompilePhase {cpInitSymbols, cpElementize, cpEditorDirectives, cpAdjustSymbols, cpResolveElements,
+                            cpCCDirectives, cpPins, cpConstants, cpData, cpVar, cpCountGosubs, cpCompactElements,
+                            cpInstructions, cpPatchAddresses, cpPreparePackets, cpNumElements} TCompilePhase;
+
+/*Define Declaration kinds, the lines each declaration pass compiles (see tokenizer::IndexDeclarations)*/
+typedef enum TDeclarationKind {dkPin, dkCon, dkData, dkVar, dkNumElements} TDeclarationKind;
+
 /*Define Target Modules*/
 typedef enum TTargetModule {tmNone, tmBS1, tmBS2, tmBS2e, tmBS2sx, tmBS2p, tmBS2pe, tmNumElements} TTargetModule;
 
@@ -218,7 +240,7 @@ typedef enum TErrorCode {ecS,ecECS,ecETQ,ecUC,ecEHD,ecEBD,ecSETC,ecTME,ecCESD,ec
                          ecECE,ecCMBPBS,ecLOSCSWSSE,ecEALVIOES,ecESMBPBS,ecSWE,ecEGOG,ecCCBLTO,ecIPVNMBTZTF,ecENEDDSON,
                          ecIOICCD,ecECCT,ecCCIWCCEI,ecCCSWCCE,ecCCEMBPBCCI,ecCCEIMBPBCCI,ecISICCD,ecEAUDS,ecLOSNCCICCTSE,
                          ecEACOC,ecUDE,ecECCEI,ecLOSNCCSSE,ecECCCE,ecCCCMBPBCCS,ecCCESMBPBCCS,ecEADRTSOCCE,ecEADRTSOCCES,
-                         ecECCE,ecENEDODS,ecESTFPC,ecEACVOW,ecELIMBPBI,ecLOSELISWISE,ecELINAAE,ecNumElements} TErrorCode;
+                         ecECCE,ecENEDODS,ecESTFPC,ecEACVOW,ecELIMBPBI,ecLOSELISWISE,ecELINAAE,ecSIDITOI,ecNumElements} TErrorCode;
 
 /*Define symbol table structure*/
 struct TOKENIZER_EXPORT TSymbolTable
@@ -231,6 +253,14 @@ struct TOKENIZER_EXPORT TSymbolTable
                                            or undefined DEFINE symbol (1) in Symbol variable*/
 };
 
+/*Define symbol key structure.  Each SymbolTable record's key is kept beside it (see tokenizer::SymbolKeys) rather than
+  in TSymbolTable, so the static symbol tables needn't spell out these run-time fields*/
+struct TOKENIZER_EXPORT TSymbolKey
+{
+/*4 bytes*/    unsigned int Hash;       /* Full hash of Name (set by EnterSymbol)*/
+/*1 byte */    byte         Length;     /* Length of Name (set by EnterSymbol)*/
+};
+
 /*Define custom symbol structure*/
 struct TOKENIZER_EXPORT TCustomSymbolTable
 {
@@ -238,11 +268,107 @@ struct TOKENIZER_EXPORT TCustomSymbolTable
     TSymbolTable Symbol;
 };
 
+/*Define name table structure.  Each distinct name of an undefined symbol is entered once while elementizing; its
+  element's value is then the index of its record*/
+struct TOKENIZER_EXPORT TNameTable
+{
+/*32 bytes*/    char         Name[SymbolSize+1];
+/*4 bytes*/     int          NextRecord;                       /*Next record ID if Name hash used more than once*/
+/*4 bytes*/     unsigned int Hash;                             /*Full hash of Name*/
+/*1 byte */     byte         Length;                           /*Length of Name*/
+/*4 bytes*/     int          Symbol;                           /*SymbolTable record entered for Name (set by EnterSymbol), or -1 if none yet*/
+/*1 byte */     bool         Undef;                            /*Indicates Name is in UndefSymbolTable (set by EnterUndefSymbol)*/
+};
+
 /*Define undefined symbol table structure*/
 struct TOKENIZER_EXPORT TUndefSymbolTable
 {
 /*32 bytes*/    char         Name[SymbolSize+1];
 /*4 bytes*/     int          NextRecord;                       /*Next record ID if Symbol hash used more than once*/
+/*4 bytes*/     unsigned int Hash;                             /*Full hash of Name (set by EnterUndefSymbol)*/
+/*1 byte */     byte         Length;                           /*Length of Name (set by EnterUndefSymbol)*/
+/*4 bytes*/     TDeclarationKind DeclarationKind;              /*Kind of CON, PIN or DATA line declaring symbol (set by IndexDeclarations)*/
+/*4 bytes*/     int          Declaration;                      /*Index of that line in DeclarationLines, or -1 if none (set by IndexDeclarations)*/
+};
+
+/*Define symbol table statistics structure.  Lookups, Probes and MaxProbes count searches since the start of the last
+  compile; the rest describe the symbol table as it stands*/
+struct TOKENIZER_EXPORT TSymbolStats
+{
+    unsigned int Lookups;                   /*Number of symbol table searches*/
+    unsigned int Probes;                    /*Number of symbol records examined by those searches*/
+    unsigned int MaxProbes;                 /*Most symbol records examined by a single search*/
+    unsigned int ReservedHits;              /*Number of searches answered by the reserved word perfect hash*/
+    int          Symbols;                   /*Number of symbols in the table*/
+    int          UsedVectors;               /*Number of hash vectors in use*/
+    int          LongestChain;              /*Most symbols sharing one hash vector*/
+};
+
+/*Define compile statistics structure.  Times are in nanoseconds.  Phases run twice (Data and Var) are timed as one.  Everything describes the last Compile or CompileView, even if it failed part way (see
+  tokenizer::GetCompileStats)*/
+struct TOKENIZER_EXPORT TCompileStats
+{
+    long long    PhaseTime[cpNumElements];  /*Time spent in each phase*/
+    long long    TotalTime;                 /*Time spent in the whole compile*/
+    unsigned int Elements;                  /*Number of elements entered into the element lists (source and directive)*/
+    unsigned int CancelledSkips;            /*Number of cancelled elements stepped over while retrieving elements*/
+    unsigned int CompactedElements;         /*Number of cancelled elements removed from the element list by CompactElements*/
+    unsigned int Lookups;                   /*Number of symbol table searches (see TSymbolStats)*/
+    unsigned int Probes;                    /*Number of symbol records examined along hash chains by those searches*/
+    unsigned int PatchEntries;              /*Number of forward addresses entered into the patch list*/
+    unsigned int EEPROMBits;                /*Number of program bits written to EEPROM, patches included*/
+    int          Packets;                   /*Number of download packets prepared*/
+    unsigned int ReusedLines;               /*Number of source lines whose elements were copied from the last compile (see tokenizer::SetIncremental)*/
+    unsigned int ReusedElements;            /*Number of source elements so copied*/
+    bool         ReusedResults;             /*Indicates the passes after CompileEditorDirectives were skipped and their results reused*/
+};
+
+/*Define trace event kinds*/
+typedef enum TTraceKind {tkCompile, tkPhase, tkInstruction} TTraceKind;
+
+/*Define trace event structure; one timed span of a compile.  Value is the TCompilePhase of a tkPhase span, or the
+  TInstructionType of a tkInstruction span (-1 for an assignment)*/
+struct TOKENIZER_EXPORT TTraceEvent
+{
+    long long    Start;                     /*Clock reading at the start of the span, in nanoseconds*/
+    long long    Duration;                  /*Length of the span, in nanoseconds*/
+    int          Kind;                      /*TTraceKind of the span*/
+    int          Value;
+    int          SrcStart;                  /*Start of the source the span covers*/
+    int          SrcLength;                 /*Length of the source the span covers, or 0 if none*/
+};
+
+/*Define compile trace structure.  The caller supplies Events, Capacity entries long, and clears Count and Dropped; each
+  compile traced into it (see tokenizer::SetTrace) then appends its spans*/
+struct TOKENIZER_EXPORT TCompileTrace
+{
+    TTraceEvent  *Events;
+    int          Capacity;
+    int          Count;                     /*Number of spans recorded in Events*/
+    int          Dropped;                   /*Number of spans not recorded because Events was full*/
+};
+
+/*Define source view structure; a run of characters in the caller's source, given by position rather than by pointer*/
+struct TOKENIZER_EXPORT TSourceView
+{
+    int          Start;                     /*Beginning of view in source*/
+    int          Length;                    /*Number of characters in view, 0 = none*/
+};
+
+/*Define directive views structure.  Filled by CompileView, these locate what TModuleRec's ProjectFiles and Port
+  pointers point to*/
+struct TOKENIZER_EXPORT TDirectiveViews
+{
+    TSourceView  ProjectFiles[7];           /*Paths and names of related project files, if any*/
+    TSourceView  Port;                      /*COM port to download to, if any*/
+};
+
+/*Define predefined symbol structure; a symbol entered as if by "#DEFINE Name = Value" before conditional compilation
+  (see tokenizer::CompileConditionals)*/
+struct TOKENIZER_EXPORT TDefineSymbol
+{
+    const char   *Name;                     /*Symbol name, in any case*/
+    word         Value;                     /*Value; 65535 (-1) is what "#DEFINE Name" alone gives*/
 };
 
 /*Define element list structure*/
@@ -254,6 +380,94 @@ struct TOKENIZER_EXPORT TElementList
 /*1 byte */	    byte         Length;
 };
 
+/*Define element store structure.  An element list is kept as parallel arrays, rather than as TElementList records, so
+  that scans which only check element types read one byte per element.  The arrays are carved from the tokenizer's
+  element arena and grow on demand (see tokenizer::GrowElements).*/
+struct TOKENIZER_EXPORT TElementStore
+{
+    byte         *Types;                    /*TElementType of each element*/
+    word         *Values;
+    word         *Starts;                   /*Source index of each element*/
+    byte         *Lengths;
+    int          Capacity;                  /*Number of elements the arrays can hold*/
+};
+
+/*Define element arena block structure; a block's storage follows this header*/
+struct TOKENIZER_EXPORT TArenaBlock
+{
+    TArenaBlock  *Next;                     /*Block allocated before this one, or NULL*/
+    size_t       Size;                      /*Bytes of storage in block*/
+    size_t       Used;                      /*Bytes of storage handed out*/
+};
+
+/*Define declaration line structure*/
+struct TOKENIZER_EXPORT TDeclarationLine
+{
+/*2 bytes*/     word         Start;                      /*First element of the line*/
+/*2 bytes*/     word         Key;                        /*The PIN, CON, DATA or VAR element; the line is gone once it's cancelled*/
+/*1 byte */     bool         Resolving;                  /*Indicates CON or PIN line is being compiled (see tokenizer::ResolveDeclaration)*/
+};
+
+/*Define declaration frame structure; a CON or PIN line whose dependencies are being resolved (see
+  tokenizer::ResolveDependencies)*/
+struct TOKENIZER_EXPORT TDeclarationFrame
+{
+/*4 bytes*/     TDeclarationKind Kind;
+/*4 bytes*/     int          LineIdx;                    /*Line in the DeclarationLines of Kind*/
+/*2 bytes*/     word         Next;                       /*Element of the line's constant expression to scan from next*/
+/*4 bytes*/     TOperatorCode Operation;                 /*Operation to apply to the operand at Next*/
+/*2 bytes*/     word         Value;                      /*Value of the expression before Next*/
+};
+
+/*Define lexed line structure; one line of source as a single-pass Elementize found it, kept in an element cache so
+  that the next incremental compile can copy the line's elements instead of elementizing it again (see
+  tokenizer::ReuseLines).  Element, unresolved and comment ranges run from First to End-1.*/
+struct TOKENIZER_EXPORT TLexedLine
+{
+    int          Start;                     /*Source index of first character*/
+    int          End;                       /*Source index of the ETX that ends it*/
+    int          Tail;                      /*StartOfSymbol at end of line; the ETX, or the apostrophe of a comment*/
+    int          FirstElement;              /*SourceElements index of first element*/
+    int          EndElement;
+    int          FirstUnresolved;           /*UnresolvedElements index of first entry*/
+    int          EndUnresolved;
+    int          FirstComment;              /*Comments index of first apostrophe passed to ElementizeDirective*/
+    int          EndComment;
+    bool         EntryEndEntered;           /*EndEntered at start of line*/
+    bool         ExitEndEntered;            /*EndEntered at end of line*/
+    bool         EntryLangSensitive;        /*LangSensitive at start of line*/
+    bool         ExitLangSensitive;         /*LangSensitive at end of line*/
+    bool         Lang250;                   /*Lang250 at start of line*/
+    bool         Reusable;                  /*False if the directive scan may have changed Lang250 part way through line*/
+};
+
+/*Define element cache structure; the sanitized source, raw source elements and lines of a single-pass Elementize,
+  along with what's needed to tell if the next compile elementized to the same thing (see tokenizer::SetIncremental)*/
+struct TOKENIZER_EXPORT TElementCache
+{
+    bool          Valid;                    /*Indicates cache holds a complete single-pass Elementize*/
+    char          *Source;                  /*Sanitized source; MaxSourceSize bytes*/
+    int           SourceSize;
+    TElementStore Elements;                 /*SourceElements as elementized, before ResolveElements*/
+    int           ElementCount;
+    word          *Unresolved;              /*UnresolvedElements*/
+    int           UnresolvedCount;
+    int           UnresolvedCapacity;
+    TElementStore Directives;               /*DirectiveElements*/
+    int           DirectiveCount;
+    int           *Comments;                /*Source index of each apostrophe passed to ElementizeDirective, in order*/
+    int           CommentCount;
+    int           CommentCapacity;
+    TLexedLine    *Lines;
+    int           LineCount;
+    int           LineCapacity;
+    TErrorCode    DeferredError;            /*DeferredError, DeferredErrorStart and DeferredErrorLength*/
+    int           DeferredErrorStart;
+    int           DeferredErrorLength;
+    bool          ElementizedLang250;
+    bool          Relex;
+};
+
 /*Define source token crossreference structure*/
 struct TOKENIZER_EXPORT TSrcTokReference
 {
@@ -307,49 +521,29 @@ struct TOKENIZER_EXPORT TModuleRec
 /*1*(EEPROMSize/16*18) bytes*/ TPacketType  PacketBuffer;       /*packet data*/
 };
 
-/*Define global variables*/
-extern TModuleRec        *tzModuleRec;                         /*tzModuleRec is a pointer to an externally accessible structure*/
-extern char              *tzSource;                            /*tzSource is a pointer to an externally accessible byte array*/
-extern TSrcTokReference  *tzSrcTokReference;                   /*tzSrcTokReference is a pointer to an externally accessible Source vs. Token Reference array*/
-extern TSymbolTable      Symbol;
-extern TSymbolTable      Symbol2;
-extern TSymbolTable      SymbolTable[SymbolTableSize];
-extern int               SymbolVectors[SymbolTableSize];       /*Vectors used for hashing into Symbol Table*/
-extern int               SymbolTablePointer;
-extern TUndefSymbolTable UndefSymbolTable[SymbolTableSize];
-extern int               UndefSymbolVectors[SymbolTableSize];  /*Vectors used for hashing into Undefined Symbol Table.  Used to distinguish between undefined DEFINE'd symbols and undefined DATA, VAR, CON or PIN symbols*/
-extern int               UndefSymbolTablePointer;
-extern TElementList      ElementList[ElementListSize];
-extern word              ElementListIdx;
-extern word              ElementListEnd;
-extern word              EEPROMPointers[EEPROMSize*2];
-extern word              EEPROMIdx;
-extern word              GosubCount;
-extern word              PatchList[PatchListSize];
-extern int               PatchListIdx;
-extern TNestingStack     NestingStack[NestingStackSize];
-extern byte              NestingStackIdx;                      /*Index of next available nesting stack element*/
-extern byte              ForNextCount;                         /*Current count of Nested FOR..NEXT loops*/
-extern byte              IfThenCount;                          /*Current count of Nested IF THENs*/
-extern byte              DoLoopCount;                          /*Current count of Nested DO..LOOPs*/
-extern byte              SelectCount;                          /*Current count of Nested SELECT CASEs*/
-extern word              Expression[4][int(ExpressionSize / 16)]; /*4 arrays of (1 word size, N words data)*/
-extern byte              ExpressionStack[256];
-extern byte              ExpStackTop;
-extern byte              ExpStackBottom;
-extern byte              StackIdx;                             /*Run-time stack pointer*/
-extern byte              ParenCount;
-extern int               SrcIdx;                               /*Used by Element Engine*/
-extern word              StartOfSymbol;                        /*Used by Element Engine*/
-extern byte              CurChar;                              /*Used by Element Engine*/
-extern TElementType      ElementType;                /*Used by Element Engine*/
-extern bool		      	   EndEntered;								           /*Used by Element Engine.  Indicates if End was just entered.*/
-extern bool              AllowStampDirective;                  /*Set by Compile routine*/
-extern byte              VarBitCount;                          /*# of var bits; used by variable parsing routines*/
-extern byte              VarBases[4];                          /*start of.. [0]=bits, [1]=nibbles, [2]=bytes, [3]=words*; used by variable parsing routines*/
-extern bool              Lang250;                              /*False = PBASIC 2.00, True = PBASIC 2.50*/
-extern int               SrcTokReferenceIdx;
-
+/*Define incremental compile structure; element caches of the last two compiles (Caches[Current] is the last) and the
+  results of the last compile's passes after CompileEditorDirectives, which are reused if its source elementized to
+  the same elements as the one before, but for position.  Results.Error is kept as ErrorText.*/
+struct TOKENIZER_EXPORT TIncrementalState
+{
+    TElementCache    Caches[2];
+    int              Current;
+    bool             Recorded;              /*Indicates this compile's Elementize was recorded in Caches[Current]*/
+    bool             Unchanged;             /*Indicates it matched Caches[1-Current], whose Results were valid (see tokenizer::SameElementCaches)*/
+    int              Prefix;                /*Source before Prefix is the same as in the last compile...*/
+    int              OldSuffix;             /*...and so is source from OldSuffix on (from NewSuffix on, now)*/
+    int              NewSuffix;
+    bool             ResultsValid;          /*Indicates Results are those of Caches[Current]'s compile*/
+    bool             ParseStampDirective;   /*Inputs of that compile*/
+    bool             Referenced;
+    byte             TargetModule;
+    int              LanguageVersion;
+    int              ErrorOffset;           /*Results.Error's offset in Results.PacketBuffer, -1 if it's ErrorText, -2 if NULL*/
+    char             ErrorText[1024];
+    int              ReferenceCount;
+    TSrcTokReference References[SrcTokRefSize];
+    TModuleRec       Results;
+};
 
 /*Define global constants*/
 const int SymbolTableLimit   = SymbolTableSize-SymbolSize-5;
@@ -442,8 +636,11 @@ const byte InstCode[icNumElements][tmNumElements-2 /*tmNone and tmBS1 are missin
 calling program*/
 extern const char *Errors[ecNumElements];
 
+/*Define compile phase names, for reporting TCompileStats*/
+extern const char *CompilePhases[cpNumElements];
+
 /*Common Symbols are used by all Stamps.  See Custom Symbols for Stamp Module-specific symbols*/
-extern TSymbolTable CommonSymbols[363];
+extern const TSymbolTable CommonSymbols[CommonSymbolTableSize];
 
   /*Custom Symbols are those that are either not supported by every Stamp or not supported by every version of the PBASIC
   language syntax.  The Targets field is a bit pattern that defines the module which supports the particular symbol and
@@ -455,7 +652,19 @@ extern TSymbolTable CommonSymbols[363];
   the Target Module and Language Version is identified.*/
 
 #define CustomSymbolTableSize 53    /*Size of Custom Symbol Table (used in more than one place)*/
-extern TCustomSymbolTable CustomSymbols[CustomSymbolTableSize];
+extern const TCustomSymbolTable CustomSymbols[CustomSymbolTableSize];
+
+#define ReservedWordCount     (CommonSymbolTableSize+CustomSymbolTableSize)   /*Number of reserved words (automatic symbols)*/
+
+/*Define symbol image structure; the automatic symbols for one target module and PBASIC Language version, ready to load
+  into SymbolTable.  ReservedVectors gives the SymbolTable index of each reserved word (indexed by its perfect hash
+  slot), or -1 if that word is not available for the target module and version.*/
+struct TOKENIZER_EXPORT TSymbolImage
+{
+    TSymbolTable SymbolTable[ReservedWordCount];
+    short        ReservedVectors[ReservedWordCount];
+    int          SymbolTablePointer;
+};
 
 
 #endif
@@ -0,0 +1,38 @@
+#ifndef __SERVER_PROTOCOL_H__
+#define __SERVER_PROTOCOL_H__
+
+#include <stdint.h>
+
+#include "tokenizer/tokenizer.hpp"  /* Make sure this is the last include! */
+
+#define ServerMagic     0x53544250              /*"PBTS"*/
+#define ServerVersion   1                       /*Bump when TServerBlock changes*/
+#define ErrorTextSize   256
+
+/*Define server replies*/
+typedef enum TServerReply {srFailed, srSucceeded, srMalformed} TServerReply;
+
+/*Define shared compile block.  A client makes a shared memory object at least sizeof(TServerBlock) bytes long, fills in
+  the request fields and Source, and sends the object's file descriptor to the server's Unix domain socket (as
+  SCM_RIGHTS ancillary data on one byte of data).  A pre-warmed child of the server compiles Source where it is (it's
+  only read), fills in the result fields and answers with one TServerReply byte.  The block holds no pointers, so it
+  means the same in every process that maps it.*/
+struct TServerBlock
+{
+    uint32_t          Magic;                    /*ServerMagic*/
+    uint32_t          Version;                  /*ServerVersion*/
+    /*Request*/
+    int32_t           SourceSize;               /*Length of Source; less than MaxSourceSize*/
+    byte              DirectivesOnly;           /*As for tokenizer::CompileView*/
+    byte              ParseStampDirective;
+    byte              TargetModule;             /*Target module to compile for, if not ParseStampDirective*/
+    /*Results*/
+    TModuleRec        Rec;                      /*As tokenizer::CompileView gives it, but with all pointer fields NULL (see Views and ErrorText)*/
+    TDirectiveViews   Views;                    /*Where Rec's ProjectFiles and Port are in Source*/
+    char              ErrorText[ErrorTextSize]; /*Rec's Error string (cut short if need be), or empty if none*/
+    int32_t           ReferenceCount;           /*Number of References in use*/
+    TSrcTokReference  References[SrcTokRefSize];
+    char              Source[MaxSourceSize];
+};
+
+#endif
@@ -0,0 +1,393 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_server.cpp                                                                                                           */
+/*                                                                                                                                               */
+/* PURPOSE:       Fork server: warms up a tokenizer once, then compiles each request on a Unix domain socket in a child forked from the warm     */
+/*                process, returning the results through the shared memory the request came in.                                                  */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "server_protocol.hpp"
+
+#define DefaultChildren   16                    /*Most children compiling at once, unless -j says otherwise*/
+#define RequestTimeout    10                    /*Seconds a child waits for its request before giving up*/
+
+static volatile sig_atomic_t Stopping = 0;
+static int                   StopPipe[2];     /*Self-pipe; Stop writes to it so a signal can't slip in before poll*/
+
+/*------------------------------------------------------------------------------*/
+
+static void Stop(int Signal)
+/*Ask the server loop to stop*/
+{
+  int  Saved;
+
+  (void) Signal;
+  Saved = errno;
+  Stopping = 1;
+  if (write(StopPipe[1], "", 1) < 0) {}        /*Pipe full means a wake-up is already pending*/
+  errno = Saved;
+}
+
+/*------------------------------------------------------------------------------*/
+
+static bool SetAddress(struct sockaddr_un *Address, const char *Path)
+/*Set Address to the Unix domain socket Path.  Returns False if Path is too long.*/
+{
+  memset(Address, 0, sizeof(*Address));
+  Address->sun_family = AF_UNIX;
+  if (strlen(Path) >= sizeof(Address->sun_path))
+    {
+    fprintf(stderr, "Socket path too long: %s\n", Path);
+    return(False);
+    }
+  strcpy(Address->sun_path, Path);
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static void Warm(tokenizer *Tokenizer, TModuleRec *Rec)
+/*Build the shared symbol images for every target module and language version, and compile a small program for each
+  target, so the reserved-word tables, the source scanner, the element arena and the tokenizer's own pages are all in
+  place before any child is forked*/
+{
+  static const char Program[] = "' {$PBASIC 2.5}\r#DEFINE Fast = 1\rx VAR Byte\r#IF Fast #THEN\rx = x + 1\r#ENDIF\rDEBUG DEC x, CR\rEND\r";
+  byte Module;
+
+  for (Module = tmBS2; Module < tmNumElements; Module++)
+    {
+    (void) tokenizer::GetSymbolImage(Module, False);
+    (void) tokenizer::GetSymbolImage(Module, True);
+    memset(Rec, 0, sizeof(TModuleRec));
+    Rec->TargetModule = Module;
+    Tokenizer->CompileView(Rec, Program, (int) sizeof(Program)-1, False, False, NULL, NULL);
+    }
+}
+
+/*------------------------------------------------------------------------------*/
+
+static bool ReceiveBlock(int Connection, int *Fd)
+/*Receive a request's shared memory file descriptor from Connection into *Fd.  Returns True if successful.*/
+{
+  struct msghdr   Message;
+  struct iovec    Data;
+  struct cmsghdr  *Control;
+  char            Byte;
+  union
+    {
+    struct cmsghdr  Header;
+    char            Space[CMSG_SPACE(sizeof(int))];
+    } Buffer;
+
+  memset(&Message, 0, sizeof(Message));
+  Data.iov_base = &Byte;
+  Data.iov_len = 1;
+  Message.msg_iov = &Data;
+  Message.msg_iovlen = 1;
+  Message.msg_control = Buffer.Space;
+  Message.msg_controllen = sizeof(Buffer.Space);
+  if (recvmsg(Connection, &Message, 0) != 1) return(False);
+  Control = CMSG_FIRSTHDR(&Message);
+  if ( (Control == NULL) || (Control->cmsg_level != SOL_SOCKET) || (Control->cmsg_type != SCM_RIGHTS) || (Control->cmsg_len != CMSG_LEN(sizeof(int))) ) return(False);
+  memcpy(Fd, CMSG_DATA(Control), sizeof(int));
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static bool SendBlock(int Connection, int Fd)
+/*Send shared memory file descriptor Fd over Connection.  Returns True if successful.*/
+{
+  struct msghdr   Message;
+  struct iovec    Data;
+  struct cmsghdr  *Control;
+  char            Byte;
+  union
+    {
+    struct cmsghdr  Header;
+    char            Space[CMSG_SPACE(sizeof(int))];
+    } Buffer;
+
+  memset(&Message, 0, sizeof(Message));
+  memset(&Buffer, 0, sizeof(Buffer));
+  Byte = 0;
+  Data.iov_base = &Byte;
+  Data.iov_len = 1;
+  Message.msg_iov = &Data;
+  Message.msg_iovlen = 1;
+  Message.msg_control = Buffer.Space;
+  Message.msg_controllen = sizeof(Buffer.Space);
+  Control = CMSG_FIRSTHDR(&Message);
+  Control->cmsg_level = SOL_SOCKET;
+  Control->cmsg_type = SCM_RIGHTS;
+  Control->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(Control), &Fd, sizeof(int));
+  return(sendmsg(Connection, &Message, 0) == 1);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static TServerReply CompileBlock(tokenizer *Tokenizer, TServerBlock *Block)
+/*Compile the request in Block and fill in its results*/
+{
+  TModuleRec  *Rec;
+  int         Idx;
+
+  if ( (Block->Magic != ServerMagic) || (Block->Version != ServerVersion) || (Block->SourceSize < 0) || (Block->SourceSize >= MaxSourceSize) ) return(srMalformed);
+  Rec = &Block->Rec;
+  memset(Rec, 0, sizeof(TModuleRec));
+  Rec->TargetModule = Block->TargetModule;
+  Tokenizer->CompileView(Rec, Block->Source, Block->SourceSize, Block->DirectivesOnly, Block->ParseStampDirective, Block->References, &Block->Views);
+  /*Drop the pointers, which mean nothing to the client*/
+  Block->ErrorText[0] = 0;
+  if (Rec->Error != NULL)
+    {
+    strncpy(Block->ErrorText, Rec->Error, ErrorTextSize-1);
+    Block->ErrorText[ErrorTextSize-1] = 0;
+    }
+  Rec->Error = NULL;
+  Rec->Port = NULL;
+  for (Idx = 0; Idx < 7; Idx++) Rec->ProjectFiles[Idx] = NULL;
+  Block->ReferenceCount = Tokenizer->SrcTokReferenceIdx;
+  return(Rec->Succeeded ? srSucceeded : srFailed);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static void ServeRequest(tokenizer *Tokenizer, int Connection)
+/*Serve the one request on Connection (in a child of the server)*/
+{
+  struct timeval  Timeout;
+  struct stat     Status;
+  TServerBlock    *Block;
+  char            Reply;
+  int             Fd;
+
+  Timeout.tv_sec = RequestTimeout;
+  Timeout.tv_usec = 0;
+  setsockopt(Connection, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+  if (!ReceiveBlock(Connection, &Fd)) return;
+  Reply = srMalformed;
+  if ( (fstat(Fd, &Status) == 0) && (Status.st_size >= (off_t) sizeof(TServerBlock)) )
+    {
+    Block = (TServerBlock *) mmap(NULL, sizeof(TServerBlock), PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+    if (Block != MAP_FAILED)
+      {
+      Reply = CompileBlock(Tokenizer, Block);
+      munmap(Block, sizeof(TServerBlock));
+      }
+    }
+  close(Fd);
+  (void) send(Connection, &Reply, 1, 0);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static int Serve(const char *Path, int MaxChildren)
+/*Warm up, then serve requests on the Unix domain socket Path, forking a child for each, with up to MaxChildren at
+  once, until SIGINT or SIGTERM.  Returns the exit status.*/
+{
+  struct sockaddr_un  Address;
+  struct sigaction    Action;
+  struct pollfd       Polls[2];
+  tokenizer           *Tokenizer;
+  TModuleRec          *Rec;
+  pid_t               Child;
+  int                 Listener;
+  int                 Connection;
+  int                 Children;
+
+  if (!SetAddress(&Address, Path)) return(2);
+  Tokenizer = new tokenizer;
+  Rec = new TModuleRec;
+  Warm(Tokenizer, Rec);
+  if ((Listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+    perror("socket");
+    return(2);
+    }
+  unlink(Path);                                 /*Remove a socket left by an earlier server*/
+  if ( (bind(Listener, (struct sockaddr *) &Address, sizeof(Address)) < 0) || (listen(Listener, SOMAXCONN) < 0) )
+    {
+    perror(Path);
+    return(2);
+    }
+  if ( (pipe(StopPipe) < 0) || (fcntl(StopPipe[0], F_SETFL, O_NONBLOCK) < 0) || (fcntl(StopPipe[1], F_SETFL, O_NONBLOCK) < 0) ||
+       (fcntl(Listener, F_SETFL, O_NONBLOCK) < 0) )
+    {
+    perror("pipe");
+    return(2);
+    }
+  memset(&Action, 0, sizeof(Action));
+  Action.sa_handler = Stop;                     /*No SA_RESTART, so a blocking waitpid returns when asked to stop*/
+  sigaction(SIGINT, &Action, NULL);
+  sigaction(SIGTERM, &Action, NULL);
+  signal(SIGPIPE, SIG_IGN);
+  Children = 0;
+  while (!Stopping)
+    {
+    while ((Children > 0) && (waitpid(-1, NULL, (Children < MaxChildren ? WNOHANG : 0)) > 0)) Children--;
+    /*Wait for a connection or a stop signal; a signal since the Stopping check is still in the pipe*/
+    Polls[0].fd = Listener;
+    Polls[0].events = POLLIN;
+    Polls[1].fd = StopPipe[0];
+    Polls[1].events = POLLIN;
+    if (poll(Polls, 2, -1) < 0)
+      {
+      if (errno == EINTR) continue;
+      perror("poll");
+      break;
+      }
+    if (Polls[1].revents != 0) break;
+    if ((Connection = accept(Listener, NULL, NULL)) < 0)
+      {
+      if ((errno == EINTR) || (errno == ECONNABORTED) || (errno == EAGAIN) || (errno == EWOULDBLOCK)) continue;
+      perror("accept");
+      break;
+      }
+    fcntl(Connection, F_SETFL, fcntl(Connection, F_GETFL) & ~O_NONBLOCK);  /*Some systems pass on the listener's O_NONBLOCK*/
+    Child = fork();
+    if (Child == 0)
+      { /*Child; compile with the warm tokenizer, then go*/
+      close(Listener);
+      close(StopPipe[0]);
+      close(StopPipe[1]);
+      signal(SIGINT, SIG_DFL);
+      signal(SIGTERM, SIG_DFL);
+      ServeRequest(Tokenizer, Connection);
+      _exit(0);
+      }
+    if (Child < 0) perror("fork"); else Children++;
+    close(Connection);
+    }
+  close(Listener);
+  close(StopPipe[0]);
+  close(StopPipe[1]);
+  unlink(Path);
+  while (Children-- > 0) waitpid(-1, NULL, 0);
+  return(0);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static int Request(const char *Path, const char *FileName, int TargetModule)
+/*Compile FileName through the server at Path (for TargetModule, if not -1, otherwise for its $STAMP directive) and
+  print the results.  Returns the exit status: 0 if it compiled, 1 if it didn't, 2 if the request failed.*/
+{
+  struct sockaddr_un  Address;
+  TServerBlock        *Block;
+  FILE                *File;
+  char                Name[64];
+  char                Reply;
+  int                 Fd;
+  int                 Connection;
+  int                 Result;
+
+  if ( (TargetModule != -1) && ((TargetModule < tmBS2) || (TargetModule > tmBS2pe)) )
+    {
+    fprintf(stderr, "Target must be %d (BS2) to %d (BS2pe)\n", tmBS2, tmBS2pe);
+    return(2);
+    }
+  if (!SetAddress(&Address, Path)) return(2);
+  /*Make an unnamed shared memory object for the block*/
+  snprintf(Name, sizeof(Name), "/tokenizer-%ld", (long) getpid());
+  if ((Fd = shm_open(Name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+    {
+    perror("shm_open");
+    return(2);
+    }
+  shm_unlink(Name);
+  if ( (ftruncate(Fd, sizeof(TServerBlock)) < 0) ||
+       ((Block = (TServerBlock *) mmap(NULL, sizeof(TServerBlock), PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0)) == MAP_FAILED) )
+    {
+    perror("shared memory");
+    return(2);
+    }
+  /*Fill in the request*/
+  if ((File = fopen(FileName, "rb")) == NULL)
+    {
+    perror(FileName);
+    return(2);
+    }
+  Block->SourceSize = (int32_t) fread(Block->Source, 1, MaxSourceSize, File);
+  fclose(File);
+  if (Block->SourceSize >= MaxSourceSize)
+    {
+    fprintf(stderr, "%s: too big\n", FileName);
+    return(2);
+    }
+  Block->Magic = ServerMagic;
+  Block->Version = ServerVersion;
+  Block->DirectivesOnly = False;
+  Block->ParseStampDirective = (TargetModule < 0);
+  Block->TargetModule = (TargetModule < 0 ? (byte) tmNone : (byte) TargetModule);
+  /*Send it and wait for the reply*/
+  if ( ((Connection = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) || (connect(Connection, (struct sockaddr *) &Address, sizeof(Address)) < 0) ||
+       !SendBlock(Connection, Fd) || (recv(Connection, &Reply, 1, 0) != 1) )
+    {
+    perror(Path);
+    return(2);
+    }
+  close(Connection);
+  close(Fd);
+  switch (Reply)
+    {
+    case srSucceeded : printf("Succeeded: target %d, PBASIC %d, %d packets, %d references\n", Block->Rec.TargetModule, Block->Rec.LanguageVersion,
+                              Block->Rec.PacketCount, Block->ReferenceCount);
+                       Result = 0;
+                       break;
+    case srFailed    : printf("Failed at %d (length %d): %s\n", Block->Rec.ErrorStart, Block->Rec.ErrorLength, Block->ErrorText);
+                       Result = 1;
+                       break;
+    default          : fprintf(stderr, "Malformed request\n");
+                       Result = 2;
+                       break;
+    }
+  munmap(Block, sizeof(TServerBlock));
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static int Usage(void)
+/*Print usage.  Returns the exit status.*/
+{
+  fprintf(stderr, "usage: tokenizer_server [-j children] socket\n"
+                  "       tokenizer_server -c socket file [target]\n"
+                  "Serve compile requests on the Unix domain socket, or (-c) compile file through the server at socket,\n"
+                  "for target module number target (2 = BS2 .. 6 = BS2pe) or else as its $STAMP directive says.\n");
+  return(2);
+}
+
+/*------------------------------------------------------------------------------*/
+
+int main(int argc, char **argv)
+{
+  int  Children;
+
+  if ( (argc >= 4) && (argc <= 5) && (strcmp(argv[1], "-c") == 0) ) return(Request(argv[2], argv[3], (argc == 5 ? atoi(argv[4]) : -1)));
+  Children = DefaultChildren;
+  if ( (argc == 4) && (strcmp(argv[1], "-j") == 0) )
+    {
+    Children = atoi(argv[2]);
+    argv += 2;
+    argc -= 2;
+    }
+  if ( (argc != 2) || (Children < 1) || (argv[1][0] == '-') ) return(Usage());
+  return(Serve(argv[1], Children));
+}
@@ -0,0 +1,51 @@
+#!/bin/sh
+# Smoke test for tokenizer_server: start it on a temporary socket, compile through it with -c, check the exit
+# statuses, then stop it with SIGTERM.  Usage: smoke.sh path/to/tokenizer_server
+
+Server=$1
+Dir=$(mktemp -d) || exit 1
+Socket=$Dir/server.sock
+Pid=
+trap 'if [ -n "$Pid" ]; then kill "$Pid" 2>/dev/null; fi; rm -rf "$Dir"' EXIT
+
+Fail()
+{
+  echo "FAILED: $*" >&2
+  exit 1
+}
+
+Expect()
+{
+  Want=$1
+  shift
+  "$Server" -c "$Socket" "$@"
+  Got=$?
+  [ "$Got" -eq "$Want" ] || Fail "-c $* exited $Got, expected $Want"
+}
+
+printf "' {\$STAMP BS2}\r' {\$PBASIC 2.5}\rx VAR Byte\rx = x + 1\rDEBUG DEC x, CR\rEND\r" > "$Dir/good.bs2"
+printf "' {\$STAMP BS2}\r' {\$PBASIC 2.5}\rx VAR Byte\rFREQOUT 0, x\rEND\r" > "$Dir/bad.bs2"
+
+"$Server" -j 2 "$Socket" &
+Pid=$!
+Tries=0
+while [ ! -S "$Socket" ]; do
+  Tries=$((Tries + 1))
+  [ "$Tries" -le 100 ] || Fail "server didn't start"
+  kill -0 "$Pid" 2>/dev/null || Fail "server exited"
+  sleep 0.1
+done
+
+Expect 0 "$Dir/good.bs2"        # As its $STAMP directive says
+Expect 0 "$Dir/good.bs2" 6      # For the BS2pe
+Expect 1 "$Dir/bad.bs2"
+Expect 2 "$Dir/good.bs2" 1      # The BS1 isn't supported
+Expect 2 "$Dir/missing.bs2"
+
+kill -TERM "$Pid"
+wait "$Pid"
+Status=$?
+Pid=
+[ "$Status" -eq 0 ] || Fail "server exited $Status after SIGTERM"
+[ ! -e "$Socket" ] || Fail "server left its socket behind"
+echo "Passed"
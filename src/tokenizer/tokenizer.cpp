@@ -89,50 +89,23 @@
 #include <dlfcn.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+  #include <immintrin.h>
+#endif
 
 #include "tokenizer/tokenizer.hpp"
 
-TModuleRec        *tzModuleRec;                         /*tzModuleRec is a pointer to an externally accessible structure*/
-char              *tzSource;                            /*tzSource is a pointer to an externally accessible byte array*/
-TSrcTokReference  *tzSrcTokReference;                   /*tzSrcTokReference is a pointer to an externally accessible Source vs. Token Reference array*/
-TSymbolTable      Symbol;
-TSymbolTable      Symbol2;
-TSymbolTable      SymbolTable[SymbolTableSize];
-int               SymbolVectors[SymbolTableSize];       /*Vectors used for hashing into Symbol Table*/
-int               SymbolTablePointer;
-TUndefSymbolTable UndefSymbolTable[SymbolTableSize];
-int               UndefSymbolVectors[SymbolTableSize];  /*Vectors used for hashing into Undefined Symbol Table.  Used to distinguish between undefined DEFINE'd symbols and undefined DATA, VAR, CON or PIN symbols*/
-int               UndefSymbolTablePointer;
-TElementList      ElementList[ElementListSize];
-word              ElementListIdx;
-word              ElementListEnd;
-word              EEPROMPointers[EEPROMSize*2];
-word              EEPROMIdx;
-word              GosubCount;
-word              PatchList[PatchListSize];
-int               PatchListIdx;
-TNestingStack     NestingStack[NestingStackSize];
-byte              NestingStackIdx;                      /*Index of next available nesting stack element*/
-byte              ForNextCount;                         /*Current count of Nested FOR..NEXT loops*/
-byte              IfThenCount;                          /*Current count of Nested IF THENs*/
-byte              DoLoopCount;                          /*Current count of Nested DO..LOOPs*/
-byte              SelectCount;                          /*Current count of Nested SELECT CASEs*/
-word              Expression[4][int(ExpressionSize / 16)]; /*4 arrays of (1 word size, N words data)*/
-byte              ExpressionStack[256];
-byte              ExpStackTop;
-byte              ExpStackBottom;
-byte              StackIdx;                             /*Run-time stack pointer*/
-byte              ParenCount;
-int               SrcIdx;                               /*Used by Element Engine*/
-word              StartOfSymbol;                        /*Used by Element Engine*/
-byte              CurChar;                              /*Used by Element Engine*/
-TElementType      ElementType = etUndef;                /*Used by Element Engine*/
-bool		      	   EndEntered;								           /*Used by Element Engine.  Indicates if End was just entered.*/
-bool              AllowStampDirective;                  /*Set by Compile routine*/
-byte              VarBitCount;                          /*# of var bits; used by variable parsing routines*/
-byte              VarBases[4];                          /*start of.. [0]=bits, [1]=nibbles, [2]=bytes, [3]=words*; used by variable parsing routines*/
-bool              Lang250;                              /*False = PBASIC 2.00, True = PBASIC 2.50*/
-int               SrcTokReferenceIdx;
+/*Compile statistics.  TimePhase(Phase, Call) evaluates Call (which must give a TErrorCode), adding the time it took to
+  Phase; CountStat(Field, N) adds N to a CompileStats counter.  Both reduce to the bare Call, or to nothing, when
+  CompileStatistics isn't defined.*/
+#if defined(CompileStatistics)
+  #define TimePhase(Phase, Call)  (BeginPhase(), EndPhase(Phase, (Call)))
+  #define CountStat(Field, N)     (CompileStats.Field += (N))
+#else
+  #define TimePhase(Phase, Call)  (Call)
+  #define CountStat(Field, N)
+#endif
 
 const char *Errors[ecNumElements]
             = { /*ecS*/              "000-Success",
@@ -252,9 +225,38 @@ const char *Errors[ecNumElements]
                 /*ecEACVOW*/         "227-Expected a constant, variable or \'WORD\'",
                 /*ecELIMBPBI*/       "228-\'ELSEIF\' must be preceded by \'IF\'",
                 /*ecLOSELISWISE*/    "229-Limit of 16 ELSEIF statements within IF structure exceeded",
-                /*ecELINAAE*/        "230-\'ELSEIF\' not allowed after \'ELSE\'"};
+                /*ecELINAAE*/        "230-\'ELSEIF\' not allowed after \'ELSE\'",
+                /*ecSIDITOI*/        "231-Symbol is defined in terms of itself"};
+
+const char *CompilePhases[cpNumElements]
+            = { /*cpInitSymbols*/      "InitSymbols",
+                /*cpElementize*/       "Elementize",
+                /*cpEditorDirectives*/ "CompileEditorDirectives",
+                /*cpAdjustSymbols*/    "AdjustSymbols",
+                /*cpResolveElements*/  "ResolveElements",
+                /*cpCCDirectives*/     "CompileCCDirectives",
+                /*cpPins*/             "CompilePins",
+                /*cpConstants*/        "CompileConstants",
+                /*cpData*/             "CompileData",
+                /*cpVar*/              "CompileVar",
+                /*cpCountGosubs*/      "CountGosubs",
+                /*cpCompactElements*/  "CompactElements",
+                /*cpInstructions*/     "CompileInstructions",
+                /*cpPatchAddresses*/   "PatchRemainingAddresses",
+                /*cpPreparePackets*/   "PreparePackets"};
+
+#if defined(CompileStatistics)
+static long long StatsClock(void)
+/*Return a monotonic clock reading in nanoseconds*/
+{
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return((long long) Now.tv_sec * 1000000000 + Now.tv_nsec);
+}
+#endif
 
-TSymbolTable CommonSymbols[363] =
+constexpr TSymbolTable CommonSymbols[CommonSymbolTableSize] =
                   {{"IN0",         etVariable,       0x0000 /*%00 00000000*/},
                     {"IN1",         etVariable,       0x0001 /*%00 00000001*/},
                     {"IN2",         etVariable,       0x0002 /*%00 00000010*/},
@@ -636,7 +638,7 @@ TSymbolTable CommonSymbols[363] =
                     {"MSBPOST",     etConstant,       0x0002 /*%0 xxxxxx10*/},
                     {"LSBPOST",     etConstant,       0x0003 /*%0 xxxxxx11*/}};
 
-TCustomSymbolTable CustomSymbols[CustomSymbolTableSize] =
+constexpr TCustomSymbolTable CustomSymbols[CustomSymbolTableSize] =
         {{0xFC, /*1111 1100*/ { "GET",        etInstruction,   int(itGet)}},
         {0xFC, /*1111 1100*/ { "PUT",        etInstruction,   int(itPut)}},
         {0xFC, /*1111 1100*/ { "RUN",        etInstruction,   int(itRun)}},
@@ -693,6 +695,308 @@ TCustomSymbolTable CustomSymbols[CustomSymbolTableSize] =
         {0xBE, /*1011 1110*/ { "CRSRX",      etConstant,      0x000E /*14*/}},
         {0xBE, /*1011 1110*/ { "CRSRY",      etConstant,      0x000F /*15*/}}};
 
+/*------------------------------------------------------------------------------*/
+/*------------------------- Reserved Word Perfect Hash -------------------------*/
+/*------------------------------------------------------------------------------*/
+
+/*Every reserved word (all names in CommonSymbols and CustomSymbols) gets its own slot in a minimal perfect hash built by
+  the compiler from those tables.  A word's symbol hash picks one of ReservedBucketCount buckets, and that bucket's
+  displacement scrambles the same hash into the word's slot, so recognizing a reserved word costs one probe and one
+  compare.  Slots are numbered 0..ReservedWordCount-1 and index each TSymbolImage's ReservedVectors.*/
+
+#define ReservedBucketCount     128     /*Number of perfect hash buckets (MUST BE POWER OF 2)*/
+#define ReservedBucketLimit     16      /*Largest bucket the perfect hash builder can place*/
+
+/*Define reserved word perfect hash structure*/
+struct TReservedWordHash
+{
+    word         Displacement[ReservedBucketCount];   /*Per-bucket displacement*/
+    short        Word[ReservedWordCount];             /*Reserved word in each slot; 0..362 = CommonSymbols, 363.. = CustomSymbols*/
+    unsigned int Hash[ReservedWordCount];             /*Symbol hash of the reserved word in each slot*/
+};
+
+constexpr unsigned int SymbolNameHash(const char *SymbolName, byte *Length)
+/*Calculate 32-bit FNV-1a hash from characters within SymbolName and set Length to the number of characters*/
+{
+  int          Idx = 0;
+  unsigned int Hash = 2166136261u;
+
+  for (Idx = 0; *(SymbolName+Idx) != 0; Idx++) Hash = (Hash ^ (byte)*(SymbolName+Idx)) * 16777619u;
+  *Length = (byte)Idx;
+  return(Hash);
+}
+
+constexpr unsigned int ReservedSlot(unsigned int Hash, word Displacement)
+/*Scramble Hash by Displacement into a slot number*/
+{
+  unsigned int Mix = Hash + Displacement * 0x9E3779B9u;
+
+  Mix = (Mix ^ (Mix >> 16)) * 0x85EBCA6Bu;
+  Mix = (Mix ^ (Mix >> 13)) * 0xC2B2AE35u;
+  return((Mix ^ (Mix >> 16)) % ReservedWordCount);
+}
+
+constexpr const char *ReservedWordName(int Word)
+/*Return name of reserved word number Word*/
+{
+  return(Word < CommonSymbolTableSize ? CommonSymbols[Word].Name : CustomSymbols[Word-CommonSymbolTableSize].Symbol.Name);
+}
+
+constexpr TReservedWordHash BuildReservedWordHash(void)
+/*Place every reserved word into its own slot.  Buckets are placed largest first; for each, displacements are tried in
+  turn until every word in the bucket lands in a distinct free slot.  Fails to compile if no placement is found.*/
+{
+  TReservedWordHash Table = {};
+  byte              Length = 0;
+  unsigned int      Hash[ReservedWordCount] = {};
+  int               BucketSize[ReservedBucketCount] = {};
+  int               BucketStart[ReservedBucketCount+1] = {};
+  int               Members[ReservedWordCount] = {};
+  int               Fill[ReservedBucketCount] = {};
+  bool              Used[ReservedWordCount] = {};
+  int               Slots[ReservedBucketLimit] = {};
+  int               Size = 0;
+  int               Bucket = 0;
+  int               Idx = 0;
+  int               Prior = 0;
+  unsigned int      Displacement = 0;
+  bool              Placed = False;
+
+  /*Sort reserved words by bucket*/
+  for (Idx = 0; Idx < ReservedWordCount; Idx++)
+    {
+    Hash[Idx] = SymbolNameHash(ReservedWordName(Idx), &Length);
+    BucketSize[Hash[Idx] & (ReservedBucketCount-1)]++;
+    }
+  for (Bucket = 0; Bucket < ReservedBucketCount; Bucket++) BucketStart[Bucket+1] = BucketStart[Bucket] + BucketSize[Bucket];
+  for (Idx = 0; Idx < ReservedWordCount; Idx++)
+    {
+    Bucket = Hash[Idx] & (ReservedBucketCount-1);
+    Members[BucketStart[Bucket] + Fill[Bucket]++] = Idx;
+    }
+  for (Idx = 0; Idx < ReservedWordCount; Idx++) Table.Word[Idx] = -1;
+  /*Place buckets, largest first*/
+  for (Size = ReservedBucketLimit; Size > 0; Size--)
+    for (Bucket = 0; Bucket < ReservedBucketCount; Bucket++)
+      {
+      if (BucketSize[Bucket] > ReservedBucketLimit) throw "Reserved word bucket too large";
+      if (BucketSize[Bucket] != Size) continue;
+      for (Displacement = 0, Placed = False; !Placed; Displacement++)
+        {
+        if (Displacement > 0xFFFF) throw "No reserved word displacement found";
+        Placed = True;
+        for (Idx = 0; Placed && (Idx < Size); Idx++)
+          {
+          Slots[Idx] = (int)ReservedSlot(Hash[Members[BucketStart[Bucket]+Idx]], (word)Displacement);
+          Placed = !Used[Slots[Idx]];
+          for (Prior = 0; Placed && (Prior < Idx); Prior++) Placed = (Slots[Prior] != Slots[Idx]);
+          }
+        if (Placed)
+          { /*Every word in bucket has a distinct free slot, claim them*/
+          Table.Displacement[Bucket] = (word)Displacement;
+          for (Idx = 0; Idx < Size; Idx++)
+            {
+            Used[Slots[Idx]] = True;
+            Table.Word[Slots[Idx]] = (short)Members[BucketStart[Bucket]+Idx];
+            Table.Hash[Slots[Idx]] = Hash[Members[BucketStart[Bucket]+Idx]];
+            }
+          }
+        }
+      }
+  return(Table);
+}
+
+constexpr TReservedWordHash ReservedWordHash = BuildReservedWordHash();
+
+/*------------------------------------------------------------------------------*/
+/*------------------------------- Source Scanning ------------------------------*/
+/*------------------------------------------------------------------------------*/
+
+/*Elementize spends most of its time stepping over bytes that never become elements: the sanitizing pass over the whole
+  source, runs of blanks, and the rest of every comment line.  These scans are done by whichever set of scanners suits
+  the processor we're running on; AVX2 (32 bytes at a time) or SSE2 (16 bytes at a time) on x86 processors, otherwise
+  one byte at a time.  Every scanner in a set gives exactly the same result as the byte-at-a-time one.*/
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+  #define ScanSSE2
+#endif
+#if defined(ScanSSE2) && (defined(__GNUC__) || defined(__clang__))
+  #define ScanAVX2
+  #define TargetAVX2 __attribute__((target("avx2")))
+#endif
+
+#define IsBlankChar(C)         ( ((C) == 0) || ((C) == 9) || ((C) == 32) )  /* Null, Tab or Space */
+
+/*Define source scanner set*/
+struct TSourceScanner
+{
+    void (*Sanitize)(char *Dest, const char *Source, int Size); /*Copy Source[0..Size-1] to Dest, chars besides 0, 9 and 32..126 converted to ETX.  Dest may be Source*/
+    int  (*SkipBlanks)(const char *Source, int Idx, int Limit); /*Return index of first non-blank at or after Idx, or Limit if none*/
+    int  (*FindChar)(const char *Source, int Idx, int Limit, char C); /*Return index of first C at or after Idx, or Limit if none*/
+};
+
+static void ScalarSanitize(char *Dest, const char *Source, int Size)
+{
+  int  Idx;
+
+  for (Idx = 0; Idx < Size; Idx++)
+    Dest[Idx] = ( ( ((Source[Idx] >= 0) && (Source[Idx] <= 8)) || ((Source[Idx] >= 10) && (Source[Idx] <= 31)) ) ? ETX : Source[Idx] );
+}
+
+static int ScalarSkipBlanks(const char *Source, int Idx, int Limit)
+{
+  while ((Idx < Limit) && IsBlankChar(Source[Idx])) Idx++;
+  return(Idx);
+}
+
+static int ScalarFindChar(const char *Source, int Idx, int Limit, char C)
+{
+  while ((Idx < Limit) && (Source[Idx] != C)) Idx++;
+  return(Idx);
+}
+
+#ifdef ScanSSE2
+static inline int LowestSetBit(unsigned int Mask)
+/*Return the index of the lowest set bit in Mask (Mask must not be 0)*/
+{
+  #ifdef _MSC_VER
+    unsigned long Idx;
+    _BitScanForward(&Idx, Mask);
+    return((int)Idx);
+  #else
+    return(__builtin_ctz(Mask));
+  #endif
+}
+
+static void SSE2Sanitize(char *Dest, const char *Source, int Size)
+{
+  int     Idx;
+  __m128i Chars;
+  __m128i Control;
+
+  for (Idx = 0; Idx + 16 <= Size; Idx += 16)
+    { /*Control = chars 0..31 except 9 (Tab)*/
+    Chars = _mm_loadu_si128((const __m128i *)(Source+Idx));
+    Control = _mm_andnot_si128(_mm_cmpeq_epi8(Chars, _mm_set1_epi8(9)), _mm_cmpeq_epi8(_mm_min_epu8(Chars, _mm_set1_epi8(31)), Chars));
+    if ((Dest != Source) || (_mm_movemask_epi8(Control) != 0))
+      _mm_storeu_si128((__m128i *)(Dest+Idx), _mm_or_si128(_mm_and_si128(Control, _mm_set1_epi8(ETX)), _mm_andnot_si128(Control, Chars)));
+    }
+  ScalarSanitize(Dest+Idx, Source+Idx, Size-Idx);
+}
+
+static int SSE2SkipBlanks(const char *Source, int Idx, int Limit)
+{
+  __m128i      Chars;
+  unsigned int Mask;
+
+  for (; Idx + 16 <= Limit; Idx += 16)
+    {
+    Chars = _mm_loadu_si128((const __m128i *)(Source+Idx));
+    Mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(Chars, _mm_setzero_si128()),
+                                                                     _mm_cmpeq_epi8(Chars, _mm_set1_epi8(9))),
+                                                        _mm_cmpeq_epi8(Chars, _mm_set1_epi8(32))));
+    if (Mask != 0xFFFF) return(Idx + LowestSetBit(~Mask));
+    }
+  return(ScalarSkipBlanks(Source, Idx, Limit));
+}
+
+static int SSE2FindChar(const char *Source, int Idx, int Limit, char C)
+{
+  unsigned int Mask;
+
+  for (; Idx + 16 <= Limit; Idx += 16)
+    {
+    Mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(Source+Idx)), _mm_set1_epi8(C)));
+    if (Mask != 0) return(Idx + LowestSetBit(Mask));
+    }
+  return(ScalarFindChar(Source, Idx, Limit, C));
+}
+#endif
+
+#ifdef ScanAVX2
+TargetAVX2 static void AVX2Sanitize(char *Dest, const char *Source, int Size)
+{
+  int     Idx;
+  __m256i Chars;
+  __m256i Control;
+
+  for (Idx = 0; Idx + 32 <= Size; Idx += 32)
+    { /*Control = chars 0..31 except 9 (Tab)*/
+    Chars = _mm256_loadu_si256((const __m256i *)(Source+Idx));
+    Control = _mm256_andnot_si256(_mm256_cmpeq_epi8(Chars, _mm256_set1_epi8(9)), _mm256_cmpeq_epi8(_mm256_min_epu8(Chars, _mm256_set1_epi8(31)), Chars));
+    if ((Dest != Source) || !_mm256_testz_si256(Control, Control))
+      _mm256_storeu_si256((__m256i *)(Dest+Idx), _mm256_blendv_epi8(Chars, _mm256_set1_epi8(ETX), Control));
+    }
+  SSE2Sanitize(Dest+Idx, Source+Idx, Size-Idx);
+}
+
+TargetAVX2 static int AVX2SkipBlanks(const char *Source, int Idx, int Limit)
+{
+  __m256i      Chars;
+  unsigned int Mask;
+
+  for (; Idx + 32 <= Limit; Idx += 32)
+    {
+    Chars = _mm256_loadu_si256((const __m256i *)(Source+Idx));
+    Mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(Chars, _mm256_setzero_si256()),
+                                                                              _mm256_cmpeq_epi8(Chars, _mm256_set1_epi8(9))),
+                                                              _mm256_cmpeq_epi8(Chars, _mm256_set1_epi8(32))));
+    if (Mask != 0xFFFFFFFF) return(Idx + LowestSetBit(~Mask));
+    }
+  return(SSE2SkipBlanks(Source, Idx, Limit));
+}
+
+TargetAVX2 static int AVX2FindChar(const char *Source, int Idx, int Limit, char C)
+{
+  unsigned int Mask;
+
+  for (; Idx + 32 <= Limit; Idx += 32)
+    {
+    Mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(Source+Idx)), _mm256_set1_epi8(C)));
+    if (Mask != 0) return(Idx + LowestSetBit(Mask));
+    }
+  return(SSE2FindChar(Source, Idx, Limit, C));
+}
+#endif
+
+static const TSourceScanner &SourceScanner(void)
+/*Return the best scanner set for this processor.  It is chosen the first time it's needed and never changes.*/
+{
+  static const TSourceScanner Scanner = []()
+    {
+    #ifdef ScanAVX2
+      if (__builtin_cpu_supports("avx2")) return(TSourceScanner{AVX2Sanitize, AVX2SkipBlanks, AVX2FindChar});
+    #endif
+    #ifdef ScanSSE2
+      return(TSourceScanner{SSE2Sanitize, SSE2SkipBlanks, SSE2FindChar});
+    #else
+      return(TSourceScanner{ScalarSanitize, ScalarSkipBlanks, ScalarFindChar});
+    #endif
+    }();
+
+  return(Scanner);
+}
+
+static int CommonPrefix(const char *A, const char *B, int Limit)
+/*Return the number of bytes, up to Limit, that A and B have the same from their start*/
+{
+  int  Idx;
+
+  for (Idx = 0; (Idx+64 <= Limit) && (memcmp(&A[Idx], &B[Idx], 64) == 0); Idx += 64);
+  while ((Idx < Limit) && (A[Idx] == B[Idx])) Idx++;
+  return(Idx);
+}
+
+static int CommonSuffix(const char *AEnd, const char *BEnd, int Limit)
+/*Return the number of bytes, up to Limit, that those before AEnd and BEnd have the same from their end*/
+{
+  int  Idx;
+
+  for (Idx = 0; (Idx+64 <= Limit) && (memcmp(AEnd-Idx-64, BEnd-Idx-64, 64) == 0); Idx += 64);
+  while ((Idx < Limit) && (AEnd[-Idx-1] == BEnd[-Idx-1])) Idx++;
+  return(Idx);
+}
+
 using namespace std;
 
 /*------------------------------------------------------------------------------*/
@@ -833,10 +1137,10 @@ STDAPI tokenizer::GetElementListItem(TElementList *Ele, int Idx)
 {
   if (Idx < ElementListEnd)
 	{/*Valid index, return pointer and true*/
-	Ele->ElementType = ElementList[Idx].ElementType;				/*Copy ElementType*/
-	Ele->Value = ElementList[Idx].Value;						/*Copy Value*/
-	Ele->Start = ElementList[Idx].Start;						/*Copy Start*/
-	Ele->Length = ElementList[Idx].Length;						/*Copy Length*/
+	Ele->ElementType = (TElementType)ElementList->Types[Idx];			/*Copy ElementType*/
+	Ele->Value = ElementList->Values[Idx];						/*Copy Value*/
+	Ele->Start = ElementList->Starts[Idx];						/*Copy Start*/
+	Ele->Length = ElementList->Lengths[Idx];					/*Copy Length*/
 	return(True);
 	}
   else /*Index out of range, return false*/
@@ -855,216 +1159,670 @@ STDAPI tokenizer::GetGosubCount(void)
 /*------------------------------------------------------------------------------*/
 
 STDAPI tokenizer::Compile(TModuleRec *Rec, char *Src, bool DirectivesOnly, bool ParseStampDirective, TSrcTokReference *Ref)
-/*Compile entire source*/
+/*Compile entire source.  Src must be a MaxSourceSize byte array; it is marked up during compilation and the
+  tzModuleRec's ProjectFiles, Port and Error pointers may point into it afterwards.*/
 {
   tzModuleRec = Rec;						     /*Point to external ModuleRec structure*/
   tzSource = Src;                               /*Point to external Source byte array*/
+  tzViewSource = NULL;
+  tzDirectiveViews = NULL;
   tzSrcTokReference = Ref;                      /*Point to external Source vs. Token Reference array, if any*/
 
 /*  char src[] = {"PAUSE 1000\nSTOP\0"};*/
 /*  strcpy(&tzSource[0],src);*/
 /*  tzModuleRec->SourceSize = strlen(&tzSource[0]);*/
 
+  return(CompileSource(DirectivesOnly, ParseStampDirective));
+}
 
-  InitializeRec();                              /*Initialize critical tzModuleRec fields*/
-  AllowStampDirective = ParseStampDirective;    /*Set flag to parse, or not parse, Stamp Directive*/
-  if (AllowStampDirective) tzModuleRec->TargetModule = tmNone;   /*Init target module to None (0)*/
-  tzModuleRec->LanguageVersion = 200;           /*Init Language Version*/
-  Lang250 = False;
+/*------------------------------------------------------------------------------*/
 
-  tzModuleRec->Succeeded = False;				     /*Init to failed status*/
+STDAPI tokenizer::CompileView(TModuleRec *Rec, const char *Src, int SrcSize, bool DirectivesOnly, bool ParseStampDirective, TSrcTokReference *Ref, TDirectiveViews *Views)
+/*Compile entire source, exactly as Compile does, without writing to the source.  Src need only be SrcSize bytes long
+  (SrcSize must be less than MaxSourceSize) and may be read-only, such as a memory-mapped file, or shared by any number
+  of tokenizer objects at once.  The source is sanitized into this object's own WorkSource as it is elementized, so the
+  tzModuleRec's ProjectFiles, Port and Error pointers refer to WorkSource and are only good until the next compile;
+  ErrorStart and ErrorLength, and Views (if not NULL) for the project files and port, give positions in Src instead.*/
+{
+  if (!AttachView(Rec, Src, SrcSize, Ref, Views)) return(False);
+  return(CompileSource(DirectivesOnly, ParseStampDirective));
+}
 
-  if (!InitSymbols())                                                /*Initialize symbol table*/
-    { /*Initialized all symbols*/
-    if (!Elementize(False))                                          /*Elementize editor directives only*/
-      { /*Elementized directives successfully*/
-      if (!CompileEditorDirectives())                                /*Compile Editor directives*/
-        { /*Directives compiled successfully*/
-        if (!DirectivesOnly)
-          { /*We're to compile entire source, not just directives*/
-          if (!AdjustSymbols())                                      /*Adjust symbol table for specified Stamp*/
-            { /*Adjusted symbols successfully*/
-            if (!Elementize(True))                                   /*Elementize entire source*/
-              { /*Elementized source successfully*/
-              if (!CompileCCDirectives())                            /*Compile conditional-compile directives*/
-                { /*Compiled conditional-compile directives successfully*/
-                if (!CompilePins(False))                             /*Try to compile PIN directives*/
-                  { /*Tried compiling PIN directives successfully*/
-                  if (!CompileConstants(False))                      /*Try to compile CON directives*/
-                    { /*Tried Compiling Constants successfully*/
-                    if (!CompileData(False))                         /*Try to compile DATA directives*/
-                      { /*Tried Compiling Data successfully*/
-                      if (!CompileConstants(True))                   /*Compile CON directives*/
-                        { /*Compiled Constants successfully*/
-                        if (!CompilePins(True))                      /*Compile PIN directives*/
-                          { /*Compiled PIN directives successfully*/
-                          if (!CompileData(True))                    /*Compile DATA directives*/
-                            { /*Compiled Data successfully*/
-                            if (!CompileVar(False))                  /*Try to compile VAR directives*/
-                              { /*Tried Compiling vars successfully*/
-                              if (!CompileVar(True))                 /*Compile VAR directives*/
-                                { /*Compiled vars successfully*/
-                                if (!CountGosubs())                  /*Count Gosub's*/
-                                  { /*Counted Gosubs successfully*/
-                                  if (!CompileInstructions())        /*Compile Instructions*/
-                                    { /*Compiled Instructions successfully*/
-                                    if (!PatchRemainingAddresses())  /*Patch forward code addresses*/
-                                      { /*Patched addresses successfully*/
-                                      PreparePackets();              /*Prepare download packets*/
-                                      tzModuleRec->ErrorStart = 0;   /*Clear Source Start and Source Length*/
-                                      tzModuleRec->ErrorLength = 0;
-                                      /*If no packets, Error: Nothing to tokenize, otherwise, we've succeeded!*/
-                                      if ( (tzModuleRec->PacketCount == 0) && (!DirectivesOnly) ) Error(ecNTT); else tzModuleRec->Succeeded = True;
-                                      } /*Patched Addresses*/
-                                    } /*Compiled Instructions*/
-                                  } /*Counted Gosubs*/
-                                } /*Compiled vars*/
-                              } /*Tried compiling vars*/
-                            } /*Compiled data*/
-                          } /*Compiled pins*/
-                        } /*Compiled constants*/
-                      } /*Tried compiling data*/
-                    } /*Tried compiling constants*/
-                  } /*Tried compiling PIN directives*/
-                } /*Compiled conditional-compile directives*/
-              } /*Elementized Source*/
-            } /*Adjusted Symbol*/
-          }
-        else /*Directives only*/
+/*------------------------------------------------------------------------------*/
+
+STDAPI tokenizer::ProbeDirectives(TModuleRec *Rec, const char *Src, int SrcSize, TDirectiveViews *Views)
+/*Find the target module, port, language version and project files from the editor directives at the head of Src, as
+  Compile(Rec, ..., DirectivesOnly = True, ParseStampDirective = True, NULL) would, reading no more of Src than it takes.
+  Src and Views follow the rules of CompileView.  Only the tzModuleRec fields set by editor directives, and the error
+  fields, are changed; the EEPROM and the rest are left alone.  The search ends where ElementizeHeader stops, so
+  directives that come after code are not seen.  Returns True if successful, False otherwise.*/
+{
+  if (!AttachView(Rec, Src, SrcSize, NULL, Views)) return(False);
+  #if defined(CompileStatistics)
+    memset(&CompileStats, 0, sizeof(CompileStats));
+  #endif
+  InitializeDirectiveFields();                  /*Initialize directive fields of tzModuleRec*/
+  AllowStampDirective = True;
+  tzModuleRec->TargetModule = tmNone;           /*Init target module to None (0)*/
+  tzModuleRec->LanguageVersion = 200;           /*Init Language Version*/
+  Lang250 = False;
+  tzModuleRec->Succeeded = False;               /*Init to failed status*/
+  if (!ElementizeHeader())                      /*Elementize editor directives at head of source*/
+    if (!CompileStampDirective())               /*Compile editor directives; the directive symbols aren't needed*/
+      if (!CompilePortDirective())
+        if (!CompilePBasicDirective())
           {
-          tzModuleRec->ErrorStart = 0;           /*Clear Source Start and Source Length*/
+          tzModuleRec->ErrorStart = 0;          /*Clear Source Start and Source Length*/
           tzModuleRec->ErrorLength = 0;
-          tzModuleRec->Succeeded = True;         /*Set Succeeded flag*/
+          tzModuleRec->Succeeded = True;        /*Set Succeeded flag*/
           }
-        }
-      }
-    }
   return(tzModuleRec->Succeeded);
 }
 
 /*------------------------------------------------------------------------------*/
 
-STDAPI tokenizer::GetReservedWords(TModuleRec *Rec, char *Src)
-/*Returns a list of all the reserved words and reserved word types based on the tzModuleRec->LanguageVersion and
-tzModuleRec->TargetModule.  The tzModuleRec->LanguageVersion and tzModuleRec->TargetModule fields MUST be set before
-calling this routine.
+STDAPI tokenizer::CompileFrontEnd(TModuleRec *Rec, const char *Src, int SrcSize)
+/*Do the part of CompileView(Rec, Src, SrcSize, False, False, ...) that is the same for every target module: sanitize
+  and elementize the source and compile its editor directives.  Src must stay as it is until each target is compiled
+  from this object by another's CompileBackEnd.  Returns True if successful, False (with the error in Rec) otherwise.*/
+{
+  if (!AttachView(Rec, Src, SrcSize, NULL, NULL)) return(False);
+  BeginCompile();
+  tzModuleRec->Succeeded = CompileFront(False, False);
+  EndCompile();
+  return(tzModuleRec->Succeeded);
+}
 
-The reserved word list is returned as a series of String/Type pairs in tzModuleRec->Source starting at location 0.
-Each reserved word string is null-terminated and the byte following the null is the Type ID. The next String/Type pair
-starts on the byte following the previous reserved word's Type ID.  The end of the list of reserved words can be
-determined by tzModuleRec->SourceSize or by a null following the last string's Type ID (ie: a null string.).
+/*------------------------------------------------------------------------------*/
 
-Returns True if successful, False otherwise.*/
+STDAPI tokenizer::CompileBackEnd(const tokenizer *Front, TModuleRec *Rec, byte TargetModule, TSrcTokReference *Ref)
+/*Finish compiling the source Front's CompileFrontEnd succeeded with, for TargetModule, into Rec (and Ref, if not NULL)
+  exactly as CompileView(Rec, Src, SrcSize, False, False, Ref, NULL) would with Rec->TargetModule = TargetModule.
+  Front's elements, symbols and sanitized source are copied, not changed, so any number of objects may compile from one
+  Front at once.  Rec's pointer fields refer to this object's WorkSource, as for CompileView.  Returns True if
+  successful, False otherwise.*/
 {
-  int  SourceIdx;
-  int  Idx;
+  BeginCompile();
+  if (CopyFrontEnd(Front, Rec, Ref, Front->SourceElementsEnd))
+    {
+    Rec->TargetModule = TargetModule;
+    ModifySymbolValue("$STAMP",TargetModule);
+    CompileTarget(False);
+    }
+  return(EndCompile());
+}
 
-  tzModuleRec = Rec;		           /*Point to external ModuleRec structure*/
-  tzSource = Src;                          /*Point to external Source byte array*/
+/*------------------------------------------------------------------------------*/
 
-  InitializeRec();                         /*Initialize critical tzModuleRec fields*/
-  tzModuleRec->ErrorStart = 0;
-  tzModuleRec->ErrorLength = 0;
+STDAPI tokenizer::ResolveFrontEnd(TModuleRec *Rec, const char *Src, int SrcSize, bool ParseStampDirective)
+/*Do the part of CompileView(Rec, Src, SrcSize, False, ParseStampDirective, NULL, NULL) that comes before conditional
+  compilation: sanitize and elementize the source, compile its editor directives, adjust symbols for the target module
+  and resolve the elements that depend on it.  Src must stay as it is until each configuration is compiled from this
+  object by another's CompileConditionals.  Returns True if successful, False (with the error in Rec) otherwise.*/
+{
+  if (!AttachView(Rec, Src, SrcSize, NULL, NULL)) return(False);
+  BeginCompile();
   tzModuleRec->Succeeded = False;
-  if (!((tzModuleRec->LanguageVersion == 200) || (tzModuleRec->LanguageVersion == 250)))
-    { /*Invalid version? Error, invalid PBASIC version number.  Must be 2.0 or 2.5*/
-    strcpy(&tzSource[MaxSourceSize-1-strlen(Errors[ecIPVNMBTZTF])],Errors[ecIPVNMBTZTF]);
-    tzModuleRec->Error = (char *)&(tzSource[MaxSourceSize-1-strlen(Errors[ecIPVNMBTZTF])]);
-    }
-  else
-    { /*Language version okay, continue with symbols*/
-    Lang250 = (tzModuleRec->LanguageVersion == 250);
-    InitSymbols();                         /*Initialize symbol table (Ignore response, should not fail here)*/
-    AdjustSymbols();                       /*Adjust symbols based on LanguageVersion and TargetModule (Ignore response, should not fail here)*/
-    SourceIdx = 0;
-    for (Idx = 0; Idx < SymbolTablePointer; Idx++)
-      { /*For all symbols in SymbolTable...*/
-      strcpy(&tzSource[SourceIdx],SymbolTable[Idx].Name);                  /*Store reserved word string*/
-      SourceIdx += (int) strlen(SymbolTable[Idx].Name);
-      tzSource[SourceIdx] = 0;  /*null-terminate the reserved word string*/
-      tzSource[SourceIdx+1] = ResWordTypeID(SymbolTable[Idx].ElementType); /*Store reserved word type*/
-      SourceIdx += 2;
-      }
-    tzSource[SourceIdx] = 0;    /*null-terminate the reserved words list*/
-    tzModuleRec->SourceSize = SourceIdx;
-    tzModuleRec->Succeeded = True;
-    }
+  if (CompileFront(False, ParseStampDirective))
+    if (!TimePhase(cpAdjustSymbols, AdjustSymbols()))
+      tzModuleRec->Succeeded = !TimePhase(cpResolveElements, ResolveElements());
+  EndCompile();
   return(tzModuleRec->Succeeded);
 }
 
-#if defined(__cplusplus)        /* End of the c namespace */
+/*------------------------------------------------------------------------------*/
+
+STDAPI tokenizer::CompileConditionals(const tokenizer *Front, TModuleRec *Rec, const TDefineSymbol *Defines, int DefineCount, TSrcTokReference *Ref)
+/*Go on compiling the source Front's ResolveFrontEnd succeeded with, into Rec (and Ref, if not NULL), with
+  Defines[0..DefineCount-1] DEFINE'd (see DefineSymbols), through its conditional-compile directives.  Front is copied,
+  not changed, as for CompileBackEnd.  Returns True if successful, so CompileRemainder may finish the compile, False (with
+  the error in Rec) otherwise.*/
+{
+  BeginCompile();
+  if (CopyFrontEnd(Front, Rec, Ref, Front->ElementListEnd))
+    {
+    ElementListEnd = Front->ElementListEnd;
+    if (!DefineSymbols(Defines, DefineCount))
+      if (!TimePhase(cpCCDirectives, CompileCCDirectives())) return(True);
+    }
+  EndCompile();
+  return(False);
 }
-#endif
 
-//#ifdef __APPLE_CC__
-//  #pragma export off            /* End of exported functions when compiling on a Macintosh */
-//#endif
+/*------------------------------------------------------------------------------*/
+
+STDAPI tokenizer::CompileRemainder(void)
+/*Finish the compile CompileConditionals succeeded with.  Returns True if successful, False otherwise.*/
+{
+  CompileProgram();
+  return(EndCompile());
+}
 
 /*------------------------------------------------------------------------------*/
 
-byte tokenizer::ResWordTypeID(TElementType ElementType)
-/*Translate similar types to the common type*/
+bool tokenizer::SameConditionals(tokenizer *Other)
+/*Returns True if the elements left by this object's and Other's CompileConditionals (from the same Front) are the same,
+  each undefined symbol among them is DEFINE'd in both or in neither and both have as many symbols (so as much room
+  left in the symbol table), so that the rest of their compiles would be the same.*/
 {
-  byte Result;
+  int  Idx;
 
-  Result = (byte)ElementType;                            /*Assume type needs no translation*/
+  if ( (ElementListEnd != Other->ElementListEnd) || (SymbolTablePointer != Other->SymbolTablePointer) ) return(False);
+  if ( (memcmp(SourceElements.Types, Other->SourceElements.Types, ElementListEnd) != 0) ||
+       (memcmp(SourceElements.Values, Other->SourceElements.Values, ElementListEnd*sizeof(word)) != 0) ||
+       (memcmp(SourceElements.Starts, Other->SourceElements.Starts, ElementListEnd*sizeof(word)) != 0) ||
+       (memcmp(SourceElements.Lengths, Other->SourceElements.Lengths, ElementListEnd) != 0) ) return(False);
+  for (Idx = 0; Idx < ElementListEnd; Idx++)
+    if ( (SourceElements.Types[Idx] == etUndef) && (IsDefinedElement(Idx) != Other->IsDefinedElement(Idx)) ) return(False);
+  return(True);
+}
 
-  /*Translate if necessary*/
-  switch (ElementType)
-    {
-    case etCCDirective  :
-    case etCCThen       : Result = (byte)etCCDirective;  /*GRW: etCCDirective*/
-                          break;
-    case etInstruction  :
-    case etData         :
-    case etStep         :
-    case etTo           :
-    case etThen         :
-    case etWhile        :
-    case etUntil        : Result = (byte)etInstruction;  /*GRW: etInstruction*/
-                          break;
-    case etCon          :
-    case etPin          :
-    case etVar          : Result = (byte)etCon;          /*GRW: etDeclaration*/
-                          break;
-    case etVariableAuto : Result = (byte)etVariableAuto; /*GRW: etVariableType*/
-                          break;
-    case etAnyNumberIO  :
-    case etASCIIIO      :
-    case etNumberIO     :
-    case etRepeatIO     :
-    case etSkipIO       :
-    case etSpStringIO   :
-    case etStringIO     :
-    case etWaitIO       :
-    case etWaitStringIO : Result = (byte)etAnyNumberIO;  /*GRW: etIOFormatter*/
-                          break;
-    case etCond1Op      :
-    case etCond2Op      :
-    case etCond3Op      : Result = (byte)etCond1Op;      /*GRW: etConditionalOp*/
-                          break;
-    case etLeft         :
-    case etRight        : Result = (byte)etLeft;         /*GRW: etParentheses*/
-                          break;
-    case etLeftBracket  :
-    case etRightBracket : Result = (byte)etLeftBracket;  /*GRW: etBrackets*/
-                          break;
-    default             : break;                         /*All other ElementTypes, no translation*/
-    }
-  return(Result);
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::IsDefinedElement(int Idx)
+/*Returns True if SourceElements[Idx], an undefined symbol, has been DEFINE'd since it was elementized (see GetElement)*/
+{
+  word Name;
+
+  Name = SourceElements.Values[Idx];
+  if (Name != UninternedName) return( (NameTable[Name].Symbol > -1) && (SymbolTable[NameTable[Name].Symbol].ElementType == etCCConstant) );
+  GetSymbolName(SourceElements.Starts[Idx],SourceElements.Lengths[Idx]);
+  return( FindSymbol(&Symbol) && (Symbol.ElementType == etCCConstant) );
 }
 
 /*------------------------------------------------------------------------------*/
 
-void tokenizer::InitializeRec(void)
-/*Initialize most critical fields of tzModuleRec*/
+bool tokenizer::CopyFrontEnd(const tokenizer *Front, TModuleRec *Rec, TSrcTokReference *Ref, word ElementCount)
+/*Point to Rec and Ref, and copy Front's tzModuleRec, sanitized source, symbols and first ElementCount source elements
+  (with those left for ResolveElements), and the Element Engine state that goes with them, for CompileBackEnd or
+  CompileConditionals.  Returns False (and fails Rec) if out of memory.*/
 {
   int  Idx;
 
-  tzModuleRec->Error = NULL;                    /*Init Error string, Project Files array and TargetModule (if allowed)*/
-  
-  int scomp = 7; // sizeof(tzModuleRec->ProjectFiles) / sizeof(char *);
-  
+  *Rec = *Front->tzModuleRec;
+  tzModuleRec = Rec;
+  tzSource = WorkSource;
+  tzViewSource = Front->tzViewSource;
+  tzDirectiveViews = NULL;
+  tzSrcTokReference = Ref;
+  memcpy(WorkSource, Front->WorkSource, Rec->SourceSize+1);
+  /*Point Rec's directive fields into our own copy of the source*/
+  if (Rec->Port != NULL) Rec->Port = WorkSource + (Front->tzModuleRec->Port-Front->WorkSource);
+  for (Idx = 0; Idx < 7; Idx++)
+    if (Rec->ProjectFiles[Idx] != NULL) Rec->ProjectFiles[Idx] = WorkSource + (Front->tzModuleRec->ProjectFiles[Idx]-Front->WorkSource);
+  ClearEEPROM();                                /*Clear EEPROM*/
+  ClearSrcTokReference();                       /*Clear Source vs Token Cross Reference*/
+  tzModuleRec->Succeeded = False;
+  /*Copy the symbols*/
+  if (Incremental != NULL)
+    { /*Our element caches don't go with Front's names*/
+    Incremental->Caches[0].Valid = Incremental->Caches[1].Valid = False;
+    Incremental->ResultsValid = False;
+    Incremental->Recorded = Incremental->Unchanged = False;
+    }
+  memcpy(SymbolTable, Front->SymbolTable, Front->SymbolTablePointer*sizeof(TSymbolTable));
+  memcpy(SymbolKeys, Front->SymbolKeys, Front->SymbolTablePointer*sizeof(TSymbolKey));
+  memcpy(SymbolVectors, Front->SymbolVectors, sizeof(SymbolVectors));
+  SymbolTablePointer = Front->SymbolTablePointer;
+  ReservedImage = Front->ReservedImage;
+  memcpy(UndefSymbolTable, Front->UndefSymbolTable, Front->UndefSymbolTablePointer*sizeof(TUndefSymbolTable));
+  for (Idx = Front->UndefSymbolTablePointer; Idx < SymbolTableSize; Idx++) UndefSymbolTable[Idx].NextRecord = -1;
+  memcpy(UndefSymbolVectors, Front->UndefSymbolVectors, sizeof(UndefSymbolVectors));
+  UndefSymbolTablePointer = Front->UndefSymbolTablePointer;
+  memcpy(NameTable, Front->NameTable, Front->NameTablePointer*sizeof(TNameTable));
+  memcpy(NameVectors, Front->NameVectors, sizeof(NameVectors));
+  NameTablePointer = Front->NameTablePointer;
+  SymbolStats = Front->SymbolStats;
+  /*Copy the source elements, and those left for ResolveElements*/
+  ResetElements();
+  SourceElements.Capacity = Front->SourceElements.Capacity;
+  SourceElements.Types = (byte *) ElementAlloc(SourceElements.Capacity);
+  SourceElements.Values = (word *) ElementAlloc(SourceElements.Capacity*sizeof(word));
+  SourceElements.Starts = (word *) ElementAlloc(SourceElements.Capacity*sizeof(word));
+  SourceElements.Lengths = (byte *) ElementAlloc(SourceElements.Capacity);
+  UnresolvedElements = (word *) ElementAlloc(SourceElements.Capacity*sizeof(word));
+  if ( (SourceElements.Types == NULL) || (SourceElements.Values == NULL) || (SourceElements.Starts == NULL) || (SourceElements.Lengths == NULL) || (UnresolvedElements == NULL) )
+    { /*Out of memory, Error: Too many elements*/
+    memset(&SourceElements, 0, sizeof(TElementStore));
+    tzModuleRec->ErrorStart = 0;
+    tzModuleRec->ErrorLength = 0;
+    Error(ecTME);
+    return(False);
+    }
+  memcpy(SourceElements.Types, Front->SourceElements.Types, ElementCount);
+  memcpy(SourceElements.Values, Front->SourceElements.Values, ElementCount*sizeof(word));
+  memcpy(SourceElements.Starts, Front->SourceElements.Starts, ElementCount*sizeof(word));
+  memcpy(SourceElements.Lengths, Front->SourceElements.Lengths, ElementCount);
+  memcpy(UnresolvedElements, Front->UnresolvedElements, Front->UnresolvedCount*sizeof(word));
+  UnresolvedCount = Front->UnresolvedCount;
+  SourceElementsEnd = Front->SourceElementsEnd;
+  ElementList = &SourceElements;
+  ElementListIdx = 0;
+  ElementListEnd = 0;
+  /*Copy the Element Engine state ResolveElements goes on with*/
+  DeferredError = Front->DeferredError;
+  DeferredErrorStart = Front->DeferredErrorStart;
+  DeferredErrorLength = Front->DeferredErrorLength;
+  Relex = Front->Relex;
+  ElementizedLang250 = Front->ElementizedLang250;
+  LangSensitive = Front->LangSensitive;
+  Lang250 = Front->Lang250;
+  SinglePass = False;
+  LexCache = NULL;
+  AllowStampDirective = Front->AllowStampDirective;
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::DefineSymbols(const TDefineSymbol *Defines, int Count)
+/*Enter Defines[0..Count-1] into the symbol table as DEFINE'd symbols, just as "#DEFINE Name = Value" lines ahead of the
+  source would be, for CompileCCDirectives.  A name given twice takes the later value.  Names must be legal symbols that
+  aren't reserved words or DATA, VAR, CON or PIN symbols.  PBASIC 2.0 has no conditional compilation, so Defines are
+  ignored for it (where "#DEFINE" lines would be an unrecognized character).*/
+{
+  TErrorCode  Result;
+  const char  *Name;
+  int         Idx;
+  int         Length;
+
+  if (tzModuleRec->LanguageVersion < 250) return(ecS); /*PBASIC 2.0? Nothing to DEFINE*/
+  for (Idx = 0; Idx < Count; Idx++)
+    {
+    Name = (Defines[Idx].Name != NULL ? Defines[Idx].Name : "");
+    for (Length = 0; (Length <= SymbolSize) && ((isalnum((byte)Name[Length])) || (Name[Length] == '_')); Length++) Symbol.Name[Length] = toupper(Name[Length]);
+    Symbol.Name[Length < SymbolSize ? Length : SymbolSize] = (char)NULL;
+    tzModuleRec->ErrorStart = 0;                /*Errors here have no place in the source*/
+    tzModuleRec->ErrorLength = 0;
+    if ( (Length == 0) || (Length > SymbolSize) || (Name[Length] != 0) || (isdigit((byte)Name[0])) ) return(Error(ecEAUDS)); /*Not a symbol? Error, expected a user-defined symbol*/
+    if (FindSymbol(&Symbol))
+      { /*Already a symbol; must be DEFINE'd before*/
+      if (Symbol.ElementType != etCCConstant) return(Error(ecEAUDS));  /*Not DEFINE'd symbol? Error, expected a user-defined symbol*/
+      ModifySymbolValue(Symbol.Name,Defines[Idx].Value);
+      }
+    else
+      {
+      if (Symbol.NextRecord == 1) return(Error(ecSIAD));              /*Undefined non-DEFINE'd (DATA, VAR, CON or PIN) symbol? Error, Symbol is already defined*/
+      Symbol.ElementType = etCCConstant;
+      Symbol.Value = Defines[Idx].Value;
+      if ((Result = CopySymbol())) return(Result);                      /*Copy Symbol to Symbol2*/
+      if ((Result = EnterSymbol(Symbol2))) return(Result);
+      }
+    }
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::AttachView(TModuleRec *Rec, const char *Src, int SrcSize, TSrcTokReference *Ref, TDirectiveViews *Views)
+/*Point to external ModuleRec structure, read-only Source, Source vs. Token Reference array and directive views for
+  CompileView or ProbeDirectives, and clear the views.  Returns False (and fails Rec) if Src won't fit in WorkSource.*/
+{
+  int  Idx;
+
+  if ((SrcSize < 0) || (SrcSize >= MaxSourceSize))
+    { /*Source won't fit in WorkSource*/
+    Rec->Succeeded = False;
+    Rec->Error = NULL;
+    return(False);
+    }
+  tzModuleRec = Rec;						     /*Point to external ModuleRec structure*/
+  tzSource = WorkSource;                        /*Compile from our own copy of external Source*/
+  tzViewSource = Src;
+  tzDirectiveViews = Views;                     /*Point to external directive views, if any*/
+  tzSrcTokReference = Ref;                      /*Point to external Source vs. Token Reference array, if any*/
+  tzModuleRec->SourceSize = SrcSize;
+  if (tzDirectiveViews != NULL)
+    { /*Clear views*/
+    for (Idx = 0; Idx < 7; Idx++) tzDirectiveViews->ProjectFiles[Idx].Start = tzDirectiveViews->ProjectFiles[Idx].Length = 0;
+    tzDirectiveViews->Port.Start = tzDirectiveViews->Port.Length = 0;
+    }
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::CompileSource(bool DirectivesOnly, bool ParseStampDirective)
+/*Compile entire source set up by Compile or CompileView*/
+{
+  BeginCompile();
+  if (CompileFront(DirectivesOnly, ParseStampDirective))
+    { /*Directives compiled successfully*/
+    if (!DirectivesOnly)
+      CompileTarget(ParseStampDirective);      /*We're to compile entire source, not just directives*/
+    else /*Directives only*/
+      {
+      tzModuleRec->ErrorStart = 0;             /*Clear Source Start and Source Length*/
+      tzModuleRec->ErrorLength = 0;
+      tzModuleRec->Succeeded = True;           /*Set Succeeded flag*/
+      }
+    }
+  return(EndCompile());
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::CompileFront(bool DirectivesOnly, bool ParseStampDirective)
+/*Do the part of a compile that doesn't depend on the target module (unless ParseStampDirective): initialize symbols,
+  elementize and compile editor directives.  Returns True if successful, False (with the error in tzModuleRec)
+  otherwise.*/
+{
+  InitializeRec();                              /*Initialize critical tzModuleRec fields*/
+  AllowStampDirective = ParseStampDirective;    /*Set flag to parse, or not parse, Stamp Directive*/
+  if (AllowStampDirective) tzModuleRec->TargetModule = tmNone;   /*Init target module to None (0)*/
+  tzModuleRec->LanguageVersion = 200;           /*Init Language Version*/
+  Lang250 = False;
+
+  tzModuleRec->Succeeded = False;				     /*Init to failed status*/
+
+  if (!TimePhase(cpInitSymbols, InitSymbols()))                                       /*Initialize symbol table*/
+    if (!TimePhase(cpElementize, Elementize(DirectivesOnly ? epDirectives : epAll)))  /*Elementize editor directives (and source, unless directives only)*/
+      if (!TimePhase(cpEditorDirectives, CompileEditorDirectives())) return(True);    /*Compile Editor directives*/
+  return(False);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::CompileTarget(bool ParseStampDirective)
+/*Compile the rest of the source, after CompileFront, for the target module; sets tzModuleRec->Succeeded if successful*/
+{
+  if (!ReuseResults(ParseStampDirective) && !TimePhase(cpAdjustSymbols, AdjustSymbols()))   /*Reuse last compile's results if we can, otherwise adjust symbol table for specified Stamp*/
+    { /*Adjusted symbols successfully*/
+    if (!TimePhase(cpResolveElements, ResolveElements()))                                   /*Finish elementizing entire source*/
+      { /*Elementized source successfully*/
+      if (!TimePhase(cpCCDirectives, CompileCCDirectives()))                                /*Compile conditional-compile directives*/
+        CompileProgram();                                                                   /*Compile the declarations and instructions that are left*/
+      } /*Elementized Source*/
+    } /*Adjusted Symbol*/
+  SaveResults(ParseStampDirective);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::CompileProgram(void)
+/*Compile the declarations and instructions left by CompileCCDirectives and prepare the download packets; sets
+  tzModuleRec->Succeeded if successful*/
+{
+  if (!TimePhase(cpConstants, CompileConstants()))                                    /*Compile CON directives*/
+    { /*Compiled Constants successfully*/
+    if (!TimePhase(cpPins, CompilePins()))                                            /*Compile PIN directives*/
+      { /*Compiled PIN directives successfully*/
+      if (!TimePhase(cpData, CompileData(False)))                                     /*Lay out DATA directives*/
+        { /*Laid out Data successfully*/
+        if (!TimePhase(cpData, CompileData(True)))                                    /*Compile DATA directives*/
+          { /*Compiled Data successfully*/
+          if (!TimePhase(cpVar, CompileVar(False)))                                   /*Try to compile VAR directives*/
+            { /*Tried Compiling vars successfully*/
+            if (!TimePhase(cpVar, CompileVar(True)))                                  /*Compile VAR directives*/
+              { /*Compiled vars successfully*/
+              if (!TimePhase(cpCountGosubs, CountGosubs()))                           /*Count Gosub's*/
+                { /*Counted Gosubs successfully*/
+                (void) TimePhase(cpCompactElements, (CompactElements(), ecS));        /*Drop elements cancelled by declarations*/
+                if (!TimePhase(cpInstructions, CompileInstructions()))                /*Compile Instructions*/
+                  { /*Compiled Instructions successfully*/
+                  if (!TimePhase(cpPatchAddresses, PatchRemainingAddresses()))        /*Patch forward code addresses*/
+                    { /*Patched addresses successfully*/
+                    (void) TimePhase(cpPreparePackets, (PreparePackets(), ecS));      /*Prepare download packets*/
+                    tzModuleRec->ErrorStart = 0;   /*Clear Source Start and Source Length*/
+                    tzModuleRec->ErrorLength = 0;
+                    /*If no packets, Error: Nothing to tokenize, otherwise, we've succeeded!*/
+                    if (tzModuleRec->PacketCount == 0) Error(ecNTT); else tzModuleRec->Succeeded = True;
+                    } /*Patched Addresses*/
+                  } /*Compiled Instructions*/
+                } /*Counted Gosubs*/
+              } /*Compiled vars*/
+            } /*Tried compiling vars*/
+          } /*Compiled data*/
+        } /*Laid out data*/
+      } /*Compiled pins*/
+    } /*Compiled constants*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::BeginCompile(void)
+/*Start timing a compile*/
+{
+  #if defined(CompileStatistics)
+    memset(&CompileStats, 0, sizeof(CompileStats));
+    CompileStats.TotalTime = -StatsClock();
+  #endif
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::EndCompile(void)
+/*Finish timing a compile and note its counts.  Returns tzModuleRec->Succeeded.*/
+{
+  #if defined(CompileStatistics)
+    if (tzTrace != NULL) TraceSpan(tkCompile, 0, -CompileStats.TotalTime, 0, tzModuleRec->SourceSize);  /*TotalTime still holds -start*/
+    CompileStats.TotalTime += StatsClock();
+    CompileStats.Lookups = SymbolStats.Lookups;
+    CompileStats.Probes = SymbolStats.Probes;
+    CompileStats.Packets = tzModuleRec->PacketCount;
+  #endif
+  return(tzModuleRec->Succeeded);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI tokenizer::GetReservedWords(TModuleRec *Rec, char *Src)
+/*Returns a list of all the reserved words and reserved word types based on the tzModuleRec->LanguageVersion and
+tzModuleRec->TargetModule.  The tzModuleRec->LanguageVersion and tzModuleRec->TargetModule fields MUST be set before
+calling this routine.
+
+The reserved word list is returned as a series of String/Type pairs in tzModuleRec->Source starting at location 0.
+Each reserved word string is null-terminated and the byte following the null is the Type ID. The next String/Type pair
+starts on the byte following the previous reserved word's Type ID.  The end of the list of reserved words can be
+determined by tzModuleRec->SourceSize or by a null following the last string's Type ID (ie: a null string.).
+
+Returns True if successful, False otherwise.*/
+{
+  int  SourceIdx;
+  int  Idx;
+
+  tzModuleRec = Rec;		           /*Point to external ModuleRec structure*/
+  tzSource = Src;                          /*Point to external Source byte array*/
+  tzViewSource = NULL;
+  tzDirectiveViews = NULL;
+  tzSrcTokReference = NULL;                /*No Source vs. Token Reference array*/
+
+  InitializeRec();                         /*Initialize critical tzModuleRec fields*/
+  tzModuleRec->ErrorStart = 0;
+  tzModuleRec->ErrorLength = 0;
+  tzModuleRec->Succeeded = False;
+  if (!((tzModuleRec->LanguageVersion == 200) || (tzModuleRec->LanguageVersion == 250)))
+    { /*Invalid version? Error, invalid PBASIC version number.  Must be 2.0 or 2.5*/
+    strcpy(&tzSource[MaxSourceSize-1-strlen(Errors[ecIPVNMBTZTF])],Errors[ecIPVNMBTZTF]);
+    tzModuleRec->Error = (char *)&(tzSource[MaxSourceSize-1-strlen(Errors[ecIPVNMBTZTF])]);
+    }
+  else
+    { /*Language version okay, continue with symbols*/
+    Lang250 = (tzModuleRec->LanguageVersion == 250);
+    InitSymbols();                         /*Initialize symbol table (Ignore response, should not fail here)*/
+    AdjustSymbols();                       /*Adjust symbols based on LanguageVersion and TargetModule (Ignore response, should not fail here)*/
+    SourceIdx = 0;
+    for (Idx = 0; Idx < SymbolTablePointer; Idx++)
+      { /*For all symbols in SymbolTable...*/
+      strcpy(&tzSource[SourceIdx],SymbolTable[Idx].Name);                  /*Store reserved word string*/
+      SourceIdx += (int) strlen(SymbolTable[Idx].Name);
+      tzSource[SourceIdx] = 0;  /*null-terminate the reserved word string*/
+      tzSource[SourceIdx+1] = ResWordTypeID(SymbolTable[Idx].ElementType); /*Store reserved word type*/
+      SourceIdx += 2;
+      }
+    tzSource[SourceIdx] = 0;    /*null-terminate the reserved words list*/
+    tzModuleRec->SourceSize = SourceIdx;
+    tzModuleRec->Succeeded = True;
+    }
+  return(tzModuleRec->Succeeded);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI tokenizer::GetSymbolStats(TSymbolStats *Stats)
+/*Sets Stats to the symbol table search counts gathered since the start of the last Compile or GetReservedWords call,
+  and to the current shape of the symbol table's hash chains (which hold only non-automatic symbols).  Always returns
+  True.*/
+{
+  int Idx;
+  int Vector;
+  int Chain;
+
+  *Stats = SymbolStats;
+  Stats->Symbols = SymbolTablePointer;
+  Stats->UsedVectors = 0;
+  Stats->LongestChain = 0;
+  for (Idx = 0; Idx < SymbolTableSize; Idx++)
+    if (SymbolVectors[Idx] > -1)
+      { /*Vector in use, measure its chain*/
+      Stats->UsedVectors++;
+      Chain = 0;
+      for (Vector = SymbolVectors[Idx]; Vector > -1; Vector = SymbolTable[Vector].NextRecord) Chain++;
+      if (Chain > Stats->LongestChain) Stats->LongestChain = Chain;
+      }
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI tokenizer::SetIncremental(bool Enable)
+/*Start (Enable = True) or stop compiling incrementally.  While incremental, each Compile or CompileView keeps its
+  elements, line by line, in an element cache, and the next one copies the elements of the lines that haven't changed
+  since rather than elementizing them again.  If the whole source then elementizes to the same elements (but for
+  position), as after an edit to a comment or to spacing, the passes after CompileEditorDirectives are skipped and
+  their results reused.  Names of undefined symbols are kept from compile to compile (see InitSymbols).  The results
+  are exactly as they would be otherwise, though the DevDebug routines describe the last compile that ran all passes.
+  Returns False if out of memory.*/
+{
+  int  Idx;
+
+  if (!Enable)
+    {
+    if (Incremental != NULL)
+      {
+      for (Idx = 0; Idx < 2; Idx++) FreeElementCache(&Incremental->Caches[Idx]);
+      free(Incremental);
+      Incremental = NULL;
+      }
+    return(True);
+    }
+  if (Incremental != NULL) return(True);
+  if ((Incremental = (TIncrementalState *) calloc(1, sizeof(TIncrementalState))) == NULL) return(False);
+  for (Idx = 0; Idx < 2; Idx++)
+    if ((Incremental->Caches[Idx].Source = (char *) malloc(MaxSourceSize)) == NULL)
+      {
+      SetIncremental(False);
+      return(False);
+      }
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+#if defined(CompileStatistics)
+STDAPI tokenizer::GetCompileStats(TCompileStats *Stats)
+/*Sets Stats to the phase times and counts of the last Compile, CompileView or ProbeDirectives call (ProbeDirectives
+  only counts elements).  Always returns True.*/
+{
+  *Stats = CompileStats;
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI tokenizer::SetTrace(TCompileTrace *Trace)
+/*Record a span for each phase and each instruction of every following Compile or CompileView, and one for the compile
+  itself, in Trace (see WriteTraceFile).  NULL stops tracing.  Always returns True.*/
+{
+  tzTrace = Trace;
+  return(True);
+}
+#endif
+
+#if defined(__cplusplus)        /* End of the c namespace */
+}
+#endif
+
+//#ifdef __APPLE_CC__
+//  #pragma export off            /* End of exported functions when compiling on a Macintosh */
+//#endif
+
+/*------------------------------------------------------------------------------*/
+
+byte tokenizer::ResWordTypeID(TElementType ElementType)
+/*Translate similar types to the common type*/
+{
+  byte Result;
+
+  Result = (byte)ElementType;                            /*Assume type needs no translation*/
+
+  /*Translate if necessary*/
+  switch (ElementType)
+    {
+    case etCCDirective  :
+    case etCCThen       : Result = (byte)etCCDirective;  /*GRW: etCCDirective*/
+                          break;
+    case etInstruction  :
+    case etData         :
+    case etStep         :
+    case etTo           :
+    case etThen         :
+    case etWhile        :
+    case etUntil        : Result = (byte)etInstruction;  /*GRW: etInstruction*/
+                          break;
+    case etCon          :
+    case etPin          :
+    case etVar          : Result = (byte)etCon;          /*GRW: etDeclaration*/
+                          break;
+    case etVariableAuto : Result = (byte)etVariableAuto; /*GRW: etVariableType*/
+                          break;
+    case etAnyNumberIO  :
+    case etASCIIIO      :
+    case etNumberIO     :
+    case etRepeatIO     :
+    case etSkipIO       :
+    case etSpStringIO   :
+    case etStringIO     :
+    case etWaitIO       :
+    case etWaitStringIO : Result = (byte)etAnyNumberIO;  /*GRW: etIOFormatter*/
+                          break;
+    case etCond1Op      :
+    case etCond2Op      :
+    case etCond3Op      : Result = (byte)etCond1Op;      /*GRW: etConditionalOp*/
+                          break;
+    case etLeft         :
+    case etRight        : Result = (byte)etLeft;         /*GRW: etParentheses*/
+                          break;
+    case etLeftBracket  :
+    case etRightBracket : Result = (byte)etLeftBracket;  /*GRW: etBrackets*/
+                          break;
+    default             : break;                         /*All other ElementTypes, no translation*/
+    }
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::InitializeRec(void)
+/*Initialize most critical fields of tzModuleRec*/
+{
+  InitializeDirectiveFields();                  /*Init Error string, Project Files array, Port and directive starts*/
+  ClearEEPROM();                                /*Clear EEPROM*/
+  ClearSrcTokReference();                       /*Clear Source vs Token Cross Reference*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::InitializeDirectiveFields(void)
+/*Initialize the Error string and the tzModuleRec fields set by editor directives (but not TargetModule, which may be set
+  by the caller, or LanguageVersion)*/
+{
+  int  Idx;
+
+  tzModuleRec->Error = NULL;                    /*Init Error string, Project Files array and TargetModule (if allowed)*/
+  
+  int scomp = 7; // sizeof(tzModuleRec->ProjectFiles) / sizeof(char *);
+  
   for (Idx = 0; Idx < scomp; Idx++)
 	{
 	tzModuleRec->ProjectFiles[Idx] = NULL;
@@ -1074,8 +1832,6 @@ void tokenizer::InitializeRec(void)
   tzModuleRec->Port = NULL;                     /*Init Port number*/
   tzModuleRec->PortStart = 0;
   tzModuleRec->LanguageStart = 0;
-  ClearEEPROM();                                /*Clear EEPROM*/
-  ClearSrcTokReference();                       /*Clear Source vs Token Cross Reference*/
 }
 
 /*------------------------------------------------------------------------------*/
@@ -1107,6 +1863,132 @@ void tokenizer::ClearSrcTokReference(void)
   SrcTokReferenceIdx = 0;
 }
 
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::ReuseResults(bool ParseStampDirective)
+/*If compiling incrementally, and the source elementized to the same elements as the last compile's (but for position)
+  and is compiled the same way for the same target, set tzModuleRec and tzSrcTokReference to the last compile's results
+  of the passes after CompileEditorDirectives, with their source positions moved along with the source.  Returns True
+  if results were reused, False if those passes must run.*/
+{
+  TModuleRec  *Results;
+  int         ErrorStart;
+  int         Idx;
+
+  if ( (Incremental == NULL) || !(Incremental->Unchanged) || (Incremental->ParseStampDirective != ParseStampDirective) ||
+       (Incremental->Referenced != (tzSrcTokReference != NULL)) || (Incremental->TargetModule != tzModuleRec->TargetModule) ||
+       (Incremental->LanguageVersion != tzModuleRec->LanguageVersion) ) return(False);
+  Results = &Incremental->Results;
+  ErrorStart = 0;
+  if ( !(Results->Succeeded) && ((Results->ErrorStart > 0) || (Results->ErrorLength > 0)) )
+    { /*Error has a place in the source; it must be wholly before or after the edit*/
+    ErrorStart = MapPosition(Results->ErrorStart);
+    if ( (ErrorStart < 0) || (MapPosition(Results->ErrorStart+Results->ErrorLength)-ErrorStart != Results->ErrorLength) ) return(False);
+    }
+  for (Idx = 0; Idx < Incremental->ReferenceCount; Idx++)
+    if (MapPosition(Incremental->References[Idx].SrcStart) < 0) return(False);
+  /*Reuse results*/
+  tzModuleRec->Succeeded = Results->Succeeded;
+  tzModuleRec->DebugFlag = Results->DebugFlag;
+  tzModuleRec->ErrorStart = ErrorStart;
+  tzModuleRec->ErrorLength = Results->ErrorLength;
+  memcpy(tzModuleRec->EEPROM, Results->EEPROM, sizeof(Results->EEPROM));
+  memcpy(tzModuleRec->EEPROMFlags, Results->EEPROMFlags, sizeof(Results->EEPROMFlags));
+  memcpy(tzModuleRec->VarCounts, Results->VarCounts, sizeof(Results->VarCounts));
+  tzModuleRec->PacketCount = Results->PacketCount;
+  memcpy(tzModuleRec->PacketBuffer, Results->PacketBuffer, sizeof(Results->PacketBuffer));
+  if (Incremental->ErrorOffset >= 0)
+    tzModuleRec->Error = (char *)&(tzModuleRec->PacketBuffer[Incremental->ErrorOffset]);
+  else
+    if (Incremental->ErrorOffset == -1)
+      { /*User-defined error; copy it to the upper source buffer, as CompileCCError does*/
+      strcpy(&tzSource[MaxSourceSize-1-strlen(Incremental->ErrorText)], Incremental->ErrorText);
+      tzModuleRec->Error = &tzSource[MaxSourceSize-1-strlen(Incremental->ErrorText)];
+      }
+  for (Idx = 0; Idx < Incremental->ReferenceCount; Idx++)
+    {
+    (tzSrcTokReference+Idx)->SrcStart = MapPosition(Incremental->References[Idx].SrcStart);
+    (tzSrcTokReference+Idx)->TokStart = Incremental->References[Idx].TokStart;
+    }
+  SrcTokReferenceIdx = Incremental->ReferenceCount;
+  #if defined(CompileStatistics)
+    CompileStats.ReusedResults = True;
+  #endif
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::SaveResults(bool ParseStampDirective)
+/*If compiling incrementally, keep the results of the passes after CompileEditorDirectives, and how they were compiled,
+  for the next compile's ReuseResults.*/
+{
+  if (Incremental == NULL) return;
+  Incremental->ResultsValid = Incremental->Recorded;
+  if (!(Incremental->Recorded)) return;
+  Incremental->Results = *tzModuleRec;
+  Incremental->ParseStampDirective = ParseStampDirective;
+  Incremental->Referenced = (tzSrcTokReference != NULL);
+  Incremental->TargetModule = tzModuleRec->TargetModule;
+  Incremental->LanguageVersion = tzModuleRec->LanguageVersion;
+  if (tzModuleRec->Error == NULL)
+    Incremental->ErrorOffset = -2;
+  else
+    if ( (tzModuleRec->Error >= (char *)tzModuleRec->PacketBuffer) && (tzModuleRec->Error < (char *)tzModuleRec->PacketBuffer+sizeof(TPacketType)) )
+      Incremental->ErrorOffset = (int)(tzModuleRec->Error-(char *)tzModuleRec->PacketBuffer);
+    else
+      { /*User-defined error in the upper source buffer*/
+      Incremental->ErrorOffset = -1;
+      if (strlen(tzModuleRec->Error) < sizeof(Incremental->ErrorText))
+        strcpy(Incremental->ErrorText, tzModuleRec->Error);
+      else
+        Incremental->ResultsValid = False;
+      }
+  Incremental->ReferenceCount = (tzSrcTokReference != NULL ? SrcTokReferenceIdx : 0);
+  if (Incremental->ReferenceCount > 0) memcpy(Incremental->References, tzSrcTokReference, Incremental->ReferenceCount*sizeof(TSrcTokReference));
+}
+
+/*------------------------------------------------------------------------------*/
+
+#if defined(CompileStatistics)
+void tokenizer::BeginPhase(void)
+/*Note the start time of a compile phase (see TimePhase)*/
+{
+  PhaseStart = StatsClock();
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::EndPhase(TCompilePhase Phase, TErrorCode Result)
+/*Add the time since BeginPhase to Phase.  Returns Result.*/
+{
+  CompileStats.PhaseTime[Phase] += StatsClock() - PhaseStart;
+  if (tzTrace != NULL) TraceSpan(tkPhase, Phase, PhaseStart, 0, 0);
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::TraceSpan(TTraceKind Kind, int Value, long long Start, int SrcStart, int SrcLength)
+/*Append a span from Start until now to tzTrace, or count it as dropped if tzTrace is full*/
+{
+  TTraceEvent *Event;
+
+  if (tzTrace->Count >= tzTrace->Capacity)
+    {
+    tzTrace->Dropped++;
+    return;
+    }
+  Event = &tzTrace->Events[tzTrace->Count++];
+  Event->Start = Start;
+  Event->Duration = StatsClock() - Start;
+  Event->Kind = Kind;
+  Event->Value = Value;
+  Event->SrcStart = SrcStart;
+  Event->SrcLength = SrcLength;
+}
+#endif
+
 
 /*------------------------------------------------------------------------------*/
 /*----------------------------- Expression Engine ------------------------------*/
@@ -1510,22 +2392,26 @@ preceed 6-bit code.  StackIdx is tested and updated according to operator.*/
 /*------------------------------------------------------------------------------*/
 
 TErrorCode tokenizer::EnterExpressionBits(byte Bits, word Data)
-/*Enter Bits bits of Data into Expression*/
-{
-  byte ShiftFactor;
-
-  Data = Data << (16-Bits); /*MSB-justify data (to truncate off left side)*/
-  while (Bits > 0)
-    { /*While more bits to insert*/
-    ShiftFactor = Expression[0][0] & 15;               /*Calculate bit offset*/
-    if (ShiftFactor == 0) Expression[0][Expression[0][0] / /*div*/ 16 + 1] = 0; /*If new Expression word, clear it to 0*/
-    /*Enter the expression data (shifting current data left*/
-    Expression[0][Expression[0][0] / /*div*/ 16 + 1] = (Expression[0][Expression[0][0] / /*div*/ 16 + 1] << Lowest(16-ShiftFactor,Bits)) | (Data >> (16-Lowest(16-ShiftFactor,Bits)));
-    Data = Data << (16-ShiftFactor);                   /*Adjust Data in anticipation for next Expression word*/
-    Expression[0][0] += Lowest(Bits,16-ShiftFactor);   /*Adjust Expression Index according to how many bits actually written*/
-    if (Expression[0][0] == ExpressionSize-16) return(Error(ecEITC)); /*If Expression array full, Error: Expression Is Too Complex*/
-    Bits -= Lowest(16-ShiftFactor,Bits);               /*Decrement Bits counter appropriately*/
+/*Enter Bits bits (0 to 16) of Data into Expression.  The bits of the last, partly filled, word are kept right-justified,
+ so the new bits are joined to them in one 32-bit run and stored as one or two words.*/
+{
+  word          WordIdx;
+  byte          Used;
+  unsigned int  Run;
+
+  if (Bits == 0) return(ecS);
+  if (Expression[0][0]+Bits >= ExpressionSize-16) return(Error(ecEITC)); /*If Expression array would be full, Error: Expression Is Too Complex*/
+  WordIdx = Expression[0][0] / /*div*/ 16 + 1;
+  Used = Expression[0][0] & 15;                      /*Bits already in last word*/
+  Run = ((Used == 0 ? 0 : (unsigned int)Expression[0][WordIdx]) << Bits) | (Data & ((1 << Bits)-1));
+  if (Used+Bits <= 16)
+    Expression[0][WordIdx] = Run;
+  else
+    { /*Run spills into the next word*/
+    Expression[0][WordIdx] = Run >> (Used+Bits-16);
+    Expression[0][WordIdx+1] = Run & ((1 << (Used+Bits-16))-1);
     }
+  Expression[0][0] += Bits;
   return(ecS); /*Return success*/
 }
 
@@ -1608,29 +2494,42 @@ and compared to ExpStackBottom.  Returns true if value popped, false if stack em
 
 void tokenizer::CopyExpression(byte SourceNumber, byte DestinationNumber)
 /*Copy expression from Expression[SourceNumber,...] to Expression[DestinationNumber,...].
-SourceNumber and DestinationNumber must be 0 to 3*/
+SourceNumber and DestinationNumber must be 0 to 3.  Only the size word and the words in use are copied.*/
 {
-  int   Idx;
-
-  for (Idx = 0; Idx <= (ExpressionSize / /*div*/ 16) - 1; Idx++) Expression[DestinationNumber][Idx] = Expression[SourceNumber][Idx];
+  memcpy(Expression[DestinationNumber], Expression[SourceNumber], ((Expression[SourceNumber][0]+15) / /*div*/ 16 + 1)*sizeof(word));
 }
 
 /*------------------------------------------------------------------------------*/
 
 TErrorCode tokenizer::EnterExpression(byte ExpNumber, bool Enter1Before)
 /*Enter expression(ExpNumber) into EEPROM.  Preceede expression with a 1 if
-Enter1Before is true. ExpNumber should be 0 to 3*/
+Enter1Before is true. ExpNumber should be 0 to 3.  The expression is entered up to three
+words (48 bits) at a time; only the last word may be partly filled (its low bits).*/
 {
   TErrorCode  Result;
   int         Idx;
+  byte        Bits;
+  byte        WordBits;
+  uint64_t    Data;
 
-  if (Enter1Before) { if ((Result = EnterEEPROM(1,1))) return(Result); }
   Idx = 0;
+  Bits = 0;
+  Data = 0;
+  if (Enter1Before) { Bits = 1; Data = 1; }
   while (Idx < Expression[ExpNumber][0])
     { /*for all bits in expression...*/
-    if ((Result = EnterEEPROM(Lowest(16,Expression[ExpNumber][0]-Idx),Expression[ExpNumber][Idx / /*div*/ 16 + 1]))) return(Result);
-    Idx += Lowest(16,Expression[ExpNumber][0]-Idx);
+    WordBits = Lowest(16,Expression[ExpNumber][0]-Idx);
+    Data = (Data << WordBits) | (Expression[ExpNumber][Idx / /*div*/ 16 + 1] & ((1 << WordBits)-1));
+    Bits += WordBits;
+    Idx += WordBits;
+    if (Bits > 32)
+      { /*Accumulator full enough, enter it*/
+      if ((Result = EnterEEPROMBits(Bits,Data))) return(Result);
+      Bits = 0;
+      Data = 0;
+      }
     }
+  if ((Result = EnterEEPROMBits(Bits,Data))) return(Result);
   return(ecS); /*Return success*/
 }
 
@@ -1639,37 +2538,55 @@ Enter1Before is true. ExpNumber should be 0 to 3*/
 /*------------------------------------------------------------------------------*/
 
 TErrorCode tokenizer::InitSymbols(void)
-/*Clear all vectors (SymbolVector and UndefSymbolVector array and SymbolTable.NextRecord and
-UndefSymbolTable.NextRecord) to -1, clear SymbolTablePointer and UndefSymbolTablePointer to 0,
-and insert all automatic symbols into SymbolTable.*/
+/*Clear all vectors (SymbolVector, UndefSymbolVector and NameVector array and UndefSymbolTable.NextRecord) to -1, clear
+UndefSymbolTablePointer and NameTablePointer to 0, and load SymbolTable with the shared image of all automatic common
+symbols.  When compiling incrementally, the last compile's cached elements refer to names in NameTable, so those are
+kept (but unlinked from symbols) unless NameTable is half full; then it's cleared and the element caches with it.*/
 {
-  int         Idx;
-  TErrorCode  Result;
+  int                Idx;
+  bool               KeepNames;
 
+  KeepNames = (Incremental != NULL) && (Incremental->Caches[Incremental->Current].Valid) && (NameTablePointer < SymbolTableSize/2);
   /*Clear All Vectors*/
   for (Idx = 0; Idx < SymbolTableSize; Idx++)
     {
     SymbolVectors[Idx] = -1;
-    SymbolTable[Idx].NextRecord = -1;
     UndefSymbolVectors[Idx] = -1;
     UndefSymbolTable[Idx].NextRecord = -1;
+    if (!KeepNames) NameVectors[Idx] = -1;
     }
-  SymbolTablePointer = 0;
   UndefSymbolTablePointer = 0;
-  /*Enter automatic common symbols*/
-  for (Idx = 0; Idx < (sizeof(CommonSymbols)/sizeof(TSymbolTable)); Idx++) if ((Result = EnterSymbol(CommonSymbols[Idx]))) return(Result);
+  if (KeepNames)
+    for (Idx = 0; Idx < NameTablePointer; Idx++)
+      {
+      NameTable[Idx].Symbol = -1;
+      NameTable[Idx].Undef = False;
+      }
+  else
+    {
+    NameTablePointer = 0;
+    if (Incremental != NULL)
+      {
+      Incremental->Caches[0].Valid = Incremental->Caches[1].Valid = False;
+      Incremental->ResultsValid = False;
+      }
+    }
+  memset(&SymbolStats, 0, sizeof(SymbolStats));
+  /*Load automatic common symbols*/
+  ReservedImage = GetSymbolImage(tmNone, False);
+  memcpy(SymbolTable, ReservedImage->SymbolTable, ReservedImage->SymbolTablePointer*sizeof(TSymbolTable));
+  SymbolTablePointer = ReservedImage->SymbolTablePointer;
   return(ecS); /*Return success*/
 }
 
 /*------------------------------------------------------------------------------*/
 
 TErrorCode tokenizer::AdjustSymbols(void)
-/*Add additional automatic symbols into symbol table for designated target module and PBASIC Language version.*/
+/*Add additional automatic symbols into symbol table for designated target module and PBASIC Language version.  These
+  are appended from the shared image for this target and version; the common symbols already in place are left alone
+  since CompileEditorDirectives has modified the values of $STAMP, $PORT and $PBASIC by now.*/
 {
-  int         Idx;
-  word        LangMask;
-  const  int  Target[tmNumElements] = {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20};
-  TErrorCode  Result;
+  int                CommonCount;
 
   if ( !((tzModuleRec->TargetModule >= (byte)tmBS2) && (tzModuleRec->TargetModule < tmNumElements)) )
     { /*Error, Unknown target module*/
@@ -1677,22 +2594,85 @@ TErrorCode tokenizer::AdjustSymbols(void)
     tzModuleRec->ErrorLength = 0;
     return(Error(ecUTMSDNF));
     }
-  LangMask = 0x40 << (Lang250 ? 1 : 0);  /*Determine language version mask*/
-  /*Enter automatic symbols for designated target module and PBASIC Language version*/
-  for (Idx = 0; Idx <= CustomSymbolTableSize; Idx++)
-    if ( (CustomSymbols[Idx].Targets & (Target[tzModuleRec->TargetModule] | LangMask)) == (Target[tzModuleRec->TargetModule] | LangMask)) if ((Result = EnterSymbol(CustomSymbols[Idx].Symbol))) return(Result);
+  CommonCount = ReservedImage->SymbolTablePointer;
+  ReservedImage = GetSymbolImage(tzModuleRec->TargetModule, Lang250);
+  memcpy(&SymbolTable[CommonCount], &ReservedImage->SymbolTable[CommonCount], (ReservedImage->SymbolTablePointer-CommonCount)*sizeof(TSymbolTable));
+  SymbolTablePointer = ReservedImage->SymbolTablePointer;
   return(ecS); /*Return success*/
 }
 
 /*------------------------------------------------------------------------------*/
 
+void tokenizer::BuildSymbolImage(TSymbolImage *Image, byte TargetModule, bool Version250)
+/*Build Image from scratch with all automatic common symbols and, unless TargetModule is tmNone, the automatic custom
+  symbols for TargetModule and the PBASIC Language version (2.5 if Version250, 2.0 otherwise).  Automatic symbols are
+  found through the reserved word perfect hash, so they are not linked into any SymbolVectors chain.*/
+{
+  int          Idx;
+  word         LangMask;
+  unsigned int Hash;
+  byte         Length;
+  const  int   Target[tmNumElements] = {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20};
+  const TSymbolTable *Symbol;
+
+  for (Idx = 0; Idx < ReservedWordCount; Idx++) Image->ReservedVectors[Idx] = -1;
+  Image->SymbolTablePointer = 0;
+  LangMask = 0x40 << (Version250 ? 1 : 0);  /*Determine language version mask*/
+  for (Idx = 0; Idx < ReservedWordCount; Idx++)
+    { /*Enter automatic common symbols, then automatic symbols for designated target module and PBASIC Language version*/
+    if (Idx < CommonSymbolTableSize)
+      Symbol = &CommonSymbols[Idx];
+    else
+      {
+      if (TargetModule == tmNone) break;
+      if ( (CustomSymbols[Idx-CommonSymbolTableSize].Targets & (Target[TargetModule] | LangMask)) != (Target[TargetModule] | LangMask) ) continue;
+      Symbol = &CustomSymbols[Idx-CommonSymbolTableSize].Symbol;
+      }
+    Image->SymbolTable[Image->SymbolTablePointer] = *Symbol;
+    Image->SymbolTable[Image->SymbolTablePointer].NextRecord = -1;
+    Hash = SymbolNameHash(Symbol->Name, &Length);
+    Image->ReservedVectors[FindReservedWord(Symbol->Name, Hash, Length)] = Image->SymbolTablePointer;
+    Image->SymbolTablePointer++;
+    }
+}
+
+/*------------------------------------------------------------------------------*/
+
+const TSymbolImage *tokenizer::GetSymbolImage(byte TargetModule, bool Version250)
+/*Return the shared symbol image for TargetModule (tmBS2..tmBS2pe, or tmNone for common symbols only) and PBASIC
+  Language version.  All images are built together the first time any is requested and never change afterwards, so
+  any number of tokenizer objects may read them at once.*/
+{
+  static const TSymbolImage *Images = []()
+    {
+    TSymbolImage *Result = new TSymbolImage[SymbolImageCount];
+    byte         Module;
+
+    BuildSymbolImage(&Result[0], tmNone, False);
+    for (Module = tmBS2; Module < tmNumElements; Module++)
+      {
+      BuildSymbolImage(&Result[SymbolImageIndex(Module, False)], Module, False);
+      BuildSymbolImage(&Result[SymbolImageIndex(Module, True)], Module, True);
+      }
+    return(Result);
+    }();
+
+  return(&Images[TargetModule == tmNone ? 0 : SymbolImageIndex(TargetModule, Version250)]);
+}
+
+/*------------------------------------------------------------------------------*/
+
 TErrorCode tokenizer::EnterSymbol(TSymbolTable Symbol)
-/*Enter symbol into next available location in SymbolTable*/
+/*Enter symbol into next available location in SymbolTable and link it into its SymbolVectors chain, and from its
+ name's record in the name table, if any, so elements of that name find it directly (see GetElement)*/
 {
-  int Vector;
+  int          Vector;
+  unsigned int Hash;
+  byte         Length;
 
   if (SymbolTablePointer >= SymbolTableSize) return(Error(ecSTF));
-  Vector = CalcSymbolHash(Symbol.Name);
+  Hash = CalcSymbolHash(Symbol.Name, &Length);
+  Vector = Hash & (SymbolTableSize-1);
   if (SymbolVectors[Vector] == -1)  /*If this hash is unused, set it to next record in SymbolTable*/
     SymbolVectors[Vector] = SymbolTablePointer;
   else
@@ -1704,6 +2684,11 @@ TErrorCode tokenizer::EnterSymbol(TSymbolTable Symbol)
   strcpy(SymbolTable[SymbolTablePointer].Name, Symbol.Name);
   SymbolTable[SymbolTablePointer].ElementType = Symbol.ElementType;
   SymbolTable[SymbolTablePointer].Value = Symbol.Value;
+  SymbolTable[SymbolTablePointer].NextRecord = -1;
+  SymbolKeys[SymbolTablePointer].Hash = Hash;
+  SymbolKeys[SymbolTablePointer].Length = Length;
+  Vector = GetNameVector(Symbol.Name, Hash, Length);
+  if ( (Vector > -1) && (NameTable[Vector].Symbol == -1) ) NameTable[Vector].Symbol = SymbolTablePointer;
   SymbolTablePointer++;
   return(ecS); /*Return success*/
 }
@@ -1715,10 +2700,13 @@ TErrorCode tokenizer::EnterUndefSymbol(char *Name)
  undefined symbol names that are DATA, VAR, CON or PIN types so they can be distinguished from un-DEFINE'd symbols in the
  GetExpression routine while parsing Conditional Compile Directive expressions.*/
 {
-  int  Vector;
+  int          Vector;
+  unsigned int Hash;
+  byte         Length;
 
   if (UndefSymbolTablePointer >= SymbolTableSize) return(Error(ecSTF));
-  Vector = CalcSymbolHash(Name);
+  Hash = CalcSymbolHash(Name, &Length);
+  Vector = Hash & (SymbolTableSize-1);
   if (UndefSymbolVectors[Vector] == -1) /*If this hash is unused, set it to next record in UndefSymbolTable*/
     UndefSymbolVectors[Vector] = UndefSymbolTablePointer;
   else
@@ -1728,7 +2716,12 @@ TErrorCode tokenizer::EnterUndefSymbol(char *Name)
     UndefSymbolTable[Vector].NextRecord = UndefSymbolTablePointer;
     }
   strcpy(UndefSymbolTable[UndefSymbolTablePointer].Name, Name);
+  UndefSymbolTable[UndefSymbolTablePointer].Hash = Hash;
+  UndefSymbolTable[UndefSymbolTablePointer].Length = Length;
+  UndefSymbolTable[UndefSymbolTablePointer].Declaration = -1;
   UndefSymbolTablePointer++;
+  Vector = GetNameVector(Name, Hash, Length);
+  if (Vector > -1) NameTable[Vector].Undef = True;
   return(ecS); /*Return success*/
 }
 
@@ -1774,45 +2767,142 @@ Returns false if not found;*/
 
 /*------------------------------------------------------------------------------*/
 
-int tokenizer::GetSymbolVector(const char *Name)
-/*Find vector (element number) of Symbol.Name in SymbolTable.  Returns value >= 0 if successful
-Returns -1 if fails.*/
+int tokenizer::GetSymbolVector(const char *Name)
+/*Find vector (element number) of Symbol.Name in SymbolTable.  Returns value >= 0 if successful
+Returns -1 if fails.  Automatic symbols are found through the reserved word perfect hash, other symbols through the
+SymbolVectors chains.  Each record examined along the way is counted in SymbolStats.*/
+{
+  int          Result;
+  unsigned int Hash;
+  unsigned int Probes;
+  byte         Length;
+
+  Hash = CalcSymbolHash(Name, &Length);
+  Result = FindReservedWord(Name, Hash, Length);
+  if ((Result > -1) && (ReservedImage->ReservedVectors[Result] > -1))
+    { /*Automatic symbol for this target and version*/
+    SymbolStats.Lookups++;
+    SymbolStats.ReservedHits++;
+    SymbolStats.Probes++;
+    if (SymbolStats.MaxProbes < 1) SymbolStats.MaxProbes = 1;
+    return(ReservedImage->ReservedVectors[Result]);
+    }
+  Result = SymbolVectors[Hash & (SymbolTableSize-1)];
+  /*Search until symbols match or end of branch found.  The cached hash and length rule out nearly every
+    non-matching record before the name itself is compared*/
+  Probes = 0;
+  while (Result > -1)
+    {
+    Probes++;
+    if ( (SymbolKeys[Result].Hash == Hash) && (SymbolKeys[Result].Length == Length) && (memcmp(SymbolTable[Result].Name,Name,Length) == 0) ) break;
+    Result = SymbolTable[Result].NextRecord;
+    }
+  SymbolStats.Lookups++;
+  SymbolStats.Probes += Probes;
+  if (Probes > SymbolStats.MaxProbes) SymbolStats.MaxProbes = Probes;
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+int tokenizer::GetUndefSymbolVector(char *Name)
+/*Find vector (element number) of Symbol.Name in UndefSymbolTable.  Returns value >= 0 if successful.
+Returns -1 if fails.*/
+{
+  int          Result;
+  unsigned int Hash;
+  byte         Length;
+
+  Hash = CalcSymbolHash(Name, &Length);
+  Result = UndefSymbolVectors[Hash & (SymbolTableSize-1)];
+  /*Search until symbols match or end of branch found*/
+  while ( (Result > -1) && !((UndefSymbolTable[Result].Hash == Hash) && (UndefSymbolTable[Result].Length == Length) && (memcmp(UndefSymbolTable[Result].Name,Name,Length) == 0)) )
+    Result = UndefSymbolTable[Result].NextRecord;
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+word tokenizer::InternName(const char *Name)
+/*Find Name (of an undefined symbol) in NameTable, entering it into the next available location if it's not there.
+ Returns its record, which is kept as the value of the symbol's elements, or UninternedName if NameTable is full.*/
+{
+  int          Vector;
+  unsigned int Hash;
+  byte         Length;
+
+  Hash = CalcSymbolHash(Name, &Length);
+  Vector = GetNameVector(Name, Hash, Length);
+  if (Vector > -1) return(Vector);
+  if (NameTablePointer >= SymbolTableSize) return(UninternedName);
+  Vector = Hash & (SymbolTableSize-1);
+  if (NameVectors[Vector] == -1)    /*If this hash is unused, set it to next record in NameTable*/
+    NameVectors[Vector] = NameTablePointer;
+  else
+    {                               /*If hash is used, move to first record, find end of chain and add new record*/
+    Vector = NameVectors[Vector];
+    while (NameTable[Vector].NextRecord > -1) Vector = NameTable[Vector].NextRecord; /*chain to the last record*/
+    NameTable[Vector].NextRecord = NameTablePointer;
+    }
+  strcpy(NameTable[NameTablePointer].Name, Name);
+  NameTable[NameTablePointer].NextRecord = -1;
+  NameTable[NameTablePointer].Hash = Hash;
+  NameTable[NameTablePointer].Length = Length;
+  NameTable[NameTablePointer].Symbol = -1;
+  NameTable[NameTablePointer].Undef = (GetUndefSymbolVector(NameTable[NameTablePointer].Name) > -1);
+  return(NameTablePointer++);
+}
+
+/*------------------------------------------------------------------------------*/
+
+int tokenizer::GetNameVector(const char *Name, unsigned int Hash, byte Length)
+/*Find vector (element number) of Name, whose hash is Hash and length is Length, in NameTable.  Returns value >= 0 if
+successful.  Returns -1 if fails.*/
+{
+  int          Result;
+
+  Result = NameVectors[Hash & (SymbolTableSize-1)];
+  /*Search until names match or end of branch found*/
+  while ( (Result > -1) && !((NameTable[Result].Hash == Hash) && (NameTable[Result].Length == Length) && (memcmp(NameTable[Result].Name,Name,Length) == 0)) )
+    Result = NameTable[Result].NextRecord;
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+unsigned int tokenizer::CalcSymbolHash(const char *SymbolName, byte *Length)
+/*Calculate 32-bit FNV-1a hash from characters within Symbol and set Length to the number of characters.  The hash is
+kept with the symbol's record; its low bits (masked with SymbolTableSize-1) become the vector index of the SymbolVector
+array.  Unlike a sum of characters, this separates anagrams (ABC, CBA) and numbered names (LED_01..LED_10).*/
 {
-  int  Result;
-
-  Result = SymbolVectors[CalcSymbolHash(Name)];
-  /*Search until symbols match or end of branch found*/
-
-  while ((Result > -1) && (strcmp(SymbolTable[Result].Name,Name) != 0)) Result = SymbolTable[Result].NextRecord;
-  return(Result);
+  return(SymbolNameHash(SymbolName, Length));
 }
 
 /*------------------------------------------------------------------------------*/
 
-int tokenizer::GetUndefSymbolVector(char *Name)
-/*Find vector (element number) of Symbol.Name in UndefSymbolTable.  Returns value >= 0 if successful.
-Returns -1 if fails.*/
+int tokenizer::FindReservedWord(const char *Name, unsigned int Hash, byte Length)
+/*Find Name (with symbol hash Hash and length Length) among the reserved words.  Returns its perfect hash slot if
+  successful, -1 if Name is not a reserved word.*/
 {
-  int  Result;
+  int Slot;
+  int Word;
 
-  Result = UndefSymbolVectors[CalcSymbolHash(Name)];
-  /*Search until symbols match or end of branch found*/
-  while ((Result > -1) && (strcmp(UndefSymbolTable[Result].Name,Name) != 0)) Result = UndefSymbolTable[Result].NextRecord;
-  return(Result);
+  Slot = ReservedSlot(Hash, ReservedWordHash.Displacement[Hash & (ReservedBucketCount-1)]);
+  Word = ReservedWordHash.Word[Slot];
+  if ( (ReservedWordHash.Hash[Slot] == Hash) && (strlen(ReservedWordName(Word)) == Length) && (memcmp(ReservedWordName(Word),Name,Length) == 0) ) return(Slot);
+  return(-1);
 }
 
 /*------------------------------------------------------------------------------*/
 
-int tokenizer::CalcSymbolHash(const char *SymbolName)
-/*Calculate additive hash from characters within Symbol (truncated to SymbolTableSize-1).  This becomes
-the vector index of the SymbolVector array.*/
+bool tokenizer::IsReservedWord(const char *Name)
+/*Returns True if Name is a reserved word for any target module and PBASIC Language version, False otherwise.*/
 {
-  int Idx;
-  int Hash;
+  unsigned int Hash;
+  byte         Length;
 
-  Hash = 0;
-  for (Idx = 0; *(SymbolName+Idx) != 0; Idx++) Hash = Hash + *(SymbolName+Idx);
-  return(Hash & (SymbolTableSize-1));
+  Hash = CalcSymbolHash(Name, &Length);
+  return(FindReservedWord(Name, Hash, Length) > -1);
 }
 
 /*------------------------------------------------------------------------------*/
@@ -1830,17 +2920,125 @@ TErrorCode tokenizer::ElementError(bool IncLength, TErrorCode ErrorID)
 
 /*------------------------------------------------------------------------------*/
 
+tokenizer::~tokenizer()
+/*Free the element arena and element caches.*/
+{
+  TArenaBlock *Block;
+
+  while ((Block = ElementArena) != NULL)
+    {
+    ElementArena = Block->Next;
+    free(Block);
+    }
+  SetIncremental(False);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void *tokenizer::ElementAlloc(size_t Size)
+/*Return Size bytes of storage from the element arena, chaining on a new block (at least twice the size of the last) if
+ the newest block is full.  Storage is never freed individually; it all goes back to the arena with ResetElements.
+ Returns NULL if out of memory.*/
+{
+  TArenaBlock *Block;
+  size_t       BlockSize;
+
+  Size = (Size+7) & ~(size_t)7;   /*Keep storage 8-byte aligned*/
+  if ( (ElementArena == NULL) || (ElementArena->Used+Size > ElementArena->Size) )
+    { /*No room left, chain on a new block*/
+    BlockSize = (ElementArena == NULL ? ElementArenaSize : ElementArena->Size*2);
+    while (BlockSize < Size) BlockSize *= 2;
+    if ((Block = (TArenaBlock *) malloc(sizeof(TArenaBlock)+BlockSize)) == NULL) return(NULL);
+    Block->Next = ElementArena;
+    Block->Size = BlockSize;
+    Block->Used = 0;
+    ElementArena = Block;
+    }
+  ElementArena->Used += Size;
+  return((byte *)(ElementArena+1) + ElementArena->Used-Size);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::ResetElements(void)
+/*Empty the element lists, and the arrays sized by them, for a new compile and hand all their storage back to the
+ element arena.  If the last compile needed more than one block, they're replaced by one block of their total size, so
+ that a like compile next time fits in it.*/
+{
+  TArenaBlock *Block;
+  size_t       Size;
+  int          Kind;
+
+  if ( (ElementArena != NULL) && (ElementArena->Next != NULL) )
+    { /*Several blocks, free them all and start over with one as big*/
+    Size = 0;
+    while ((Block = ElementArena) != NULL)
+      {
+      Size += Block->Size;
+      ElementArena = Block->Next;
+      free(Block);
+      }
+    if ((ElementArena = (TArenaBlock *) malloc(sizeof(TArenaBlock)+Size)) != NULL)
+      {
+      ElementArena->Next = NULL;
+      ElementArena->Size = Size;
+      }
+    }
+  if (ElementArena != NULL) ElementArena->Used = 0;
+  memset(&SourceElements, 0, sizeof(TElementStore));
+  memset(&DirectiveElements, 0, sizeof(TElementStore));
+  UnresolvedElements = NULL;
+  for (Kind = 0; Kind < dkNumElements; Kind++) DeclarationLines[Kind] = NULL;
+  DeclarationStack = NULL;
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::GrowElements(TElementStore *Store)
+/*Double the capacity of Store (up to ElementListSize elements), copying its elements into new arrays from the element
+ arena.  UnresolvedElements grows along with SourceElements.*/
+{
+  TElementStore New;
+  word         *Unresolved;
+
+  if (Store->Capacity >= ElementListSize) return(ElementError(False, ecTME));
+  New.Capacity = (Store->Capacity == 0 ? ElementListGrowth : Lowest(Store->Capacity*2, ElementListSize));
+  New.Types = (byte *) ElementAlloc(New.Capacity);
+  New.Values = (word *) ElementAlloc(New.Capacity*sizeof(word));
+  New.Starts = (word *) ElementAlloc(New.Capacity*sizeof(word));
+  New.Lengths = (byte *) ElementAlloc(New.Capacity);
+  Unresolved = (Store == &SourceElements ? (word *) ElementAlloc(New.Capacity*sizeof(word)) : NULL);
+  if ( (New.Types == NULL) || (New.Values == NULL) || (New.Starts == NULL) || (New.Lengths == NULL) || ((Store == &SourceElements) && (Unresolved == NULL)) )
+    return(ElementError(False, ecTME)); /*Out of memory, Error: Too many elements*/
+  if (Store->Capacity > 0)
+    { /*Copy elements entered so far*/
+    memcpy(New.Types, Store->Types, Store->Capacity);
+    memcpy(New.Values, Store->Values, Store->Capacity*sizeof(word));
+    memcpy(New.Starts, Store->Starts, Store->Capacity*sizeof(word));
+    memcpy(New.Lengths, Store->Lengths, Store->Capacity);
+    if (Unresolved != NULL) memcpy(Unresolved, UnresolvedElements, UnresolvedCount*sizeof(word));
+    }
+  if (Unresolved != NULL) UnresolvedElements = Unresolved;
+  *Store = New;
+  return(ecS);
+}
+
+/*------------------------------------------------------------------------------*/
+
 TErrorCode tokenizer::EnterElement(TElementType ElementType, word Value, bool IsEnd)
-/*Enter element record into list.*/
+/*Enter element record into list, growing the list if it's full.*/
 {
+  TErrorCode  Result;
+
   if (IsEnd) if (EndEntered) return(ecS); else ElementType = etEnd;
-  if (ElementListIdx == ElementListSize) return(ElementError(False, ecTME));
+  if ( (ElementListIdx == ElementList->Capacity) && (Result = GrowElements(ElementList)) ) return(Result);
   /*Enter Element into list*/
-  ElementList[ElementListIdx].ElementType = ElementType;
-  ElementList[ElementListIdx].Value = Value;
-  ElementList[ElementListIdx].Start = StartOfSymbol;
-  ElementList[ElementListIdx].Length = SrcIdx-StartOfSymbol;
+  ElementList->Types[ElementListIdx] = ElementType;
+  ElementList->Values[ElementListIdx] = Value;
+  ElementList->Starts[ElementListIdx] = StartOfSymbol;
+  ElementList->Lengths[ElementListIdx] = SrcIdx-StartOfSymbol;
   ElementListIdx++;
+  CountStat(Elements, 1);
   /*Set End-Record-Entered flag appropriately to avoid two EndRecords next to each other*/
   EndEntered = IsEnd;  /*Set false so as not to skip adjacent End if Comma appeared previously*/
   return(ecS); /*Return success*/
@@ -1851,7 +3049,7 @@ TErrorCode tokenizer::EnterElement(TElementType ElementType, word Value, bool Is
 void tokenizer::SkipToEnd(void)
 /*Skip to beginning of next line*/
 {
-  while (tzSource[SrcIdx] != ETX) SrcIdx++;
+  SrcIdx = SourceScanner().FindChar(tzSource, SrcIdx, MaxSourceSize, ETX);
   SrcIdx++;
 }
 
@@ -1868,6 +3066,8 @@ TErrorCode tokenizer::GetString(void)
     { /*while not at end of string...*/
     if (tzSource[SrcIdx] == ETX) return(ElementError(False, ecETQ)); /*If unterminated string, error*/
     Value = tzSource[SrcIdx];                                        /*Get character*/
+    if ((Value == '\'') && SinglePass)                               /*Apostrophe begins a comment as far as the directive scan is concerned*/
+      if ((Result = ElementizeDirective(SrcIdx))) return(Result);
     SrcIdx++;
     if ((Result = EnterElement(etConstant,Value,False))) return(Result);          /*Enter character as etConstant element*/
     if (tzSource[SrcIdx] != '"')
@@ -1934,10 +3134,11 @@ TErrorCode tokenizer::GetNumber(TBase Base, byte DPDigits, word *Result)
 
 TErrorCode tokenizer::GetSymbol(void)
 /*Retrieve symbol, check if in symbol table and enter element record for it.
-    Default (no symbol found in table) -> Element Type = etUndef, Value = 0
+    Default (no symbol found in table) -> Element Type = etUndef, Value = Name's record in NameTable (see InternName)
     Otherwise (symbol is in table)     -> Element Type = Symbol's Type, Value = Symbol's value*/
 {
   int         Count;
+  word        Value;
   TErrorCode  Result;
 
   Count = SymbolSize;
@@ -1952,10 +3153,17 @@ TErrorCode tokenizer::GetSymbol(void)
     }
   if (Count == 0) return(ElementError(False, ecSETC));            /*If greater than SymbolSize, Error*/
   FindSymbol(&Symbol); /*Retrieve type and value from symbol table (if it already exists)*/
-  if ((Result = EnterElement(Symbol.ElementType,Symbol.Value,False))) return(Result);
-  if ( ((Symbol.ElementType == etData) || (Symbol.ElementType == etVar) || (Symbol.ElementType == etCon) || (Symbol.ElementType == etPin) ) && (ElementListIdx-2 > -1) && (ElementList[ElementListIdx-2].ElementType == etUndef) )
+  Value = Symbol.Value;
+  if (Symbol.ElementType == etUndef) Value = (Symbol.Name[0] == '$' ? UninternedName : InternName(Symbol.Name)); /*Intern name (unless hex value)*/
+  if ((Result = EnterElement(Symbol.ElementType,Value,False))) return(Result);
+  if (SinglePass)
+    { /*Target module isn't known yet; leave reserved words of other targets, and undefined symbol entries, for ResolveElements*/
+    if ((Symbol.ElementType == etUndef) && IsReservedWord(Symbol.Name)) UnresolvedElements[UnresolvedCount++] = ElementListIdx-1;
+    return(ecS);
+    }
+  if ( ((Symbol.ElementType == etData) || (Symbol.ElementType == etVar) || (Symbol.ElementType == etCon) || (Symbol.ElementType == etPin) ) && (ElementListIdx-2 > -1) && (ElementList->Types[ElementListIdx-2] == etUndef) )
     { /*Found DATA, VAR, CON or PIN directive with undefined symbol before it, store previous symbol in Undefined Symbol Table for distinguishing between a un-DEFINE'd symbol and these types*/
-    GetSymbolName(ElementList[ElementListIdx-2].Start,ElementList[ElementListIdx-2].Length);
+    GetSymbolName(ElementList->Starts[ElementListIdx-2],ElementList->Lengths[ElementListIdx-2]);
     if ((Result = EnterUndefSymbol(&Symbol.Name[0]))) return(Result);
     }
   return(ecS); /*Return success*/
@@ -2053,125 +3261,758 @@ TErrorCode tokenizer::GetDirective(void)
 
 /*------------------------------------------------------------------------------*/
 
-TErrorCode tokenizer::Elementize(bool LastPass)
-/*Elementize source (parse source items into elements array).
- If LastPass = False, we elementize editor directives: $STAMP, $PORT, etc
- If LastPass = True,  we elementize entire source code, excluding editor directives*/
+TErrorCode tokenizer::GetSourceElement(void)
+/*Elementize the source item beginning with CurChar (at StartOfSymbol).  Editor directives are treated as comments.*/
 {
-  #define IsNotSourceChar(C)     ( ( ((C) >= 0) && ((C) <= 8) ) ||     /* Null - Backspace */ \
-                                   ( ((C) >= 10) && ((C) <= 31) ) )    /* LineFeed - Unit Separator */
   #define IsSymbolStartChar(C)   ( ((C) == '_') ||                     /* _    */ \
                                  ( ((C) >= 'A') && ((C) <= 'Z') ) ||   /* A..Z */ \
                                  ( ((C) >= 'a') && ((C) <= 'z') ) )    /* a..z */
 
   TErrorCode  Result;
-  word        Number;
+  word        Number;
+
+  switch (CurChar)
+    {
+    /*End Of Line*/       case ETX              : if((Result = EnterElement(ElementType,0,True))) return(Result); break;  /*Hard-End*/
+    /*Null,Tab or Space*/ case 0:
+                          case 9:
+                          case 32               : break; /*do nothing, skip it*/
+    /*Comma*/             case ','              : if((Result = EnterElement(etComma,0,False))) return(Result); /*Comma, may be multi-line list*/
+                                                  EndEntered = Lang250;                                      /*if PBASIC version 2.5, skip End if it appears next*/
+                                                  LangSensitive = True;
+                                                  break;
+    /*Colon*/             case ':'              : EndEntered = False;
+                                                  if((Result = EnterElement(ElementType,1,True))) return(Result);         /*Soft-End*/
+                                                  break;
+    /*Remark*/            case '\''             : if((Result = EnterElement(ElementType,0,True))) return(Result);
+                                                  if (SinglePass) if ((Result = ElementizeDirective(StartOfSymbol))) return(Result);
+                                                  SkipToEnd(); /*Skip to beginning of next line*/
+                                                  break;
+    /*String?*/           case '"'              : if ((Result = GetString())) return(Result); break;
+    /*Binary*/            case '%'              : if ((Result = GetNumber(bBinary,0,&Number))) return(Result);
+                                                  if ((Result = EnterElement(etConstant,Number,False))) return(Result);
+                                                  break;
+    /*Dir or Hex*/        case '$'              : if ((Result = GetSymbol())) return(Result);  /*Directive or Hex value. Look for Directive first.*/
+                                                  if ( !(Lang250) || (Symbol.ElementType == etUndef) )
+                                                    {                                /*Not PBASIC 2.5 or Directive?...*/
+                                                    ElementListIdx--;                /*Remove invalid Element*/
+                                                    SrcIdx = StartOfSymbol+1;        /*Back up and get Hex value*/
+                                                    if ((Result = GetNumber(bHexadecimal,0,&Number))) return(Result);
+                                                    if ((Result = EnterElement(etConstant,Number,False))) return(Result);
+                                                    }
+                                                  else                                 /*Directive symbol; its value is set by CompileEditorDirectives*/
+                                                    if (SinglePass) UnresolvedElements[UnresolvedCount++] = ElementListIdx-1;
+                                                  LangSensitive = True;
+                                                  break;
+    /*Decimal*/           case '0':case '1':case '2':case '3':case '4':
+                          case '5':case '6':case '7':case '8':case '9':
+                                                  if ((Result = GetNumber(bDecimal,0,&Number))) return(Result);
+                                                  if ((Result = EnterElement(etConstant,Number,False))) return(Result);
+                                                  break;
+    /*Cond-Comp Dir?*/    case '#'              : LangSensitive = True;
+                                                  if (!Lang250) return(ElementError(False,ecUC)); /*Conditional-Compile directive?  Not PBASIC 2.5?, Error, unrecognized character*/
+                                                  if ((Result = GetSymbol())) return(Result);
+                                                  /*Error if not directive (in a single pass, directives aren't known until ResolveElements)*/
+                                                  if ( (Symbol.ElementType == etUndef) && !(SinglePass && IsReservedWord(Symbol.Name)) ) return(ElementError(False,ecED));
+                                                  break;
+    /*Symbol char or*/    default :
+    /*other char*/        if (IsSymbolStartChar(CurChar))
+                            {
+                            if ((Result = GetSymbol())) return(Result);
+                            }
+    /*could be operator*/else  /*Operator? Could be 1 or 2 characters*/
+                           {
+                           Symbol.Name[0] = CurChar;                                /*Save first character*/
+                           Symbol.Name[1] = 0;  /*! Need this?*/
+                           Symbol.Name[2] = 0;  /*! Need this?*/
+                           while ((tzSource[SrcIdx] == 9) || \
+                                  (tzSource[SrcIdx] == 32)) SrcIdx++;    /*Skip any tabs or spaces*/
+                           if (tzSource[SrcIdx] > 0)                     /*If not nil, save second character*/
+                             {
+                             Symbol.Name[1] = tzSource[SrcIdx];
+                             SrcIdx++;
+                             if (FindSymbol(&Symbol))                               /*See if valid 2-character operator*/
+                               {
+                               if ((Result = EnterElement(Symbol.ElementType,Symbol.Value,False))) return(Result);
+                               }
+                             else
+                               {                                                    /*Not valid operator... prepare to*/
+                               SrcIdx = StartOfSymbol+1;                            /*search for 1 character operator*/
+                               Symbol.Name[1] = 0;
+                               }
+                             }
+                           if (strlen(Symbol.Name) < 2)                             /*If operator not 2-characters,*/
+                             if (FindSymbol(&Symbol))                               /*See if valid 1-character operator*/
+                               {
+                               if ((Result = EnterElement(Symbol.ElementType,Symbol.Value,False))) return(Result);
+                               }
+                             else
+                               return(ElementError(False, ecUC));    /*Error, unrecognized character*/
+                           }
+    } /*Switch*/
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::ElementizeDirective(int Position)
+/*Elementize the comment starting at Position into DirectiveElements, exactly as Elementize(epDirectives) would, unless
+  the directive scan has already skipped past Position (it may skip a whole line after an empty comment).  Called by a
+  single-pass Elementize for each apostrophe in the source.  A $PBASIC directive sets Lang250 for the rest of the pass.*/
+{
+  TErrorCode  Result;
+  int         Idx;
+  int         SourceSrcIdx;
+  word        SourceStartOfSymbol;
+  byte        SourceCurChar;
+  word        SourceElementListIdx;
+  bool        SourceEndEntered;
+
+  if (LexCache != NULL) CacheComment(Position);
+  if (Position < DirectiveResume) return(ecS);
+  /*Save source element state and switch to directive element state*/
+  SourceSrcIdx = SrcIdx;
+  SourceStartOfSymbol = StartOfSymbol;
+  SourceCurChar = CurChar;
+  SourceElementListIdx = ElementListIdx;
+  SourceEndEntered = EndEntered;
+  ElementList = &DirectiveElements;
+  ElementListIdx = DirectiveElementsEnd;
+  EndEntered = DirectiveEndEntered;
+  SinglePass = False;
+  StartOfSymbol = Position;
+  CurChar = tzSource[Position];
+  SrcIdx = Position+1;
+  /*Check comment for editor directive*/
+  if (!(Result = EnterElement(ElementType,0,True))) Result = GetDirective();
+  if (Result)
+    {
+    DirectiveFailed = True;
+    return(Result);
+    }
+  for (Idx = DirectiveElementsEnd; Idx+1 < ElementListIdx; Idx++)
+    if ( (ElementList->Types[Idx] == etDirective) && (ElementList->Values[Idx] == dtPBasic) && (ElementList->Types[Idx+1] == etConstant) && (Lang250 != (ElementList->Values[Idx+1] == 250)) )
+      { /*Language version changes, if we've already elementized anything that depends on it, ResolveElements must elementize again*/
+      Relex = Relex || LangSensitive;
+      Lang250 = !Lang250;
+      }
+  /*Save directive element state and switch back to source element state*/
+  DirectiveElementsEnd = ElementListIdx;
+  DirectiveEndEntered = EndEntered;
+  DirectiveStartOfSymbol = StartOfSymbol;
+  DirectiveResume = SrcIdx;
+  ElementList = &SourceElements;
+  ElementListIdx = SourceElementListIdx;
+  EndEntered = SourceEndEntered;
+  SinglePass = True;
+  StartOfSymbol = SourceStartOfSymbol;
+  CurChar = SourceCurChar;
+  SrcIdx = SourceSrcIdx;
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::EndElements(void)
+/*Enter final End element into ElementList (and one after a trailing comma, if necessary) and set ElementListEnd.*/
+{
+  TErrorCode  Result;
+
+  if ( (EndEntered) && (ElementListIdx-1 >= 0) && (ElementList->Types[ElementListIdx-1] != etEnd) )
+    { /*Last element may have been a comma, adjust pointers and enter End*/
+    StartOfSymbol = ElementList->Starts[ElementListIdx-1]+ElementList->Lengths[ElementListIdx-1]+1;
+    SrcIdx = StartOfSymbol+1;
+    EndEntered = False;
+    if ((Result = EnterElement(ElementType,0,True))) return(Result);
+    }
+  /*Enter final End element*/
+  if ((Result = EnterElement(ElementType,0,True))) return(Result);
+  ElementListEnd = ElementListIdx;
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::Elementize(TElementizePass Pass)
+/*Elementize source (parse source items into elements array).
+ If Pass = epDirectives, we elementize editor directives: $STAMP, $PORT, etc
+ If Pass = epSource,     we elementize entire source code, excluding editor directives
+ If Pass = epAll,        we do both in a single scan of the source; source elements go to SourceElements and editor
+                         directive elements to DirectiveElements, which is left as the ElementList for
+                         CompileEditorDirectives.  Elements that depend on the target module, and any error in the
+                         source (reported only after errors in editor directives), are left for ResolveElements.*/
+{
+  TErrorCode  Result;
+  int         Idx;
+  bool        LineStart;
+  const TSourceScanner &Scanner = SourceScanner();
+
+  /*If there is source to parse, convert all chars besides 0 (Null), 9 (Tab) and 32 - 126 (' ' to '~') to 3 (ETX).  For
+    CompileView, that's done while copying the source into WorkSource.*/
+  if ((tzModuleRec->SourceSize > 0) && (Pass != epSource))
+    Scanner.Sanitize(tzSource, (tzViewSource != NULL ? tzViewSource : tzSource), tzModuleRec->SourceSize);
+	tzSource[tzModuleRec->SourceSize] = ETX;     /*Terminate source with ETX (End of Text)*/
+  SrcIdx = 0;                                  /*Set index back to source start*/
+  if (Pass != epSource) ResetElements();       /*Start a new compile's element lists (epSource keeps DirectiveElements)*/
+  ElementList = &SourceElements;               /*Init Element List, Element List Pointer and Element List End Pointer*/
+  ElementListIdx = 0;
+  ElementListEnd = 0;
+  EndEntered = True;                           /*Initialize End-Record-Entered flag*/
+  SinglePass = (Pass == epAll);
+  if (SinglePass)
+    { /*Initialize directive element state and results held for ResolveElements*/
+    DirectiveElementsEnd = 0;
+    DirectiveEndEntered = True;
+    DirectiveResume = 0;
+    DirectiveFailed = False;
+    UnresolvedCount = 0;
+    LangSensitive = False;
+    Relex = False;
+    }
+  LexCache = NULL;
+  if ( (Incremental != NULL) && SinglePass )
+    { /*Compiling incrementally, record elements by line and reuse those of unchanged lines*/
+    Incremental->Recorded = False;
+    Incremental->Unchanged = False;
+    BeginElementCache();
+    }
+  LineStart = True;
+  /*Next Element*/
+  Result = ecS;
+  while ((SrcIdx < tzModuleRec->SourceSize) && (!Result))
+    {
+    if ( (LexCache != NULL) && LineStart )
+      {
+      if ( (Result = ReuseLines()) || (SrcIdx >= tzModuleRec->SourceSize) ) break;
+      if (LexCache != NULL) OpenLexedLine();
+      LineStart = False;
+      }
+    /*Skip ahead to the last of a run of blanks (or, for directives only, the last char before a comment) so it's read as usual*/
+    if (Pass != epDirectives)
+      {
+      if (IsBlankChar(tzSource[SrcIdx]) && IsBlankChar(tzSource[SrcIdx+1]))
+        SrcIdx = Scanner.SkipBlanks(tzSource, SrcIdx+2, tzModuleRec->SourceSize) - 1;
+      }
+    else
+      if ((SrcIdx+1 < tzModuleRec->SourceSize) && (tzSource[SrcIdx] != '\'') && (tzSource[SrcIdx+1] != '\''))
+        SrcIdx = Scanner.FindChar(tzSource, SrcIdx+2, tzModuleRec->SourceSize, '\'') - 1;
+    /*Skip*/
+    StartOfSymbol = SrcIdx;
+    CurChar = tzSource[SrcIdx];
+    SrcIdx++;
+    if (Pass != epDirectives) /*Elementize all source, excluding editor directives*/
+      Result = GetSourceElement();
+    else /*Elementize editor directives only*/
+      if (CurChar == '\'')
+        { /*Check comment lines for editor directives*/
+        if (!(Result = EnterElement(ElementType,0,True))) Result = GetDirective();
+        }
+    if ( (LexCache != NULL) && (!Result) && ((CurChar == ETX) || (CurChar == '\'')) && (tzSource[SrcIdx-1] == ETX) )
+      { /*End of line, once its ETX is read rather than just looked at (a comment skips to the start of the next)*/
+      CloseLexedLine();
+      LineStart = True;
+      }
+    } /*While SrcIdx < tzModuleRec->SourceSize*/
+  if (!Result) Result = EndElements();
+  if (!SinglePass) return(Result);
+  /*Single pass; an error in editor directives is reported now, an error in source is held until they've been compiled*/
+  SinglePass = False;
+  if (DirectiveFailed)
+    {
+    LexCache = NULL;
+    return(Result);
+    }
+  SourceElementsEnd = (Result ? ElementListIdx : ElementListEnd);
+  DeferredError = Result;
+  DeferredErrorStart = tzModuleRec->ErrorStart;
+  DeferredErrorLength = tzModuleRec->ErrorLength;
+  if (Result)
+    { /*Source elementizing stopped early, finish scanning for editor directives*/
+    Idx = Scanner.FindChar(tzSource, DirectiveResume, tzModuleRec->SourceSize, '\'');
+    while (Idx < tzModuleRec->SourceSize)
+      {
+      if ((Result = ElementizeDirective(Idx)))
+        {
+        LexCache = NULL;
+        return(Result);
+        }
+      Idx = Scanner.FindChar(tzSource, DirectiveResume, tzModuleRec->SourceSize, '\'');
+      }
+    }
+  /*Finish directive elements, as Elementize(epDirectives) would have at the end of the source*/
+  ElementList = &DirectiveElements;
+  ElementListIdx = DirectiveElementsEnd;
+  EndEntered = DirectiveEndEntered;
+  if (DirectiveResume < tzModuleRec->SourceSize)
+    {
+    StartOfSymbol = tzModuleRec->SourceSize-1;
+    SrcIdx = tzModuleRec->SourceSize;
+    }
+  else
+    if (tzModuleRec->SourceSize > 0)
+      {
+      StartOfSymbol = DirectiveStartOfSymbol;
+      SrcIdx = DirectiveResume;
+      }
+  ElementizedLang250 = Lang250;
+  Lang250 = False;
+  Result = EndElements();
+  if (LexCache != NULL)
+    { /*Recording; drop the recording if it failed, otherwise finish it*/
+    if (Result) LexCache = NULL; else EndElementCache();
+    }
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void *tokenizer::GrowCacheArray(void *Array, int *Capacity, int Count, size_t Size)
+/*Return element cache Array, of Capacity items of Size bytes, grown (doubling) to hold at least Count items, updating
+  Capacity.  Returns NULL, leaving Array alone, if out of memory.*/
+{
+  int   NewCapacity;
+
+  if (Count <= *Capacity) return(Array);
+  NewCapacity = (*Capacity == 0 ? ElementListGrowth : *Capacity);
+  while (NewCapacity < Count) NewCapacity *= 2;
+  if ((Array = realloc(Array, NewCapacity*Size)) == NULL) return(NULL);
+  *Capacity = NewCapacity;
+  return(Array);
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::CacheElements(TElementStore *Cache, const TElementStore *Store, int Count)
+/*Copy the first Count elements of Store into element cache store Cache, growing it as needed.  Returns False if out of
+  memory.*/
+{
+  int   Capacity;
+  void  *Array;
+
+  if (Count > Cache->Capacity)
+    {
+    Capacity = (Cache->Capacity == 0 ? ElementListGrowth : Cache->Capacity);
+    while (Capacity < Count) Capacity *= 2;
+    if ((Array = realloc(Cache->Types, Capacity)) == NULL) return(False);
+    Cache->Types = (byte *) Array;
+    if ((Array = realloc(Cache->Values, Capacity*sizeof(word))) == NULL) return(False);
+    Cache->Values = (word *) Array;
+    if ((Array = realloc(Cache->Starts, Capacity*sizeof(word))) == NULL) return(False);
+    Cache->Starts = (word *) Array;
+    if ((Array = realloc(Cache->Lengths, Capacity)) == NULL) return(False);
+    Cache->Lengths = (byte *) Array;
+    Cache->Capacity = Capacity;
+    }
+  if (Count > 0)
+    {
+    memcpy(Cache->Types, Store->Types, Count);
+    memcpy(Cache->Values, Store->Values, Count*sizeof(word));
+    memcpy(Cache->Starts, Store->Starts, Count*sizeof(word));
+    memcpy(Cache->Lengths, Store->Lengths, Count);
+    }
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::FreeElementCache(TElementCache *Cache)
+/*Free the storage of an element cache*/
+{
+  free(Cache->Source);
+  free(Cache->Elements.Types);
+  free(Cache->Elements.Values);
+  free(Cache->Elements.Starts);
+  free(Cache->Elements.Lengths);
+  free(Cache->Unresolved);
+  free(Cache->Directives.Types);
+  free(Cache->Directives.Values);
+  free(Cache->Directives.Starts);
+  free(Cache->Directives.Lengths);
+  free(Cache->Comments);
+  free(Cache->Lines);
+  memset(Cache, 0, sizeof(TElementCache));
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::BeginElementCache(void)
+/*Start recording a single-pass Elementize in the element cache that doesn't hold the last compile's, and find how much
+  of the source, from its start and from its end, is the same as the last compile's.*/
+{
+  TElementCache *Old;
+  int            Limit;
+  int            Suffix;
+
+  Old = &Incremental->Caches[Incremental->Current];
+  LexCache = &Incremental->Caches[1-Incremental->Current];
+  LexCache->Valid = False;
+  LexCache->SourceSize = tzModuleRec->SourceSize;
+  memcpy(LexCache->Source, tzSource, LexCache->SourceSize);
+  LexCache->ElementCount = 0;
+  LexCache->UnresolvedCount = 0;
+  LexCache->DirectiveCount = 0;
+  LexCache->CommentCount = 0;
+  LexCache->LineCount = 0;
+  LexLine = 0;
+  Limit = (Old->Valid ? Lowest(Old->SourceSize, LexCache->SourceSize) : 0);
+  Incremental->Prefix = CommonPrefix(Old->Source, LexCache->Source, Limit);
+  Suffix = CommonSuffix(Old->Source+Old->SourceSize, LexCache->Source+LexCache->SourceSize, Limit-Incremental->Prefix);
+  Incremental->OldSuffix = Old->SourceSize-Suffix;
+  Incremental->NewSuffix = LexCache->SourceSize-Suffix;
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::OpenLexedLine(void)
+/*Start recording the line beginning at SrcIdx in the element cache.  Stops recording (and returns False) if out of
+  memory.*/
+{
+  TLexedLine  *Lines;
+  TLexedLine  *Line;
+
+  if ((Lines = (TLexedLine *) GrowCacheArray(LexCache->Lines, &LexCache->LineCapacity, LexCache->LineCount+1, sizeof(TLexedLine))) == NULL)
+    {
+    LexCache = NULL;
+    return(False);
+    }
+  LexCache->Lines = Lines;
+  Line = &Lines[LexCache->LineCount];
+  Line->Start = SrcIdx;
+  Line->FirstElement = ElementListIdx;
+  Line->FirstUnresolved = UnresolvedCount;
+  Line->FirstComment = LexCache->CommentCount;
+  Line->EntryEndEntered = EndEntered;
+  Line->EntryLangSensitive = LangSensitive;
+  Line->Lang250 = Lang250;
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::CloseLexedLine(void)
+/*Finish recording the line, ending at SrcIdx-1, opened by OpenLexedLine.  The directive scan may change Lang250 at an
+  apostrophe, so the line is only reusable if that could only have been at its end.*/
+{
+  TLexedLine  *Line;
+  int         Idx;
+
+  Line = &LexCache->Lines[LexCache->LineCount++];
+  Line->End = SrcIdx-1;
+  Line->Tail = StartOfSymbol;
+  Line->EndElement = ElementListIdx;
+  Line->EndUnresolved = UnresolvedCount;
+  Line->EndComment = LexCache->CommentCount;
+  Line->ExitEndEntered = EndEntered;
+  Line->ExitLangSensitive = LangSensitive;
+  Line->Reusable = True;
+  for (Idx = Line->FirstComment; Idx < Line->EndComment; Idx++)
+    if (LexCache->Comments[Idx] != Line->Tail) Line->Reusable = False;
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::CacheComment(int Position)
+/*Note, in the element cache, that the apostrophe at Position was passed to ElementizeDirective.  Stops recording if out
+  of memory.*/
+{
+  int  *Comments;
+
+  if ((Comments = (int *) GrowCacheArray(LexCache->Comments, &LexCache->CommentCapacity, LexCache->CommentCount+1, sizeof(int))) == NULL)
+    {
+    LexCache = NULL;
+    return;
+    }
+  LexCache->Comments = Comments;
+  Comments[LexCache->CommentCount++] = Position;
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::ReuseLines(void)
+/*At the start of a line, copy the elements of it and the lines that follow from the last compile's element cache, for
+  as long as they can be: each must lie wholly before or wholly after the edited part of the source, start with the same
+  element state and be reusable (see CloseLexedLine).  Their comments are passed to ElementizeDirective as before.
+  Leaves SrcIdx at the start of the next line to elementize.*/
+{
+  TElementCache *Old;
+  TLexedLine    *Line;
+  TErrorCode     Result;
+  int            OldStart;
+  int            Shift;
+  int            Count;
+  int            Idx;
+  word           First;
+
+  Old = &Incremental->Caches[Incremental->Current];
+  if (!Old->Valid) return(ecS);
+  while (SrcIdx < tzModuleRec->SourceSize)
+    {
+    /*Find the last compile's line that started here*/
+    if (SrcIdx < Incremental->Prefix)
+      OldStart = SrcIdx;
+    else
+      if (SrcIdx >= Incremental->NewSuffix) OldStart = SrcIdx-Incremental->NewSuffix+Incremental->OldSuffix; else return(ecS);
+    while ( (LexLine < Old->LineCount) && (Old->Lines[LexLine].Start < OldStart) ) LexLine++;
+    if (LexLine == Old->LineCount) return(ecS);
+    Line = &Old->Lines[LexLine];
+    Count = Line->EndElement-Line->FirstElement;
+    if ( (Line->Start != OldStart) || ((OldStart < Incremental->Prefix) && (Line->End >= Incremental->Prefix)) || !(Line->Reusable) ||
+         (Line->EntryEndEntered != EndEntered) || (Line->EntryLangSensitive != LangSensitive) || (Line->Lang250 != Lang250) ||
+         (ElementListIdx+Count > ElementListSize) ) return(ecS);
+    /*Copy its elements, moved along with the source*/
+    if (!OpenLexedLine()) return(ecS);
+    while (ElementListIdx+Count > SourceElements.Capacity)
+      if ((Result = GrowElements(&SourceElements))) return(Result);
+    Shift = SrcIdx-OldStart;
+    First = ElementListIdx;
+    if (Count > 0)
+      {
+      memcpy(&SourceElements.Types[First], &Old->Elements.Types[Line->FirstElement], Count);
+      memcpy(&SourceElements.Values[First], &Old->Elements.Values[Line->FirstElement], Count*sizeof(word));
+      memcpy(&SourceElements.Lengths[First], &Old->Elements.Lengths[Line->FirstElement], Count);
+      for (Idx = 0; Idx < Count; Idx++) SourceElements.Starts[First+Idx] = Old->Elements.Starts[Line->FirstElement+Idx]+Shift;
+      }
+    for (Idx = Line->FirstUnresolved; Idx < Line->EndUnresolved; Idx++) UnresolvedElements[UnresolvedCount++] = Old->Unresolved[Idx]-Line->FirstElement+First;
+    ElementListIdx += Count;
+    EndEntered = Line->ExitEndEntered;
+    LangSensitive = Line->ExitLangSensitive;
+    /*Leave element state as at the end of the line, then let the directive scan see its comment*/
+    StartOfSymbol = Line->Tail+Shift;
+    CurChar = tzSource[StartOfSymbol];
+    SrcIdx = Line->End+Shift+1;
+    for (Idx = Line->FirstComment; Idx < Line->EndComment; Idx++)
+      if ((Result = ElementizeDirective(Old->Comments[Idx]+Shift))) return(Result);
+    if (LexCache != NULL) CloseLexedLine();
+    CountStat(ReusedLines, 1);
+    CountStat(ReusedElements, Count);
+    LexLine++;
+    if (LexCache == NULL) return(ecS);
+    }
+  return(ecS);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::EndElementCache(void)
+/*Finish recording a successful single-pass Elementize in the element cache, note whether it elementized to the same as
+  the last compile (if that one's results are still good) and make it the last compile's cache.*/
+{
+  TElementCache *Cache;
+  word          *Unresolved;
+
+  Cache = LexCache;
+  LexCache = NULL;
+  if ( !CacheElements(&Cache->Elements, &SourceElements, SourceElementsEnd) || !CacheElements(&Cache->Directives, &DirectiveElements, ElementListEnd) ) return;
+  if (UnresolvedCount > 0)
+    {
+    if ((Unresolved = (word *) GrowCacheArray(Cache->Unresolved, &Cache->UnresolvedCapacity, UnresolvedCount, sizeof(word))) == NULL) return;
+    Cache->Unresolved = Unresolved;
+    memcpy(Cache->Unresolved, UnresolvedElements, UnresolvedCount*sizeof(word));
+    }
+  Cache->ElementCount = SourceElementsEnd;
+  Cache->UnresolvedCount = UnresolvedCount;
+  Cache->DirectiveCount = ElementListEnd;
+  Cache->DeferredError = DeferredError;
+  Cache->DeferredErrorStart = DeferredErrorStart;
+  Cache->DeferredErrorLength = DeferredErrorLength;
+  Cache->ElementizedLang250 = ElementizedLang250;
+  Cache->Relex = Relex;
+  Cache->Valid = True;
+  Incremental->Unchanged = Incremental->ResultsValid && SameElementCaches(&Incremental->Caches[Incremental->Current], Cache);
+  Incremental->ResultsValid = False;
+  Incremental->Current = 1-Incremental->Current;
+  Incremental->Recorded = True;
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::SameElementCaches(const TElementCache *Old, const TElementCache *New)
+/*Return True if New holds the same source and directive elements as Old, but for the positions of those after the
+  edited part of the source, and the same held error, and neither had to be elementized again by ResolveElements.*/
+{
+  if ( !(Old->Valid) || (Old->ElementCount != New->ElementCount) || (Old->DirectiveCount != New->DirectiveCount) ||
+       (Old->UnresolvedCount != New->UnresolvedCount) || (Old->ElementizedLang250 != New->ElementizedLang250) || Old->Relex || New->Relex ||
+       (Old->DeferredError != New->DeferredError) ) return(False);
+  if ( (Old->DeferredError) && ((MapPosition(Old->DeferredErrorStart) != New->DeferredErrorStart) || (Old->DeferredErrorLength != New->DeferredErrorLength)) ) return(False);
+  if ( (Old->UnresolvedCount > 0) && (memcmp(Old->Unresolved, New->Unresolved, Old->UnresolvedCount*sizeof(word)) != 0) ) return(False);
+  return(SameElements(&Old->Elements, &New->Elements, Old->ElementCount) && SameElements(&Old->Directives, &New->Directives, Old->DirectiveCount));
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::SameElements(const TElementStore *Old, const TElementStore *New, int Count)
+/*Return True if the first Count elements of Old and New are the same, but for position (see MapPosition)*/
+{
+  int  Idx;
+
+  if (Count == 0) return(True);
+  if ( (memcmp(Old->Types, New->Types, Count) != 0) || (memcmp(Old->Values, New->Values, Count*sizeof(word)) != 0) ||
+       (memcmp(Old->Lengths, New->Lengths, Count) != 0) ) return(False);
+  for (Idx = 0; Idx < Count; Idx++)
+    if (MapPosition(Old->Starts[Idx]) != New->Starts[Idx]) return(False);
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+int tokenizer::MapPosition(int Position)
+/*Return where source index Position of the last incremental compile is in this one, or -1 if it was in the edited part
+  of the source.*/
+{
+  if (Position < Incremental->Prefix) return(Position);
+  if (Position >= Incremental->OldSuffix) return(Position-Incremental->OldSuffix+Incremental->NewSuffix);
+  return(-1);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::SanitizeLines(int Idx, int *SanitizedEnd)
+/*Make sure WorkSource holds CompileView's source sanitized (as by Elementize) from Idx through the end of the line after
+  the one containing Idx.  WorkSource[0..SanitizedEnd-1] is already sanitized; more is done a block at a time.*/
+{
+  #define SanitizeBlockSize    4096
+
+  int   Lines;
+  int   Size;
+  const TSourceScanner &Scanner = SourceScanner();
+
+  Lines = 0;
+  while (True)
+    {
+    /*Count line ends already sanitized*/
+    while ( (Lines < 2) && ((Idx = Scanner.FindChar(tzSource, Idx, *SanitizedEnd, ETX)) < *SanitizedEnd) )
+      {
+      Lines++;
+      Idx++;
+      }
+    if ((Lines == 2) || (*SanitizedEnd >= tzModuleRec->SourceSize)) return;
+    /*Sanitize next block*/
+    Size = (Idx > *SanitizedEnd ? Idx : *SanitizedEnd) + SanitizeBlockSize;
+    Size = (Size < tzModuleRec->SourceSize ? Size : tzModuleRec->SourceSize) - *SanitizedEnd;
+    Scanner.Sanitize(&tzSource[*SanitizedEnd], &tzViewSource[*SanitizedEnd], Size);
+    *SanitizedEnd += Size;
+    }
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::ElementizeHeader(void)
+/*Elementize the editor directives at the head of CompileView's source for ProbeDirectives.  Comments are elementized
+  just as by Elementize(epDirectives), but the source is only sanitized as far as we read, and we stop as soon as $STAMP,
+  $PORT and $PBASIC have all been found, or at the first line of code once $STAMP and $PBASIC have been found.*/
+{
+  TErrorCode  Result;
+  int         SanitizedEnd;
+  int         Idx;
+  word        First;
+  byte        Found;
+  bool        Stopped;
+  bool        AfterDirective;
+  bool        SymbolsReady;
+  const TSourceScanner &Scanner = SourceScanner();
+
+  tzSource[tzModuleRec->SourceSize] = ETX;     /*Terminate source with ETX (End of Text)*/
+  ResetElements();
+  ElementList = &SourceElements;               /*Init Element List, Element List Pointer and Element List End Pointer*/
+  ElementListIdx = 0;
+  ElementListEnd = 0;
+  EndEntered = True;                           /*Initialize End-Record-Entered flag*/
+  SinglePass = False;
+  StartOfSymbol = 0;
+  SanitizedEnd = 0;
+  Found = 0;
+  Stopped = False;
+  AfterDirective = False;
+  SymbolsReady = False;
+  Idx = 0;
+  while ((Idx < tzModuleRec->SourceSize) && (!Stopped))
+    {
+    /*Idx is at the start of a line; is it blank, a comment or code?*/
+    AfterDirective = False;
+    SanitizeLines(Idx, &SanitizedEnd);
+    Idx = Scanner.SkipBlanks(tzSource, Idx, tzModuleRec->SourceSize);
+    if (Idx >= tzModuleRec->SourceSize) break;
+    if (tzSource[Idx] == ETX) {Idx++; continue;}
+    if (tzSource[Idx] != '\'')
+      { /*Code; stop if we've found $STAMP and $PBASIC, otherwise go on to the next comment*/
+      if ((Found & ((1 << dtStamp) | (1 << dtPBasic))) == ((1 << dtStamp) | (1 << dtPBasic))) {Stopped = True; break;}
+      if ((Idx = Scanner.FindChar(tzViewSource, Idx, tzModuleRec->SourceSize, '\'')) >= tzModuleRec->SourceSize) break;
+      SanitizeLines(Idx, &SanitizedEnd);
+      }
+    /*Check comment for editor directive*/
+    if (!SymbolsReady) {InitSymbols(); SymbolsReady = True;}
+    First = ElementListIdx;
+    StartOfSymbol = Idx;
+    CurChar = '\'';
+    SrcIdx = Idx+1;
+    if ((Result = EnterElement(ElementType,0,True))) return(Result);
+    if ((Result = GetDirective())) return(Result);
+    for (; First < ElementListIdx; First++)
+      if (ElementList->Types[First] == etDirective) Found |= 1 << ElementList->Values[First];
+    Stopped = (Found == ((1 << dtStamp) | (1 << dtPort) | (1 << dtPBasic)));
+    AfterDirective = True;
+    Idx = SrcIdx;
+    }
+  /*Leave StartOfSymbol and SrcIdx for the final End element as Elementize(epDirectives) would (when it reads to the end)*/
+  if (Stopped)
+    SrcIdx = StartOfSymbol = Idx;
+  else
+    if (!AfterDirective)
+      {
+      StartOfSymbol = (tzModuleRec->SourceSize > 0 ? tzModuleRec->SourceSize-1 : 0);
+      SrcIdx = tzModuleRec->SourceSize;
+      }
+  return(EndElements());
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::ResolveElements(void)
+/*Finish elementizing the source after a single-pass Elementize, now that editor directives have been compiled and
+  symbols adjusted for the target module.  Looks up the elements that depend on the target module (and the values of
+  directive symbols), enters undefined DATA, VAR, CON and PIN symbols (see GetSymbol) and reports any error held from
+  the source.  If the language version turned out different than the source was elementized for, the source is
+  elementized again.*/
+{
+  TErrorCode  Result;
+  int         Idx;
+  int         Unresolved;
 
-  /*If there is source to parse, convert all chars besides 0 (Null), 9 (Tab) and 32 - 126 (' ' to '~') to 3 (ETX)*/
-  if ((tzModuleRec->SourceSize > 0) && (!LastPass))
-    for (SrcIdx = 0; SrcIdx < tzModuleRec->SourceSize; SrcIdx++) if (IsNotSourceChar(tzSource[SrcIdx])) tzSource[SrcIdx] = ETX;
-	tzSource[tzModuleRec->SourceSize] = ETX;     /*Terminate source with ETX (End of Text)*/
-  SrcIdx = 0;                                  /*Set index back to source start*/
-  ElementListIdx = 0;                          /*Init Element List Pointer and Element List End Pointer*/
-  ElementListEnd = 0;
-  EndEntered = True;                           /*Initialize End-Record-Entered flag*/
-  /*Next Element*/
-  while (SrcIdx < tzModuleRec->SourceSize)
+  ElementList = &SourceElements;
+  if (Relex || (ElementizedLang250 != Lang250)) return(Elementize(epSource));
+  ElementListEnd = SourceElementsEnd;
+  Unresolved = 0;
+  for (Idx = 0; Idx < ElementListEnd; Idx++)
     {
-    /*Skip*/
-    StartOfSymbol = SrcIdx;
-    CurChar = tzSource[SrcIdx];
-    SrcIdx++;
-    if (LastPass) /*If "last pass" then elementize all source, excluding editor directives*/
-      switch (CurChar)
-        {
-        /*End Of Line*/       case ETX              : if((Result = EnterElement(ElementType,0,True))) return(Result); break;  /*Hard-End*/
-        /*Null,Tab or Space*/ case 0:
-                              case 9:
-                              case 32               : break; /*do nothing, skip it*/
-        /*Comma*/             case ','              : if((Result = EnterElement(etComma,0,False))) return(Result); /*Comma, may be multi-line list*/
-                                                      EndEntered = Lang250;                                      /*if PBASIC version 2.5, skip End if it appears next*/
-                                                      break;
-        /*Colon*/             case ':'              : EndEntered = False;
-                                                      if((Result = EnterElement(ElementType,1,True))) return(Result);         /*Soft-End*/
-                                                      break;
-        /*Remark*/            case '\''             : if((Result = EnterElement(ElementType,0,True))) return(Result);
-                                                      SkipToEnd(); /*Skip to beginning of next line*/
-                                                      break;
-        /*String?*/           case '"'              : if ((Result = GetString())) return(Result); break;
-        /*Binary*/            case '%'              : if ((Result = GetNumber(bBinary,0,&Number))) return(Result);
-                                                      if ((Result = EnterElement(etConstant,Number,False))) return(Result);
-                                                      break;
-        /*Dir or Hex*/        case '$'              : if ((Result = GetSymbol())) return(Result);  /*Directive or Hex value. Look for Directive first.*/
-                                                      if ( !(Lang250) || (Symbol.ElementType == etUndef) )
-                                                        {                                /*Not PBASIC 2.5 or Directive?...*/
-                                                        ElementListIdx--;                /*Remove invalid Element*/
-                                                        SrcIdx = StartOfSymbol+1;        /*Back up and get Hex value*/
-                                                        if ((Result = GetNumber(bHexadecimal,0,&Number))) return(Result);
-                                                        if ((Result = EnterElement(etConstant,Number,False))) return(Result);
-                                                        }
-                                                      break;
-        /*Decimal*/           case '0':case '1':case '2':case '3':case '4':
-                              case '5':case '6':case '7':case '8':case '9':
-                                                      if ((Result = GetNumber(bDecimal,0,&Number))) return(Result);
-                                                      if ((Result = EnterElement(etConstant,Number,False))) return(Result);
-                                                      break;
-        /*Cond-Comp Dir?*/    case '#'              : if (!Lang250) return(ElementError(False,ecUC)); /*Conditional-Compile directive?  Not PBASIC 2.5?, Error, unrecognized character*/
-                                                      if ((Result = GetSymbol())) return(Result);
-                                                      if (Symbol.ElementType == etUndef) return(ElementError(False,ecED));
-                                                      break;
-        /*Symbol char or*/    default :
-        /*other char*/        if (IsSymbolStartChar(CurChar))
-                                {
-                                if ((Result = GetSymbol())) return(Result);
-                                }
-        /*could be operator*/else  /*Operator? Could be 1 or 2 characters*/
-                               {
-                               Symbol.Name[0] = CurChar;                                /*Save first character*/
-                               Symbol.Name[1] = 0;  /*! Need this?*/
-                               Symbol.Name[2] = 0;  /*! Need this?*/
-                               while ((tzSource[SrcIdx] == 9) || \
-                                      (tzSource[SrcIdx] == 32)) SrcIdx++;    /*Skip any tabs or spaces*/
-                               if (tzSource[SrcIdx] > 0)                     /*If not nil, save second character*/
-                                 {
-                                 Symbol.Name[1] = tzSource[SrcIdx];
-                                 SrcIdx++;
-                                 if (FindSymbol(&Symbol))                               /*See if valid 2-character operator*/
-                                   {
-                                   if ((Result = EnterElement(Symbol.ElementType,Symbol.Value,False))) return(Result);
-                                   }
-                                 else
-                                   {                                                    /*Not valid operator... prepare to*/
-                                   SrcIdx = StartOfSymbol+1;                            /*search for 1 character operator*/
-                                   Symbol.Name[1] = 0;
-                                   }
-                                 }
-                               if (strlen(Symbol.Name) < 2)                             /*If operator not 2-characters,*/
-                                 if (FindSymbol(&Symbol))                               /*See if valid 1-character operator*/
-                                   {
-                                   if ((Result = EnterElement(Symbol.ElementType,Symbol.Value,False))) return(Result);
-                                   }
-                                 else
-                                   return(ElementError(False, ecUC));    /*Error, unrecognized character*/
-                               }
-        } /*Switch*/
-    else /*This is the first pass, elementize editor directives only*/
-      if (CurChar == '\'')
-        { /*Check comment lines for editor directives*/
-        if ((Result = EnterElement(ElementType,0,True))) return(Result);
-        if ((Result = GetDirective())) return(Result);
+    if ( (Unresolved < UnresolvedCount) && (UnresolvedElements[Unresolved] == Idx) )
+      { /*Element depends on target module, look it up now*/
+      Unresolved++;
+      GetSymbolName(ElementList->Starts[Idx],ElementList->Lengths[Idx]);
+      if (FindSymbol(&Symbol))
+        { /*Found it (otherwise it keeps its name's record from GetSymbol)*/
+        ElementList->Types[Idx] = Symbol.ElementType;
+        ElementList->Values[Idx] = Symbol.Value;
         }
-    } /*While SrcIdx < tzModuleRec->SourceSize*/
-  if ( (EndEntered) && (ElementListIdx-1 >= 0) && (ElementList[ElementListIdx-1].ElementType != etEnd) )
-    { /*Last element may have been a comma, adjust pointers and enter End*/
-    StartOfSymbol = ElementList[ElementListIdx-1].Start+ElementList[ElementListIdx-1].Length+1;
-    SrcIdx = StartOfSymbol+1;
-    EndEntered = False;
-    if ((Result = EnterElement(ElementType,0,True))) return(Result);
+      if ( (Symbol.ElementType == etUndef) && (tzSource[ElementList->Starts[Idx]] == '#') )
+        { /*Not a conditional-compile directive for this target, Error: Expected Directive*/
+        tzModuleRec->ErrorStart = ElementList->Starts[Idx];
+        tzModuleRec->ErrorLength = ElementList->Lengths[Idx];
+        return(Error(ecED));
+        }
+      }
+    if ( ((ElementList->Types[Idx] == etData) || (ElementList->Types[Idx] == etVar) || (ElementList->Types[Idx] == etCon) || (ElementList->Types[Idx] == etPin) ) && (Idx-1 > -1) && (ElementList->Types[Idx-1] == etUndef) )
+      { /*Found DATA, VAR, CON or PIN directive with undefined symbol before it, store previous symbol in Undefined Symbol Table*/
+      GetSymbolName(ElementList->Starts[Idx-1],ElementList->Lengths[Idx-1]);
+      if ((Result = EnterUndefSymbol(&Symbol.Name[0]))) return(Result);
+      }
+    }
+  if (DeferredError)
+    { /*Report error held from source*/
+    ElementListEnd = 0;
+    tzModuleRec->ErrorStart = DeferredErrorStart;
+    tzModuleRec->ErrorLength = DeferredErrorLength;
+    return(Error(DeferredError));
     }
-  /*Enter final End element*/
-  if ((Result = EnterElement(ElementType,0,True))) return(Result);
-  ElementListEnd = ElementListIdx;
   return(ecS); /*Return success*/
 }
 
@@ -2182,29 +4023,52 @@ bool tokenizer::GetElement(TElementList *Element)
  Returns True if successful, False if not found.*/
 {
   bool Result;
+  word Name;
 
   /*Initialize to false*/
   Result = False;
   Element->ElementType = etEnd;
   while (ElementListIdx < ElementListEnd)
 	{ /*While not at end of Element List...*/
-    if (ElementList[ElementListIdx].ElementType != etCancel)
+    if (ElementList->Types[ElementListIdx] != etCancel)
       { /*This element is not cancelled, retrieve it*/
-      Element->ElementType = ElementList[ElementListIdx].ElementType;
-      Element->Value = ElementList[ElementListIdx].Value;
-      Element->Start = ElementList[ElementListIdx].Start;
-      Element->Length = ElementList[ElementListIdx].Length;
+      Element->ElementType = (TElementType)ElementList->Types[ElementListIdx];
+      Element->Value = ElementList->Values[ElementListIdx];
+      Element->Start = ElementList->Starts[ElementListIdx];
+      Element->Length = ElementList->Lengths[ElementListIdx];
       ElementListIdx++; /*Point at next element*/
       Result = True;
       break;
       }
     else
-      ElementListIdx++; /*Skip to next element*/
+      { /*Cancelled, skip to next element*/
+      ElementListIdx++;
+      CountStat(CancelledSkips, 1);
+      }
     } /*While*/
   if (Element->ElementType == etUndef)
-    { /*Undefined type, let's look in the symbol table*/
-    GetSymbolName(Element->Start,Element->Length);  /*Load and find symbol*/
-    FindSymbol(&Symbol);
+    { /*Undefined type, see if its name has been entered in the symbol table since.  Like FindSymbol, set Symbol's type,
+       value and NextRecord; Symbol.Name is loaded unless the symbol is found through the name table*/
+    Name = Element->Value;
+    if (Name == UninternedName)
+      { /*Name isn't in the name table, let's look in the symbol table*/
+      GetSymbolName(Element->Start,Element->Length);  /*Load and find symbol*/
+      FindSymbol(&Symbol);
+      }
+    else
+      if (NameTable[Name].Symbol > -1)
+        { /*Entered since, retrieve it*/
+        Symbol.ElementType = SymbolTable[NameTable[Name].Symbol].ElementType;
+        Symbol.Value = SymbolTable[NameTable[Name].Symbol].Value;
+        Symbol.NextRecord = 0;
+        }
+      else
+        { /*Still undefined, load name*/
+        memcpy(Symbol.Name,NameTable[Name].Name,NameTable[Name].Length+1);
+        Symbol.ElementType = etUndef;
+        Symbol.Value = 0;
+        Symbol.NextRecord = (NameTable[Name].Undef ? 1 : 0); /*NextRecord = 1 indicates undefined non-DEFINE symbol*/
+        }
     Element->ElementType = Symbol.ElementType;      /*Store type and value in current element (whether we found it or not)*/
     Element->Value = Symbol.Value;
     Result = True;
@@ -2240,7 +4104,7 @@ void tokenizer::CancelElements(word Start, word Finish)
 {
   int Idx;
 
-  for (Idx = Start; Idx <= Finish; Idx++) ElementList[Idx].ElementType = etCancel;
+  for (Idx = Start; Idx <= Finish; Idx++) ElementList->Types[Idx] = etCancel;
 }
 
 /*------------------------------------------------------------------------------*/
@@ -2252,16 +4116,45 @@ void tokenizer::VoidElements(word Start, word Finish)
   int  Idx;
 
   CancelElements(Start,Finish);
-  if ( (Finish+1 < ElementListEnd) && (ElementList[Finish+1].ElementType == etEnd))
+  if ( (Finish+1 < ElementListEnd) && (ElementList->Types[Finish+1] == etEnd))
     {   /*Next element is End, cancel if preceding non-cancelled element is also etEnd*/
     Idx = Start-1;
-    while ( (Idx > -1) && (ElementList[Idx].ElementType == etCancel) ) Idx--;
-    if ( (Idx == -1) || ((Idx > -1) && (ElementList[Idx].ElementType == etEnd)) ) CancelElements(Finish+1,Finish+1);
+    while ( (Idx > -1) && (ElementList->Types[Idx] == etCancel) ) Idx--;
+    if ( (Idx == -1) || ((Idx > -1) && (ElementList->Types[Idx] == etEnd)) ) CancelElements(Finish+1,Finish+1);
     }
 }
 
 /*------------------------------------------------------------------------------*/
 
+void tokenizer::CompactElements(void)
+/*Remove cancelled elements from the element list, keeping the order of the rest, so that later passes step over only
+ live elements.  Elements keep their Start and Length, so errors are reported at the same place in the source.  Any
+ element indexes held across this call are invalidated; it's run after CompileCCDirectives cancels the unused branches
+ (before IndexDeclarations), and after the declaration passes cancel their lines (before CompileInstructions).*/
+{
+  word Idx;
+  word Live;
+
+  Live = 0;
+  for (Idx = 0; Idx < ElementListEnd; Idx++)
+    if (ElementList->Types[Idx] != etCancel)
+      {
+      if (Live != Idx)
+        {
+        ElementList->Types[Live] = ElementList->Types[Idx];
+        ElementList->Values[Live] = ElementList->Values[Idx];
+        ElementList->Starts[Live] = ElementList->Starts[Idx];
+        ElementList->Lengths[Live] = ElementList->Lengths[Idx];
+        }
+      Live++;
+      }
+  CountStat(CompactedElements, ElementListEnd-Live);
+  ElementListEnd = Live;
+  ElementListIdx = 0;
+}
+
+/*------------------------------------------------------------------------------*/
+
 void tokenizer::GetSymbolName(int Start, int Length)
 /*Retrieve symbol name from source starting at Start and ending at Length-1.  Sets Symbol equal to name.*/
 {
@@ -2346,6 +4239,11 @@ TErrorCode tokenizer::CompileStampDirective(void)
             tzModuleRec->ProjectFiles[ProgCount] = &tzSource[Element.Start];
             tzSource[Element.Start+Element.Length] = 0;
             tzModuleRec->ProjectFilesStart[ProgCount] = tzModuleRec->ErrorStart;
+            if (tzDirectiveViews != NULL)
+              {
+              tzDirectiveViews->ProjectFiles[ProgCount].Start = Element.Start;
+              tzDirectiveViews->ProjectFiles[ProgCount].Length = Element.Length;
+              }
             ProgCount++;
             }
           }
@@ -2390,6 +4288,11 @@ TErrorCode tokenizer::CompilePortDirective(void)
         tzModuleRec->Port = &tzSource[Element.Start];
         tzSource[Element.Start+Element.Length] = 0;
         tzModuleRec->PortStart = tzModuleRec->ErrorStart;  /*Record starting character for port name*/
+        if (tzDirectiveViews != NULL)
+          {
+          tzDirectiveViews->Port.Start = Element.Start;
+          tzDirectiveViews->Port.Length = Element.Length;
+          }
         GetElement(&Element);
         if (Element.ElementType != etRightCurlyBrace) return(Error(ecERCB)); /*Error: Expected right curly brace*/
         CancelElements(StartOfLine,ElementListIdx); /*Note, we'll cancel up to next element (should be etEnd)*/
@@ -2483,8 +4386,8 @@ TErrorCode tokenizer::CompileCCDirectives(void)
   if (Lang250 && (NestingStackIdx > 0))
     {  /*Still a nested code block on the stack, Error*/
     /*Set ErrorStart and ErrorLength for error*/
-    tzModuleRec->ErrorStart = ElementList[NestingStack[NestingStackIdx-1].ElementIdx].Start;
-    tzModuleRec->ErrorLength = ElementList[NestingStack[NestingStackIdx-1].ElementIdx].Length;
+    tzModuleRec->ErrorStart = ElementList->Starts[NestingStack[NestingStackIdx-1].ElementIdx];
+    tzModuleRec->ErrorLength = ElementList->Lengths[NestingStack[NestingStackIdx-1].ElementIdx];
     switch (NestingStack[NestingStackIdx-1].NestType)
       {
       case ntIFMultiElse :
@@ -2495,6 +4398,8 @@ TErrorCode tokenizer::CompileCCDirectives(void)
       default            : break;                     /*No other cases need handling*/
       }
     }
+  CompactElements();    /*Drop elements cancelled by conditional compilation*/
+  if ((Result = IndexDeclarations())) return(Result); /*Index declaration lines (and count GOSUBs) now that unnecessary elements are cancelled*/
   return(ecS); /*Return success*/
 }
 
@@ -2584,6 +4489,7 @@ TErrorCode tokenizer::CompileCCDefine(void)
     GetElement(&Element);
     if ( (Element.ElementType == etUndef) && (Symbol.NextRecord == 1) ) return(Error(ecSIAD));  /*Undefined non-DEFINE'd (DATA, VAR, CON or PIN) symbol? Error, Symbol is already defined*/
     if ( (Element.ElementType != etUndef) && (Element.ElementType != etCCConstant) ) return(Error(ecEAUDS)); /*Not undefined and not DEFINE'd symbol? Error, expected a user-defined symbol*/
+    if (Element.ElementType == etCCConstant) GetSymbolName(Element.Start,Element.Length); /*Load name of DEFINE'd symbol (see GetElement)*/
     if ((Result = CopySymbol())) return(Result);         /*Copy Symbol to Symbol2*/
     Redefine = (Symbol2.ElementType == etCCConstant);  /*Remember if it is an existing DEFINE'd symbol*/
     PreviewElement(&Element);
@@ -2688,15 +4594,15 @@ TErrorCode tokenizer::CompileCCSelect(void)
 TErrorCode tokenizer::AppendExpression(byte SourceExpression, TOperatorCode AppendOperator)
 /*Append SourceExpression and AppendOperator to expression 0.  Used by CompileCCCase and CompileCase.*/
 {
-  byte        Idx;
+  int         Idx;
   TErrorCode  Result;
 
   if ((Result = EnterExpressionBits(1,1))) return(Result);                /*Enter 1 (Continue bit) into Expression*/
   Idx = 0;
   while (Idx < Expression[SourceExpression][0])
-    {  /*While more bits from expression SourceExpression to append to expression 0...*/
+    {  /*While more words from expression SourceExpression to append to expression 0...*/
     if ((Result = EnterExpressionBits(Lowest(16,Expression[SourceExpression][0]-Idx),Expression[SourceExpression][(Idx / 16)+1]))) return(Result);
-    Idx += Lowest(16,Expression[SourceExpression][0]-Idx+1);
+    Idx += 16;
     }
   if ((Result = EnterExpressionOperator(AppendOperator))) return(Result); /*Append designated operator*/
   return(ecS); /*Return success*/
@@ -2809,13 +4715,155 @@ TErrorCode tokenizer::CompileCCEndSelect(void)
 
 /*------------------------------------------------------------------------------*/
 
+TErrorCode tokenizer::IndexDeclarations(void)
+/*Index the lines compiled by each declaration pass (CompilePins, CompileConstants, CompileData and CompileVar) and count
+ GOSUB instructions for CountGosubs, in one scan of the elements left by CompileCCDirectives, so that none of those
+ passes need scan the entire element list.  Lines are divided just as those passes divide them; a line runs from the
+ first element after an End through the next End after its second element.  The passes only cancel entire lines (or the
+ symbol before 'DATA'), so the lines stay divided this way as they go.  Each index is allocated big enough for every
+ line to be of its kind.*/
+{
+  int           Idx;
+  int           First;
+  int           Second;
+  int           Count;
+  TElementType  SecondType;
+
+  DeclarationLines[0] = (TDeclarationLine *) ElementAlloc(dkNumElements*(ElementListEnd/2+1)*sizeof(TDeclarationLine));
+  DeclarationStack = (TDeclarationFrame *) ElementAlloc((ElementListEnd/2+1)*sizeof(TDeclarationFrame));
+  if ( (DeclarationLines[0] == NULL) || (DeclarationStack == NULL) )
+    { /*Out of memory, Error: Too many elements*/
+    tzModuleRec->ErrorStart = 0;
+    tzModuleRec->ErrorLength = 0;
+    return(Error(ecTME));
+    }
+  for (Idx = 0; Idx < dkNumElements; Idx++)
+    {
+    DeclarationLines[Idx] = DeclarationLines[0]+Idx*(ElementListEnd/2+1);
+    DeclarationCount[Idx] = 0;
+    }
+  DeclarationStackTop = 0;
+  GosubCount = 0;
+  DataLayoutLine = 0;
+  DataLayoutIdx = 0;
+  DataLayoutBusy = False;
+  Idx = 0;
+  while (Idx < ElementListEnd)
+    { /*While more lines to index...*/
+    First = 0;
+    Second = ElementListEnd;
+    Count = 0;
+    while (Idx < ElementListEnd)
+      { /*Find end of line, noting first and second elements and counting GOSUBs along the way*/
+      if (ElementList->Types[Idx] != etCancel)
+        { /*This element is not cancelled*/
+        Count++;
+        if (Count == 1) First = Idx;
+        if (Count == 2) Second = Idx;
+        if ( (ElementList->Types[Idx] == etInstruction) && (ElementList->Values[Idx] == itGosub) && (++GosubCount == 256) ) GosubLimitIdx = Idx;
+        if ( (Count > 1) && (ElementList->Types[Idx] == etEnd) ) break;
+        }
+      Idx++;
+      }
+    Idx++;  /*Skip past End*/
+    if (Count == 0) break; /*Only cancelled elements left*/
+    /*Index line by its second element ('DATA' may also be the first)*/
+    SecondType = (Second < ElementListEnd ? (TElementType)ElementList->Types[Second] : etEnd);
+    switch (SecondType)
+      {
+      case etPin : AddDeclarationLine(dkPin,First,Second); break;
+      case etCon : AddDeclarationLine(dkCon,First,Second); break;
+      case etVar : AddDeclarationLine(dkVar,First,Second); break;
+      default    : break;
+      }
+    if (ElementList->Types[First] == etData)
+      AddDeclarationLine(dkData,First,First);
+    else
+      if (SecondType == etData) AddDeclarationLine(dkData,First,Second);
+    } /*While*/
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+void tokenizer::AddDeclarationLine(TDeclarationKind Kind, word Start, word Key)
+/*Enter line into the index of Kind.  Every line has at least two elements, so the index can't overflow.  If the line is
+ the first to declare a CON, PIN or DATA symbol, link the symbol's UndefSymbolTable record to it.*/
+{
+  int  Vector;
+
+  DeclarationLines[Kind][DeclarationCount[Kind]].Start = Start;
+  DeclarationLines[Kind][DeclarationCount[Kind]].Key = Key;
+  DeclarationLines[Kind][DeclarationCount[Kind]].Resolving = False;
+  if ( (Kind != dkVar) && (Start != Key) && (ElementList->Types[Start] == etUndef) )
+    { /*Symbol declared, link it to this line (unless declared before)*/
+    GetSymbolName(ElementList->Starts[Start],ElementList->Lengths[Start]);
+    Vector = GetUndefSymbolVector(Symbol.Name);
+    if ( (Vector > -1) && (UndefSymbolTable[Vector].Declaration == -1) )
+      {
+      UndefSymbolTable[Vector].DeclarationKind = Kind;
+      UndefSymbolTable[Vector].Declaration = DeclarationCount[Kind];
+      }
+    }
+  DeclarationCount[Kind]++;
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::GetDeclarationLine(TDeclarationKind Kind, int *LineIdx, word *StartOfLine)
+/*Retrieve the next line of Kind, starting at index LineIdx, that hasn't been cancelled since IndexDeclarations.  Sets
+ StartOfLine (and ElementListIdx) to the start of the line and LineIdx past it.  Returns True if found, False if not.*/
+{
+  while (*LineIdx < DeclarationCount[Kind])
+    { /*While more lines of Kind...*/
+    (*LineIdx)++;
+    if (ElementList->Types[DeclarationLines[Kind][*LineIdx-1].Key] != etCancel)
+      { /*Line not yet cancelled, start there*/
+      *StartOfLine = DeclarationLines[Kind][*LineIdx-1].Start;
+      ElementListIdx = *StartOfLine;
+      return(True);
+      }
+    }
+  return(False);
+}
+
+/*------------------------------------------------------------------------------*/
 
-TErrorCode tokenizer::CompilePins(bool LastPass)
+TErrorCode tokenizer::CompilePins(void)
 /*Compile PIN directives.  These are resolved as constants, but are called etPinNumber and
  treated as a constant or a variable of the form INx or OUTx based on the context of the
- reference.
- If LastPass = false, we "try" to compile them (compiled 'PIN' lines are canceled)
- If LastPass = true,  we compile (all remaining 'PIN' lines are compiled and canceled)*/
+ reference.  PIN lines already compiled for other declarations (see ResolveDeclaration) are skipped.*/
+{
+  word          StartOfLine;
+  int           LineIdx;
+  TErrorCode    Result;
+
+  LineIdx = 0;
+  while (GetDeclarationLine(dkPin,&LineIdx,&StartOfLine))
+    if ((Result = CompileDeclaration(dkPin,LineIdx-1))) return(Result);
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::CompileConstants(void)
+/*Compile CON directives.  CON lines already compiled for other declarations (see ResolveDeclaration) are skipped.*/
+{
+  word          StartOfLine;
+  int           LineIdx;
+  TErrorCode    Result;
+
+  LineIdx = 0;
+  while (GetDeclarationLine(dkCon,&LineIdx,&StartOfLine))
+    if ((Result = CompileDeclaration(dkCon,LineIdx-1))) return(Result);
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::CompileDeclaration(TDeclarationKind Kind, int LineIdx)
+/*Compile the CON or PIN directive on line LineIdx of the DeclarationLines of Kind; enter its symbol and cancel the line.
+ Symbols in the constant expression that are declared but not yet compiled are compiled first (see ResolveDeclaration).*/
 {
   word          StartOfLine;
   TElementList  Element;
@@ -2824,90 +4872,176 @@ TErrorCode tokenizer::CompilePins(bool LastPass)
   bool          SoftEnd;
   TErrorCode    Result;
 
-  ElementListIdx = 0;
-  StartOfLine = 0;
-  while (GetElement(&Element))
-  {  /*While not at end of elements...*/
-    /*Already got first element, but we need second element now*/
-    GetElement(&Element);
-    if (Element.ElementType == etPin)
-      {  /*Found 'PIN' directive*/
-      /*Go back and retrieve undefined symbol*/
-      ElementListIdx = StartOfLine;
-      if ((Result = GetUndefinedSymbol())) return(Result);
-      ElementListIdx++;               /*skip past 'PIN'*/
-      PreviewElement(&Element);        /*Preview start of constant and save Start in case of range error*/
-      StartOfConstant = Element.Start;
-      if ((Result = ResolveConstant(LastPass,False,&Resolved))) return(Result);
-      if (Resolved)
-        {  /*Constant resolved, enter symbol*/
-        if (Symbol2.Value > 15)       /*By now, Value is twos-compliment, so > 15 covers < 0 as well*/
-          {  /*Pin # out of range? Error, Pin number must be 0 to 15*/
-          ElementListIdx--;           /*Back up and*/
-          GetElement(&Element);        /*get next element to determine end of constant expression*/
-          tzModuleRec->ErrorStart = StartOfConstant;
-          tzModuleRec->ErrorLength = Element.Start-StartOfConstant+Element.Length;
-          return(Error(ecPNMBZTF));
-          }
-        Symbol2.ElementType = etPinNumber; /*Change type to pin number*/
-        if ((Result = EnterSymbol(Symbol2))) return(Result);
-        if ((Result = GetEnd(&SoftEnd))) return(Result);
-        CancelElements(StartOfLine,ElementListIdx-1);
-        }
-      else /*Constant unresolved, just verify end of line*/
-        if ((Result = GetEnd(&SoftEnd))) return(Result);
-      }
-    else
-      {  /*Not 'PIN' directive, skip to end of line*/
-      while ( (Element.ElementType != etEnd) && GetElement(&Element) );
+  StartOfLine = DeclarationLines[Kind][LineIdx].Start;
+  DeclarationLines[Kind][LineIdx].Resolving = True;
+  ElementListIdx = StartOfLine;
+  /*Retrieve undefined symbol*/
+  if ((Result = GetUndefinedSymbol())) return(Result);
+  ElementListIdx++;               /*skip past 'CON' or 'PIN'*/
+  if ((Result = ResolveDependencies(Kind,LineIdx))) return(Result);
+  PreviewElement(&Element);        /*Preview start of constant and save Start in case of range error*/
+  StartOfConstant = Element.Start;
+  if ((Result = ResolveConstant(True,False,&Resolved))) return(Result);
+  if (Kind == dkPin)
+    { /*'PIN' directive*/
+    if (Symbol2.Value > 15)       /*By now, Value is twos-compliment, so > 15 covers < 0 as well*/
+      {  /*Pin # out of range? Error, Pin number must be 0 to 15*/
+      ElementListIdx--;           /*Back up and*/
+      GetElement(&Element);        /*get next element to determine end of constant expression*/
+      tzModuleRec->ErrorStart = StartOfConstant;
+      tzModuleRec->ErrorLength = Element.Start-StartOfConstant+Element.Length;
+      return(Error(ecPNMBZTF));
       }
-    StartOfLine = ElementListIdx;
-    }  /*While*/
+    Symbol2.ElementType = etPinNumber; /*Change type to pin number*/
+    }
+  /*Enter symbol, verify end of line and cancel elements*/
+  if ((Result = EnterSymbol(Symbol2))) return(Result);
+  if ((Result = GetEnd(&SoftEnd))) return(Result);
+  CancelElements(StartOfLine,ElementListIdx-1);
+  DeclarationLines[Kind][LineIdx].Resolving = False;
   return(ecS); /*Return success*/
 }
 
 /*------------------------------------------------------------------------------*/
 
-TErrorCode tokenizer::CompileConstants(bool LastPass)
-/*Compile CON directives.
- If LastPass = false, we "try" to compile them (compiled 'CON' lines are canceled)
- If LastPass = true,  we compile (all remaining 'CON' lines are compiled and canceled)*/
+TErrorCode tokenizer::ResolveDeclaration(TElementList *Element)
+/*Resolve Element, an undefined symbol whose value is needed now, by compiling the CON or PIN directive declaring it, or
+ laying out DATA through the line declaring it.  Constant expressions are thereby evaluated in the order their references
+ demand (a depth-first topological order of the declarations), so a symbol may be used before it is declared and each
+ declaration is compiled once.  Sets Element to the symbol's type and value.  Errors if the symbol is not declared as a
+ CON, PIN or DATA symbol, or if its value depends upon itself.*/
 {
   TErrorCode    Result;
-  word          StartOfLine;
-  TElementList  Element;
-  bool          Resolved;
-  bool          SoftEnd;
+  int           Vector;
+  word          SavedIdx;
+  TSymbolTable  SavedSymbol;
+
+  GetSymbolName(Element->Start,Element->Length);
+  Vector = GetUndefSymbolVector(Symbol.Name);
+  if ( (Vector == -1) || (UndefSymbolTable[Vector].Declaration == -1) ) return(Error(ecUS)); /*Not declared? Error: Undefined Symbol*/
+  if (UndefSymbolTable[Vector].DeclarationKind == dkData)
+    { /*DATA symbol; if DATA is being laid out, it's on this line or after it*/
+    if (DataLayoutBusy) return(Error(ecSIDITOI));                /*Error: Symbol is defined in terms of itself*/
+    }
+  else
+    if (DeclarationLines[UndefSymbolTable[Vector].DeclarationKind][UndefSymbolTable[Vector].Declaration].Resolving)
+      return(Error(ecSIDITOI));                                  /*Error: Symbol is defined in terms of itself*/
+  /*Compile declaration, then return to this element and retrieve it again*/
+  SavedIdx = ElementListIdx;
+  SavedSymbol = Symbol2;
+  if (UndefSymbolTable[Vector].DeclarationKind == dkData)
+    Result = LayoutData(UndefSymbolTable[Vector].Declaration);
+  else
+    Result = CompileDeclaration(UndefSymbolTable[Vector].DeclarationKind,UndefSymbolTable[Vector].Declaration);
+  if (Result) return(Result);
+  ElementListIdx = SavedIdx-1;
+  Symbol2 = SavedSymbol;
+  GetElement(Element);
+  return(ecS); /*Return success*/
+}
 
-  ElementListIdx = 0;
-  StartOfLine = 0;
-  while (GetElement(&Element))
-    { /*While not at end of elements...*/
-    /*Already got first element, but we need second element now*/
-    GetElement(&Element);
-    if (Element.ElementType == etCon)
-      { /*Found 'CON' directive*/
-      /*Go back and retrieve undefined symbol*/
-      ElementListIdx = StartOfLine;
-      if ((Result = GetUndefinedSymbol())) return(Result);
-      ElementListIdx++; /*skip past 'CON'*/
-      if ((Result = ResolveConstant(LastPass, False, &Resolved))) return(Result);
-      if (Resolved)
-        { /*Constant resolved, enter symbol*/
-        if ((Result = EnterSymbol(Symbol2))) return(Result);
-        if ((Result = GetEnd(&SoftEnd))) return(Result);
-        CancelElements(StartOfLine,ElementListIdx-1);
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::ResolveDependencies(TDeclarationKind Kind, int LineIdx)
+/*Compile the CON and PIN directives that the constant expression on line LineIdx of the DeclarationLines of Kind
+ depends upon, and those they depend upon, laying out DATA as needed, all in the order ResolveConstant would come to
+ them.  Lines wait on DeclarationStack rather than the call stack, so a long chain of declarations can't exhaust a
+ (worker thread's) stack.  A line is evaluated only as far as ResolveConstant would get without error; an undeclared
+ symbol, one defined in terms of itself, or a division by zero is left for ResolveConstant to report.  Restores
+ ElementListIdx and Symbol2.*/
+{
+  TErrorCode        Result;
+  TDeclarationFrame *Frame;
+  TDeclarationLine  *Line;
+  TElementList      Element;
+  TElementList      Preview;
+  TSymbolTable      SavedSymbol;
+  word              SavedIdx;
+  word              Operand;
+  word              Value;
+  TOperatorCode     Operation;
+  int               Base;
+  int               Vector;
+  bool              Negate;
+  bool              LaidOut;
+  bool              Waiting;
+
+  SavedIdx = ElementListIdx;
+  SavedSymbol = Symbol2;
+  Base = DeclarationStackTop;
+  DeclarationStack[DeclarationStackTop].Kind = Kind;
+  DeclarationStack[DeclarationStackTop].LineIdx = LineIdx;
+  DeclarationStack[DeclarationStackTop].Next = DeclarationLines[Kind][LineIdx].Key+1;
+  DeclarationStack[DeclarationStackTop].Operation = ocAdd;    /*Prime for first operation (add constant to 0)*/
+  DeclarationStack[DeclarationStackTop].Value = 0;
+  DeclarationStackTop++;
+  Result = ecS;
+  while ( (!Result) && (DeclarationStackTop > Base) )
+    { /*While lines wait on the stack, scan the top one's expression from where it left off*/
+    Frame = &DeclarationStack[DeclarationStackTop-1];
+    ElementListIdx = Frame->Next;
+    Operation = Frame->Operation;
+    Value = Frame->Value;
+    LaidOut = False;
+    Waiting = False;
+    while (True)
+      {
+      Operand = ElementListIdx;
+      GetElement(&Element);
+      Negate = (Element.ElementType == etBinaryOp);
+      if (Negate)
+        { /*Only negation may come before an operand*/
+        if (Element.Value != (word) ocSub) break;
+        GetElement(&Element);
         }
-      else /*Constant unresolved, just verify end of line*/
-        if ((Result = GetEnd(&SoftEnd))) return(Result);
+      if (Element.ElementType == etUndef)
+        { /*Undefined symbol, find the line declaring it*/
+        GetSymbolName(Element.Start,Element.Length);
+        Vector = GetUndefSymbolVector(Symbol.Name);
+        if ( (Vector == -1) || (UndefSymbolTable[Vector].Declaration == -1) ) break;
+        if (UndefSymbolTable[Vector].DeclarationKind == dkData)
+          { /*DATA symbol; lay out DATA through its line, then read the operand again*/
+          if (DataLayoutBusy || LaidOut) break;
+          if ((Result = LayoutData(UndefSymbolTable[Vector].Declaration))) break;
+          LaidOut = True;
+          ElementListIdx = Operand;
+          continue;
+          }
+        Line = &DeclarationLines[UndefSymbolTable[Vector].DeclarationKind][UndefSymbolTable[Vector].Declaration];
+        if ( Line->Resolving || (ElementList->Types[Line->Key] == etCancel) ) break;
+        /*CON or PIN symbol; this line waits, from this operand, while that one is resolved*/
+        Line->Resolving = True;
+        Frame->Next = Operand;
+        Frame->Operation = Operation;
+        Frame->Value = Value;
+        DeclarationStack[DeclarationStackTop].Kind = UndefSymbolTable[Vector].DeclarationKind;
+        DeclarationStack[DeclarationStackTop].LineIdx = UndefSymbolTable[Vector].Declaration;
+        DeclarationStack[DeclarationStackTop].Next = Line->Key+1;
+        DeclarationStack[DeclarationStackTop].Operation = ocAdd;
+        DeclarationStack[DeclarationStackTop].Value = 0;
+        DeclarationStackTop++;
+        Waiting = True;
+        break;
+        }
+      if ( !((Element.ElementType == etConstant) || (Element.ElementType == etPinNumber) || (Element.ElementType == etDirective) || (Element.ElementType == etTargetModule)) ) break;
+      if (Negate) Element.Value = -Element.Value;
+      if (!ConstantOperation(Operation,&Value,Element.Value)) break;  /*Dividing by zero; ResolveConstant reports it*/
+      LaidOut = False;
+      PreviewElement(&Preview);
+      if ( !((Preview.ElementType == etBinaryOp) && (IsConstantOperatorCode(Preview.Value))) ) break;
+      Operation = (TOperatorCode) Preview.Value;
+      ElementListIdx++; /*Skip operator*/
       }
-    else
-      { /*Not 'CON' directive, skip to end of line*/
-      while ((Element.ElementType != etEnd) && GetElement(&Element));
+    if ( (!Result) && (!Waiting) )
+      { /*Line scanned, compile it (unless it's the line we began with, which our caller compiles)*/
+      DeclarationStackTop--;
+      if (DeclarationStackTop > Base) Result = CompileDeclaration(Frame->Kind,Frame->LineIdx);
       }
-    StartOfLine = ElementListIdx;
-    } /*While*/
-  return(ecS); /*Return success*/
+    }
+  DeclarationStackTop = Base;
+  ElementListIdx = SavedIdx;
+  Symbol2 = SavedSymbol;
+  return(Result);
 }
 
 /*------------------------------------------------------------------------------*/
@@ -2957,12 +5091,47 @@ TErrorCode tokenizer::EnterData(TElementList *Element, word *EEPROMValue, word *
 
 TErrorCode tokenizer::CompileData(bool LastPass)
 /*Compile data directives.
- If LastPass = false, we "try" to compile them (all 'DATA' symbols are compiled and canceled)
+ If LastPass = false, we lay them out (all 'DATA' symbols are compiled and canceled), finishing any lay out begun for
+                      CON and PIN directives (see ResolveDeclaration)
  If LastPass = true,  we compile (all 'DATA' lines are compiled and canceled)*/
 {
   TErrorCode    Result;
   word          EEPROMIdx;
   word          StartOfLine;
+  int           LineIdx;
+
+  if (!LastPass) return(LayoutData(DeclarationCount[dkData]-1));
+  EEPROMIdx = 0;
+  LineIdx = 0;
+  while (GetDeclarationLine(dkData,&LineIdx,&StartOfLine))
+    if ((Result = CompileDataLine(True,StartOfLine,&EEPROMIdx))) return(Result);
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::LayoutData(int LastLine)
+/*Lay out data directives (compile them with LastPass = false) from where the last lay out stopped through line LastLine
+ of the DeclarationLines of dkData.  This assigns addresses to DATA symbols; DATA values are left for CompileData(True).*/
+{
+  TErrorCode    Result;
+  word          StartOfLine;
+
+  DataLayoutBusy = True;
+  while ( (DataLayoutLine <= LastLine) && GetDeclarationLine(dkData,&DataLayoutLine,&StartOfLine) )
+    if ((Result = CompileDataLine(False,StartOfLine,&DataLayoutIdx))) return(Result);
+  DataLayoutBusy = False;
+  return(ecS); /*Return success*/
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::CompileDataLine(bool LastPass, word StartOfLine, word *DataIdx)
+/*Compile data directive on line starting at StartOfLine, entering data at DataIdx (and updating it).
+ If LastPass = false, we "try" to compile it (its 'DATA' symbol, if any, is compiled and canceled)
+ If LastPass = true,  we compile (the line is compiled and canceled)*/
+{
+  TErrorCode    Result;
   TElementList  Element;
   TElementList  Preview;
   bool          SymbolFlag;
@@ -2972,110 +5141,96 @@ TErrorCode tokenizer::CompileData(bool LastPass)
   word          Idx;
   word          EEPROMValue;
 
-  EEPROMIdx = 0;
-  ElementListIdx = 0;
-  StartOfLine = ElementListIdx;
-  while (GetElement(&Element))
-    { /*While more elements (ie: more lines to process)...*/
-    SymbolFlag = False;
-    if (Element.ElementType != etData)
-      { /*Not 'DATA' but element may be symbol, check for 'DATA' in second element*/
-      GetElement(&Element);
-      if (Element.ElementType == etData)
-        { /*Found 'DATA' element, assign symbol that preceeded it*/
-        ElementListIdx = StartOfLine;
-        if ((Result = GetUndefinedSymbol())) return(Result);
-        CancelElements(StartOfLine,ElementListIdx-1);
-        ElementListIdx++; /*Skip past 'DATA' element*/
-        SymbolFlag = True;
-        } /*Found 'DATA'*/
-      } /*Not 'DATA'*/
-    if (Element.ElementType == etData)
-      { /*Definitely found 'DATA' line*/
-      GetElement(&Element); /*Get 1st element of first term*/
-      if (Element.ElementType == etEnd)
-        { /*If at end of line, assign the symbol (if any) and cancel elements*/
-        if ((Result = AssignSymbol(&SymbolFlag,&EEPROMIdx))) return(Result);
-        CancelElements(StartOfLine,ElementListIdx-1);  /* //! Note StartOfLine never updated from above (slight inefficiency here)*/
-        }
+  ElementListIdx = StartOfLine;
+  SymbolFlag = False;
+  GetElement(&Element);
+  if (Element.ElementType != etData)
+    { /*Not 'DATA', must be symbol that preceeds it; assign it*/
+    ElementListIdx = StartOfLine;
+    if ((Result = GetUndefinedSymbol())) return(Result);
+    CancelElements(StartOfLine,ElementListIdx-1);
+    ElementListIdx++; /*Skip past 'DATA' element*/
+    SymbolFlag = True;
+    } /*Not 'DATA'*/
+  GetElement(&Element); /*Get 1st element of first term*/
+  if (Element.ElementType == etEnd)
+    { /*If at end of line, assign the symbol (if any) and cancel elements*/
+    if ((Result = AssignSymbol(&SymbolFlag,DataIdx))) return(Result);
+    CancelElements(StartOfLine,ElementListIdx-1);  /* //! Note StartOfLine never updated from above (slight inefficiency here)*/
+    }
+  else
+    { /*If not end of line*/
+    do
+      { /*More elements on line...*/
+      if (Element.ElementType == etAt)
+        { /*Found '@'*/
+        if ((Result = ResolveConstant(True,False,&Resolved))) return(Result);
+        *DataIdx = Symbol2.Value;
+        if (*DataIdx >= EEPROMSize) return(Error(ecLIOOR)); /*Error if index is out of EEPROM range*/
+        if ((Result = AssignSymbol(&SymbolFlag,DataIdx))) return(Result);
+        GetElement(&Element);
+        if (Element.ElementType != etComma)
+          { /*If not comma, check for invalid element or end of line and cancel elements appropriately*/
+          if (Element.ElementType != etEnd) return(Error(ecECEOLOC)); /*Error, expected comma, eol or colon*/
+          if (LastPass) CancelElements(StartOfLine,ElementListIdx-1);
+          break;
+          }
+        } /*Found '@'*/
       else
-        { /*If not end of line*/
-        do
-          { /*More elements on line...*/
-          if (Element.ElementType == etAt)
-            { /*Found '@'*/
-            if ((Result = ResolveConstant(True,False,&Resolved))) return(Result);
-            EEPROMIdx = Symbol2.Value;
-            if (EEPROMIdx >= EEPROMSize) return(Error(ecLIOOR)); /*Error if index is out of EEPROM range*/
-            if ((Result = AssignSymbol(&SymbolFlag,&EEPROMIdx))) return(Result);
+        { /*If no '@' (ie: data not redirected to new location)*/
+        if ((Result = AssignSymbol(&SymbolFlag,DataIdx))) return(Result);
+        DefinedFlag = False;
+        WordFlag = False;
+        EEPROMValue = 0;
+        if (Element.ElementType == etVariableAuto)
+          { /*May have found 'WORD'*/
+          if (Element.Value == 3)
+            { /*Found 'WORD'*/
+            WordFlag = True;
             GetElement(&Element);
-            if (Element.ElementType != etComma)
-              { /*If not comma, check for invalid element or end of line and cancel elements appropriately*/
-              if (Element.ElementType != etEnd) return(Error(ecECEOLOC)); /*Error, expected comma, eol or colon*/
-              if (LastPass) CancelElements(StartOfLine,ElementListIdx-1);
-              break;
-              }
-            } /*Found '@'*/
-          else
-            { /*If no '@' (ie: data not redirected to new location)*/
-            if ((Result = AssignSymbol(&SymbolFlag,&EEPROMIdx))) return(Result);
-            DefinedFlag = False;
-            WordFlag = False;
-            EEPROMValue = 0;
-            if (Element.ElementType == etVariableAuto)
-              { /*May have found 'WORD'*/
-              if (Element.Value == 3)
-                { /*Found 'WORD'*/
-                WordFlag = True;
-                GetElement(&Element);
-                }
-              }
-            if (Element.ElementType != etLeft)
-              { /*Not undefined repetitive data*/
-              ElementListIdx--;
-              if ((Result = ResolveConstant(LastPass,False,&Resolved))) return(Result);
-              EEPROMValue = Symbol2.Value;
-              DefinedFlag = True;
-              PreviewElement(&Preview);
-              if (Preview.ElementType != etLeft)
-                { /*Not defined repetitive data*/
-                if ((Result = EnterData(&Element,&EEPROMValue,&EEPROMIdx,WordFlag,DefinedFlag,LastPass))) return(Result);
-                GetElement(&Element);
-                if (Element.ElementType == etComma)
-                  { /*Comma found, continue with line*/
-                  GetElement(&Element);
-                  continue;
-                  }
-                else
-                  { /*If not comma, check for invalid element or end of line and cancel elements appropriately*/
-                  if (Element.ElementType != etEnd) return(Error(ecECEOLOC)); /*Error, expected constant, eol or colon*/
-                  if (LastPass) CancelElements(StartOfLine,ElementListIdx-1);
-                  break;
-                  }
-                }  /*Not defined repetitive data*/
-              ElementListIdx++;
-              } /*Not undefined repetitive data*/
-            if ((Result = ResolveConstant(True,False,&Resolved))) return(Result);
-            /*Repeat defined or undefined data*/
-            for (Idx = 1; Idx <= Symbol2.Value; Idx++) if ((Result = EnterData(&Element,&EEPROMValue,&EEPROMIdx,WordFlag,DefinedFlag,LastPass))) return(Result);
-            if ((Result = GetRight())) return(Result); /*Get and verify ')'*/
+            }
+          }
+        if (Element.ElementType != etLeft)
+          { /*Not undefined repetitive data*/
+          ElementListIdx--;
+          if ((Result = ResolveConstant(LastPass,False,&Resolved))) return(Result);
+          EEPROMValue = Symbol2.Value;
+          DefinedFlag = True;
+          PreviewElement(&Preview);
+          if (Preview.ElementType != etLeft)
+            { /*Not defined repetitive data*/
+            if ((Result = EnterData(&Element,&EEPROMValue,DataIdx,WordFlag,DefinedFlag,LastPass))) return(Result);
             GetElement(&Element);
-            if (Element.ElementType != etComma)
+            if (Element.ElementType == etComma)
+              { /*Comma found, continue with line*/
+              GetElement(&Element);
+              continue;
+              }
+            else
               { /*If not comma, check for invalid element or end of line and cancel elements appropriately*/
               if (Element.ElementType != etEnd) return(Error(ecECEOLOC)); /*Error, expected constant, eol or colon*/
               if (LastPass) CancelElements(StartOfLine,ElementListIdx-1);
               break;
               }
-            } /*If no '@' (ie: data not redirected to new location)*/
-          GetElement(&Element); /*Get 1st element of next term*/
+            }  /*Not defined repetitive data*/
+          ElementListIdx++;
+          } /*Not undefined repetitive data*/
+        if ((Result = ResolveConstant(True,False,&Resolved))) return(Result);
+        /*Repeat defined or undefined data*/
+        for (Idx = 1; Idx <= Symbol2.Value; Idx++) if ((Result = EnterData(&Element,&EEPROMValue,DataIdx,WordFlag,DefinedFlag,LastPass))) return(Result);
+        if ((Result = GetRight())) return(Result); /*Get and verify ')'*/
+        GetElement(&Element);
+        if (Element.ElementType != etComma)
+          { /*If not comma, check for invalid element or end of line and cancel elements appropriately*/
+          if (Element.ElementType != etEnd) return(Error(ecECEOLOC)); /*Error, expected constant, eol or colon*/
+          if (LastPass) CancelElements(StartOfLine,ElementListIdx-1);
+          break;
           }
-        while (True); /*While more elements on line*/
-        } /*If not eol*/
-      } /*Definitely found 'DATA' line*/
-    /*Skip to end of line*/
-    while ( (Element.ElementType != etEnd) && GetElement(&Element) );
-    StartOfLine = ElementListIdx;
-    } /*While more elements*/
+        } /*If no '@' (ie: data not redirected to new location)*/
+      GetElement(&Element); /*Get 1st element of next term*/
+      }
+    while (True); /*While more elements on line*/
+    } /*If not eol*/
   return(ecS); /*Return success*/
 }
 
@@ -3129,6 +5284,7 @@ TErrorCode tokenizer::CompileVar(bool LastPass)
   byte          Temp;
   word          ArraySize;
   word          StartOfLine;
+  int           LineIdx;
   TElementList  Element;
   TElementList  Preview;
   const byte    Shifts[] = {2,1,1,0};
@@ -3150,82 +5306,68 @@ TErrorCode tokenizer::CompileVar(bool LastPass)
       Temp = (Temp << Shifts[3-Idx]) + tzModuleRec->VarCounts[3-Idx];
       }
     }
-  ElementListIdx = 0; /*Reset element list idx*/
-  StartOfLine = ElementListIdx;
-
-  while (GetElement(&Element))
-    { /*While more lines to process*/
-    GetElement(&Element); /*Got first element, now check second*/
-    if (Element.ElementType == etVar)
-      { /*Found a VAR declaration*/
-      ElementListIdx = StartOfLine;
-      if ((Result = GetUndefinedSymbol())) return(Result);  /*Get undefined symbol*/
-      ElementListIdx++; /*Skip past 'VAR'*/
-      GetElement(&Element);
-      if (Element.ElementType == etVariableAuto)
-        { /*Found BIT, NIB, BYTE or WORD*/
-        PreviewElement(&Preview);
-        ArraySize = 1;
-        if (Preview.ElementType == etLeft)
-          { /*Found '(' (ie: Array)*/
-          ElementListIdx++; /*Skip past '('*/
-          if ((Result = ResolveConstant(True,False,&Resolved))) return(Result);
-          ArraySize = Symbol2.Value;
-          if (ArraySize == 0) return(Error(ecASCBZ)); /*Error, Array Size Cannot Be Zero*/
-          }
-        if (!LastPass)
-          { /*'try to' compile (update counts and verify space available)*/
-          if (ArraySize > 255) return(Error(ecOOVS));               /*Array too big, Error: Out of Variable Space*/
-          tzModuleRec->VarCounts[Element.Value] += ArraySize;       /*Update var counts*/
-          ArraySize *= Bits[Element.Value];                         /*Adjust size to actual number of bits*/
-          if (ArraySize > 255) return(Error(ecOOVS));               /*Too big, Error: Out of Variable Space*/
-          if ((VarBitCount+ArraySize) > 255) return(Error(ecOOVS)); /*Error: Out of Variable Space*/
-          VarBitCount += ArraySize;                                 /*Update bit counter*/
-          if (VarBitCount > 256-(3*16)) return(Error(ecOOVS));      /*Error: Out of Variable Space*/
-          if (Preview.ElementType == etLeft) {if ((Result = GetRight())) return(Result);} /*Finish index processing if necessary*/
-          if ((Result = GetEnd(&SoftEnd))) return(Result);
-          Element.ElementType = etEnd; /*Prime for next line*/
-          }
-        else
-          { /*compile (automatically assign VAR to register base position)*/
-          Symbol2.ElementType = etVariable;
-          Symbol2.Value = (Element.Value << 8) + VarBases[Element.Value];
-          VarBases[Element.Value] += ArraySize;
-          /*Enter Symbol, verify end of line and cancel elements*/
-          if ((Result = EnterSymbol(Symbol2))) return(Result);
-          if (Preview.ElementType == etLeft) {if ((Result = GetRight())) return(Result);} /*Finish index processing if necessary*/
-          if ((Result = GetEnd(&SoftEnd))) return(Result);
-          CancelElements(StartOfLine,ElementListIdx-1);
-          Element.ElementType = etEnd; /*Prime for next line*/
-          }
-        } /*Found BIT, NIB, BYTE or WORD*/
+  LineIdx = 0;
+  while (GetDeclarationLine(dkVar,&LineIdx,&StartOfLine))
+    { /*While more 'VAR' lines (see IndexDeclarations)...*/
+    if ((Result = GetUndefinedSymbol())) return(Result);  /*Get undefined symbol*/
+    ElementListIdx++; /*Skip past 'VAR'*/
+    GetElement(&Element);
+    if (Element.ElementType == etVariableAuto)
+      { /*Found BIT, NIB, BYTE or WORD*/
+      PreviewElement(&Preview);
+      ArraySize = 1;
+      if (Preview.ElementType == etLeft)
+        { /*Found '(' (ie: Array)*/
+        ElementListIdx++; /*Skip past '('*/
+        if ((Result = ResolveConstant(True,False,&Resolved))) return(Result);
+        ArraySize = Symbol2.Value;
+        if (ArraySize == 0) return(Error(ecASCBZ)); /*Error, Array Size Cannot Be Zero*/
+        }
+      if (!LastPass)
+        { /*'try to' compile (update counts and verify space available)*/
+        if (ArraySize > 255) return(Error(ecOOVS));               /*Array too big, Error: Out of Variable Space*/
+        tzModuleRec->VarCounts[Element.Value] += ArraySize;       /*Update var counts*/
+        ArraySize *= Bits[Element.Value];                         /*Adjust size to actual number of bits*/
+        if (ArraySize > 255) return(Error(ecOOVS));               /*Too big, Error: Out of Variable Space*/
+        if ((VarBitCount+ArraySize) > 255) return(Error(ecOOVS)); /*Error: Out of Variable Space*/
+        VarBitCount += ArraySize;                                 /*Update bit counter*/
+        if (VarBitCount > 256-(3*16)) return(Error(ecOOVS));      /*Error: Out of Variable Space*/
+        if (Preview.ElementType == etLeft) {if ((Result = GetRight())) return(Result);} /*Finish index processing if necessary*/
+        if ((Result = GetEnd(&SoftEnd))) return(Result);
+        }
       else
-        {  /*Not BIT, NIB, BYTE or WORD, should be variable*/
-        if (Element.ElementType == etVariable)
-          { /*Found a variable name*/
-          /*Get Modifiers, enter symbol, verify end of line and cancel elements*/
-          if ((Result = GetModifiers(&Element))) return(Result);
-          if ((Result = EnterSymbol(Symbol2))) return(Result);
-          if ((Result = GetEnd(&SoftEnd))) return(Result);
-          CancelElements(StartOfLine,ElementListIdx-1);
-          Element.ElementType = etEnd; /*Prime for next line*/
-          }
-        else
-          { /*Not a variable, may be unknown so far*/
-          if (Element.ElementType != etUndef) return(Error(ecEAV)); /*Not unresolved var? Error, Expected a Variable*/
-          /*Must be unknown variable*/
-          if (LastPass) return(Error(ecUS)); /*If still unknown on last pass, Error, Unrecognized Symbol*/
-          Element.Value = (3 << 8) + (Element.Value & 0xFF);  /*Set size (highbyte) to Word so there are not size errors*/
-          if ((Result = GetModifiers(&Element))) return(Result);
-          if ((Result = GetEnd(&SoftEnd))) return(Result);
-          Element.ElementType = etEnd; /*Prime for next line*/
-          }
+        { /*compile (automatically assign VAR to register base position)*/
+        Symbol2.ElementType = etVariable;
+        Symbol2.Value = (Element.Value << 8) + VarBases[Element.Value];
+        VarBases[Element.Value] += ArraySize;
+        /*Enter Symbol, verify end of line and cancel elements*/
+        if ((Result = EnterSymbol(Symbol2))) return(Result);
+        if (Preview.ElementType == etLeft) {if ((Result = GetRight())) return(Result);} /*Finish index processing if necessary*/
+        if ((Result = GetEnd(&SoftEnd))) return(Result);
+        CancelElements(StartOfLine,ElementListIdx-1);
         }
-      } /*Found a VAR declaration*/
-    /*Skip to end of line*/
-    while ( (Element.ElementType != etEnd) && GetElement(&Element) );
-    StartOfLine = ElementListIdx;
-    }
+      } /*Found BIT, NIB, BYTE or WORD*/
+    else
+      {  /*Not BIT, NIB, BYTE or WORD, should be variable*/
+      if (Element.ElementType == etVariable)
+        { /*Found a variable name*/
+        /*Get Modifiers, enter symbol, verify end of line and cancel elements*/
+        if ((Result = GetModifiers(&Element))) return(Result);
+        if ((Result = EnterSymbol(Symbol2))) return(Result);
+        if ((Result = GetEnd(&SoftEnd))) return(Result);
+        CancelElements(StartOfLine,ElementListIdx-1);
+        }
+      else
+        { /*Not a variable, may be unknown so far*/
+        if (Element.ElementType != etUndef) return(Error(ecEAV)); /*Not unresolved var? Error, Expected a Variable*/
+        /*Must be unknown variable*/
+        if (LastPass) return(Error(ecUS)); /*If still unknown on last pass, Error, Unrecognized Symbol*/
+        Element.Value = (3 << 8) + (Element.Value & 0xFF);  /*Set size (highbyte) to Word so there are not size errors*/
+        if ((Result = GetModifiers(&Element))) return(Result);
+        if ((Result = GetEnd(&SoftEnd))) return(Result);
+        }
+      }
+    } /*While more 'VAR' lines*/
   return(ecS); /*Return success*/
 }
 
@@ -3242,6 +5384,7 @@ TErrorCode tokenizer::ResolveConstant(bool LastPass, bool CCDefine, bool *Resolv
   word          Value;
   bool          NFlag;   /*Negative flag*/
   bool          URFlag;  /*Unresolved flag*/
+  TErrorCode    Result;
 
   NFlag = False;
   URFlag = False;
@@ -3265,9 +5408,15 @@ TErrorCode tokenizer::ResolveConstant(bool LastPass, bool CCDefine, bool *Resolv
       if (!CCDefine)
         {                                      /*Normal constant expression...*/
         if (Element.ElementType != etUndef) return(Error(ecEAC)); /*Error if not undefined*/
-        if (LastPass) return(Error(ecUS)); /*If not resolved by now, error: Undefined Symbol*/
-        Element.Value = 1; /*Undefined, set value to 1 in case of ocDiv operation*/
-        URFlag = True;     /*Set unresolved flag*/
+        if (LastPass)
+          { /*Must be resolved by now; compile its declaration (error if none: Undefined Symbol)*/
+          if ((Result = ResolveDeclaration(&Element))) return(Result);
+          }
+        else
+          {
+          Element.Value = 1; /*Undefined, set value to 1 in case of ocDiv operation*/
+          URFlag = True;     /*Set unresolved flag*/
+          }
         }
       else
         {                                      /*CCDefine constant expression...*/
@@ -3278,21 +5427,7 @@ TErrorCode tokenizer::ResolveConstant(bool LastPass, bool CCDefine, bool *Resolv
       }
     if (NFlag) Element.Value = -Element.Value; /*Negate value if needed*/
     NFlag = False;
-    if ((Operation == ocShl) || (Operation == ocShr)) Element.Value = Lowest(Element.Value,16); /*If SHL or SHR, limit shifts to 16*/
-    /*Perform requested algebraic operation*/
-    switch (Operation)
-      {
-      case ocShl: Value = Value << Element.Value; break;
-      case ocShr: Value = Value >> Element.Value; break;
-      case ocAnd: Value = Value & Element.Value; break;
-      case ocOr : Value = Value | Element.Value; break;
-      case ocXor: Value = Value ^ Element.Value; break;
-      case ocAdd: Value = Value + Element.Value; break;
-      case ocSub: Value = Value - Element.Value; break;
-      case ocMul: Value = Value * Element.Value; break;
-      case ocDiv: if (Element.Value > 0) Value = Value / Element.Value; else return(Error(ecCDBZ)); break; /*Error, cannot divide by zero*/
-      default   : break; /*No other operations allowed*/
-      }
+    if (!ConstantOperation(Operation,&Value,Element.Value)) return(Error(ecCDBZ)); /*Error, cannot divide by zero*/
     /*Preview next element*/
     PreviewElement(&Preview);
     }
@@ -3304,6 +5439,29 @@ TErrorCode tokenizer::ResolveConstant(bool LastPass, bool CCDefine, bool *Resolv
   return(ecS); /*Return success*/
 }
 
+/*------------------------------------------------------------------------------*/
+
+bool tokenizer::ConstantOperation(TOperatorCode Operation, word *Value, word Operand)
+/*Perform requested algebraic operation of constant expression, *Value = *Value Operation Operand.  Returns False (leaving
+ *Value alone) if dividing by zero.*/
+{
+  if ((Operation == ocShl) || (Operation == ocShr)) Operand = Lowest(Operand,16); /*If SHL or SHR, limit shifts to 16*/
+  switch (Operation)
+    {
+    case ocShl: *Value = *Value << Operand; break;
+    case ocShr: *Value = *Value >> Operand; break;
+    case ocAnd: *Value = *Value & Operand; break;
+    case ocOr : *Value = *Value | Operand; break;
+    case ocXor: *Value = *Value ^ Operand; break;
+    case ocAdd: *Value = *Value + Operand; break;
+    case ocSub: *Value = *Value - Operand; break;
+    case ocMul: *Value = *Value * Operand; break;
+    case ocDiv: if (Operand > 0) *Value = *Value / Operand; else return(False); break;
+    default   : break; /*No other operations allowed*/
+    }
+  return(True);
+}
+
 
 /*------------------------------------------------------------------------------*/
 
@@ -3435,6 +5593,9 @@ TErrorCode tokenizer::CompileInstructions(void)
   bool          StartFlag;
   bool          SoftEnd;
   TElementList  Element;
+  #if defined(CompileStatistics)
+    long long   TraceStart = 0;
+  #endif
 
   /*Reset pointers and counters*/
   ElementListIdx = 0;
@@ -3469,86 +5630,96 @@ TErrorCode tokenizer::CompileInstructions(void)
         StartFlag = True;
         }
       EnterSrcTokRef(); /*Enter Source vs. Token Cross Reference*/
+      #if defined(CompileStatistics)
+        if (tzTrace != NULL) TraceStart = StatsClock();   /*Tracing, note start of instruction*/
+      #endif
       if ((Element.ElementType == etVariable) || (Element.ElementType == etPinNumber))
         { /*Variable Assignment (or PinNumber, variable, assignment), compile it*/
         ElementListIdx--;
-        if ((Result = CompileLet())) return(Result);
+        Result = CompileLet();
         }
       else
         { /*May be Instruction*/
         if (Element.ElementType != etInstruction) return(Error(ecEALVOI)); /*Not Instruction?, Error: Expected a Label, Variable or Instruction*/
         /*Compile Instruction*/
+        Result = ecS;
         switch (Element.Value)
           {
-          case itAuxio:    if ((Result = CompileAuxio())) return(Result); break;
-          case itBranch:   if ((Result = CompileBranch())) return(Result); break;
-          case itButton:   if ((Result = CompileButton())) return(Result); break;
-          case itCase:     if ((Result = CompileCase())) return(Result); break;
-          case itCount:    if ((Result = CompileCount())) return(Result); break;
-          case itDebug:    if ((Result = CompileDebug())) return(Result); break;
-          case itDebugIn:  if ((Result = CompileDebugIn())) return(Result); break;
-          case itDo:       if ((Result = CompileDo())) return(Result); break;
-          case itDtmfout:  if ((Result = CompileDtmfout())) return(Result); break;
-          case itElse:     if ((Result = CompileElse())) return(Result); break;
-          case itEnd:      if ((Result = CompileEnd())) return(Result); break;
-          case itEndIf:    if ((Result = CompileEndIf())) return(Result); break;
-          case itEndSelect:if ((Result = CompileEndSelect())) return(Result); break;
-          case itExit:     if ((Result = CompileExit())) return(Result); break;
-          case itFor:      if ((Result = CompileFor())) return(Result); break;
-          case itFreqout:  if ((Result = CompileFreqout())) return(Result); break;
-          case itGet:      if ((Result = CompileGet())) return(Result); break;
-          case itGosub:    if ((Result = CompileGosub())) return(Result); break;
-          case itGoto:     if ((Result = CompileGoto())) return(Result); break;
-          case itHigh:     if ((Result = CompileHigh())) return(Result); break;
-          case itI2cin:    if ((Result = CompileI2cin())) return(Result); break;
-          case itI2cout:   if ((Result = CompileI2cout())) return(Result); break;
+          case itAuxio:    Result = CompileAuxio(); break;
+          case itBranch:   Result = CompileBranch(); break;
+          case itButton:   Result = CompileButton(); break;
+          case itCase:     Result = CompileCase(); break;
+          case itCount:    Result = CompileCount(); break;
+          case itDebug:    Result = CompileDebug(); break;
+          case itDebugIn:  Result = CompileDebugIn(); break;
+          case itDo:       Result = CompileDo(); break;
+          case itDtmfout:  Result = CompileDtmfout(); break;
+          case itElse:     Result = CompileElse(); break;
+          case itEnd:      Result = CompileEnd(); break;
+          case itEndIf:    Result = CompileEndIf(); break;
+          case itEndSelect:Result = CompileEndSelect(); break;
+          case itExit:     Result = CompileExit(); break;
+          case itFor:      Result = CompileFor(); break;
+          case itFreqout:  Result = CompileFreqout(); break;
+          case itGet:      Result = CompileGet(); break;
+          case itGosub:    Result = CompileGosub(); break;
+          case itGoto:     Result = CompileGoto(); break;
+          case itHigh:     Result = CompileHigh(); break;
+          case itI2cin:    Result = CompileI2cin(); break;
+          case itI2cout:   Result = CompileI2cout(); break;
           case itIf:
-          case itElseIf:   if ((Result = CompileIf(Element.Value == itElseIf))) return(Result); break;
-          case itInput:    if ((Result = CompileInput())) return(Result); break;
-          case itIoterm:   if ((Result = CompileIoterm())) return(Result); break;
-          case itLcdcmd:   if ((Result = CompileLcdcmd())) return(Result); break;
-          case itLcdin:    if ((Result = CompileLcdin())) return(Result); break;
-          case itLcdout:   if ((Result = CompileLcdout())) return(Result); break;
-          case itLookdown: if ((Result = CompileLookdown())) return(Result); break;
-          case itLookup:   if ((Result = CompileLookup())) return(Result); break;
-          case itLoop:     if ((Result = CompileLoop())) return(Result); break;
-          case itLow:      if ((Result = CompileLow())) return(Result); break;
-          case itMainio:   if ((Result = CompileMainio())) return(Result); break;
-          case itNap:      if ((Result = CompileNap())) return(Result); break;
-          case itNext:     if ((Result = CompileNext())) return(Result); break;
-          case itOn:       if ((Result = CompileOn())) return(Result); break;
-          case itOutput:   if ((Result = CompileOutput())) return(Result); break;
-          case itOwin:     if ((Result = CompileOwin())) return(Result); break;
-          case itOwout:    if ((Result = CompileOwout())) return(Result); break;
-          case itPause:    if ((Result = CompilePause())) return(Result); break;
-          case itPollin:   if ((Result = CompilePollin())) return(Result); break;
-          case itPollmode: if ((Result = CompilePollmode())) return(Result); break;
-          case itPollout:  if ((Result = CompilePollout())) return(Result); break;
-          case itPollrun:  if ((Result = CompilePollrun())) return(Result); break;
-          case itPollwait: if ((Result = CompilePollwait())) return(Result); break;
-          case itPulsin:   if ((Result = CompilePulsin())) return(Result); break;
-          case itPulsout:  if ((Result = CompilePulsout())) return(Result); break;
-          case itPut:      if ((Result = CompilePut())) return(Result); break;
-          case itPwm:      if ((Result = CompilePwm())) return(Result); break;
-          case itRandom:   if ((Result = CompileRandom())) return(Result); break;
-          case itRctime:   if ((Result = CompileRctime())) return(Result); break;
-          case itRead:     if ((Result = CompileRead())) return(Result); break;
-          case itReturn:   if ((Result = CompileReturn())) return(Result); break;
-          case itReverse:  if ((Result = CompileReverse())) return(Result); break;
-          case itRun:      if ((Result = CompileRun())) return(Result); break;
-          case itSelect:   if ((Result = CompileSelect())) return(Result); break;
-          case itSerin:    if ((Result = CompileSerin())) return(Result); break;
-          case itSerout:   if ((Result = CompileSerout())) return(Result); break;
-          case itShiftin:  if ((Result = CompileShiftin())) return(Result); break;
-          case itShiftout: if ((Result = CompileShiftout())) return(Result); break;
-          case itSleep:    if ((Result = CompileSleep())) return(Result); break;
-          case itStop:     if ((Result = CompileStop())) return(Result); break;
-          case itStore:    if ((Result = CompileStore())) return(Result); break;
-          case itToggle:   if ((Result = CompileToggle())) return(Result); break;
-          case itWrite:    if ((Result = CompileWrite())) return(Result); break;
-          case itXout:     if ((Result = CompileXout())) return(Result); break;
+          case itElseIf:   Result = CompileIf(Element.Value == itElseIf); break;
+          case itInput:    Result = CompileInput(); break;
+          case itIoterm:   Result = CompileIoterm(); break;
+          case itLcdcmd:   Result = CompileLcdcmd(); break;
+          case itLcdin:    Result = CompileLcdin(); break;
+          case itLcdout:   Result = CompileLcdout(); break;
+          case itLookdown: Result = CompileLookdown(); break;
+          case itLookup:   Result = CompileLookup(); break;
+          case itLoop:     Result = CompileLoop(); break;
+          case itLow:      Result = CompileLow(); break;
+          case itMainio:   Result = CompileMainio(); break;
+          case itNap:      Result = CompileNap(); break;
+          case itNext:     Result = CompileNext(); break;
+          case itOn:       Result = CompileOn(); break;
+          case itOutput:   Result = CompileOutput(); break;
+          case itOwin:     Result = CompileOwin(); break;
+          case itOwout:    Result = CompileOwout(); break;
+          case itPause:    Result = CompilePause(); break;
+          case itPollin:   Result = CompilePollin(); break;
+          case itPollmode: Result = CompilePollmode(); break;
+          case itPollout:  Result = CompilePollout(); break;
+          case itPollrun:  Result = CompilePollrun(); break;
+          case itPollwait: Result = CompilePollwait(); break;
+          case itPulsin:   Result = CompilePulsin(); break;
+          case itPulsout:  Result = CompilePulsout(); break;
+          case itPut:      Result = CompilePut(); break;
+          case itPwm:      Result = CompilePwm(); break;
+          case itRandom:   Result = CompileRandom(); break;
+          case itRctime:   Result = CompileRctime(); break;
+          case itRead:     Result = CompileRead(); break;
+          case itReturn:   Result = CompileReturn(); break;
+          case itReverse:  Result = CompileReverse(); break;
+          case itRun:      Result = CompileRun(); break;
+          case itSelect:   Result = CompileSelect(); break;
+          case itSerin:    Result = CompileSerin(); break;
+          case itSerout:   Result = CompileSerout(); break;
+          case itShiftin:  Result = CompileShiftin(); break;
+          case itShiftout: Result = CompileShiftout(); break;
+          case itSleep:    Result = CompileSleep(); break;
+          case itStop:     Result = CompileStop(); break;
+          case itStore:    Result = CompileStore(); break;
+          case itToggle:   Result = CompileToggle(); break;
+          case itWrite:    Result = CompileWrite(); break;
+          case itXout:     Result = CompileXout(); break;
           } /*Case*/
         }
+      #if defined(CompileStatistics)
+        if (tzTrace != NULL)   /*Trace failed instructions too, up to where they failed*/
+          TraceSpan(tkInstruction, (Element.ElementType == etInstruction ? Element.Value : -1), TraceStart, Element.Start,
+                    ElementList->Starts[ElementListIdx-1] + ElementList->Lengths[ElementListIdx-1] - Element.Start);
+      #endif
+      if (Result) return(Result);
       }  /*Defined address*/
       if ((IfThenCount == 0) || !(NestingStack[NestingStackIdx-1].NestType < ntIFMultiElse))
         {
@@ -6406,6 +8577,7 @@ TErrorCode tokenizer::GetAddressEnter(void)
     PatchList[PatchListIdx] = ElementListIdx-1;
     PatchList[PatchListIdx+1] = EEPROMIdx;
     PatchListIdx += 2;
+    CountStat(PatchEntries, 1);
     EEPROMIdx += 14;
     }
   return(ecS); /*Return success*/
@@ -6418,8 +8590,8 @@ TErrorCode tokenizer::EnterAddress(word Address)
 {
   TErrorCode  Result;
 
-  if ((Result = EnterEEPROM(3,Address))) return(Result);
-  if ((Result = EnterEEPROM(11,Address / /*div*/ 8))) return(Result);
+  /*Low 3 bits, then the 11 above them*/
+  if ((Result = EnterEEPROMBits(14,((Address & 7) << 11) | ((Address / /*div*/ 8) & 0x7FF)))) return(Result);
   return(ecS); /*Return success*/
 }
 
@@ -6442,20 +8614,16 @@ TErrorCode tokenizer::EnterConstant(word Constant, bool Enter1Before)
 /*------------------------------------------------------------------------------*/
 
 TErrorCode tokenizer::CountGosubs(void)
-/*Count GOSUB instructions.  This routine only counts the occurances of GOSUB, it does not validate
- the instruction in any way other than to limit the maximum number of GOSUBS to 255*/
+/*Check count of GOSUB instructions.  IndexDeclarations only counts the occurances of GOSUB, it does not validate
+ the instruction in any way; here we limit the maximum number of GOSUBS to 255*/
 {
   TElementList   Element;
 
-  ElementListIdx = 0;
-  GosubCount = 0;
-  while (GetElement(&Element))
-    { /*While more lines to process...*/
-    if (Element.ElementType == etInstruction)
-      { /*Found instruction*/
-      if (Element.Value == itGosub) GosubCount++;
-      if (GosubCount > 255) return(Error(ecLOTFFGE)); /*If > 255 GOSUBs, Error: Limit of 255 GOSUBs exceeded*/
-      }
+  if (GosubCount > 255)
+    { /*Found more than 255 GOSUBs, point at the first one too many*/
+    ElementListIdx = GosubLimitIdx;
+    GetElement(&Element);
+    return(Error(ecLOTFFGE)); /*Error: Limit of 255 GOSUBs exceeded*/
     }
   return(ecS); /*Return success*/
 }
@@ -6542,28 +8710,45 @@ TErrorCode tokenizer::EnterEEPROM(byte Bits, word Data)
 when this procedure exits.  This procedure will properly span data across the 8-bit boundaries
 of the EEPROM buffer.*/
 {
-  byte  ShiftFactor;
-  int   Temp;
+  return(EnterEEPROMBits(Bits,Data));
+}
+
+/*------------------------------------------------------------------------------*/
+
+TErrorCode tokenizer::EnterEEPROMBits(byte Bits, uint64_t Data)
+/*Enter the low Bits bits of Data (0 to 57 bits) into EEPROM program data at EEPROMIdx, most significant first, and
+ update EEPROMIdx.  The bits are lined up with the first EEPROM byte in a 64-bit accumulator and written out a whole byte
+ at a time; the bytes they span are checked for DATA once, before any is written.*/
+{
+  word     First;
+  word     Last;
+  word     Idx;
+  int      Temp;
 
   if (EEPROMIdx + Bits > EEPROMSize*8) return(Error(ecEF)); /*Error: EEPROM Full*/
-  Data = Data << (16-Bits); /*MSB-justify data*/
-   while (Bits > 0)
-    { /*While more bits to insert*/
-    ShiftFactor = EEPROMIdx & 7;
-    Temp = tzModuleRec->EEPROMFlags[2047-(EEPROMIdx / /*div*/ 8)] & 3;
+  if (Bits == 0) return(ecS);
+  CountStat(EEPROMBits, Bits);
+  First = EEPROMIdx / /*div*/ 8;
+  Last = (EEPROMIdx+Bits-1) / /*div*/ 8;
+  for (Idx = First; Idx <= Last; Idx++)
+    {
+    Temp = tzModuleRec->EEPROMFlags[2047-Idx] & 3;
     if ( (Temp == 1) || (Temp == 2) )
       { /*Error: Data Occupies Same Location As Program*/
-      tzModuleRec->ErrorStart = EEPROMPointers[EEPROMIdx * 4];     /*Retrieve Source Start and Length from DATA's EEPROM Pointers*/
-      tzModuleRec->ErrorLength = EEPROMPointers[EEPROMIdx * 4 + 1];
+      tzModuleRec->ErrorStart = EEPROMPointers[(2047-Idx) * 2];     /*Retrieve Source Start and Length from DATA's EEPROM Pointers*/
+      tzModuleRec->ErrorLength = EEPROMPointers[(2047-Idx) * 2 + 1];
       return(Error(ecDOSLAP));
       }
-    /*All is well, enter the program data and set the flags*/
-    tzModuleRec->EEPROM[2047-(EEPROMIdx / /*div*/ 8)] = tzModuleRec->EEPROM[2047-(EEPROMIdx / /*div*/ 8)] | (Data >> (8+ShiftFactor));
-    tzModuleRec->EEPROMFlags[2047-(EEPROMIdx / /*div*/ 8)] = tzModuleRec->EEPROMFlags[2047-(EEPROMIdx / /*div*/ 8)] | 3;
-    Data = Data << (8-ShiftFactor);          /*Adjust Data in anticipation for next EEPROM byte*/
-    EEPROMIdx += Lowest(Bits,8-ShiftFactor); /*Adjust EEPROM Index according to how many bits actually written*/
-    Bits -= Lowest(8-ShiftFactor,Bits);      /*Decrement Bits counter appropriately*/
     }
+  /*All is well, enter the program data and set the flags*/
+  Data = (Data << (64-Bits)) >> (EEPROMIdx & 7); /*MSB-justify data, then line it up with the first byte*/
+  for (Idx = First; Idx <= Last; Idx++)
+    {
+    tzModuleRec->EEPROM[2047-Idx] = tzModuleRec->EEPROM[2047-Idx] | (byte)(Data >> 56);
+    tzModuleRec->EEPROMFlags[2047-Idx] = tzModuleRec->EEPROMFlags[2047-Idx] | 3;
+    Data = Data << 8;
+    }
+  EEPROMIdx += Bits;
   return(ecS); /*Return success*/
 }
 
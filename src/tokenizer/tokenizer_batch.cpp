@@ -0,0 +1,143 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_batch.cpp                                                                                                            */
+/*                                                                                                                                               */
+/* PURPOSE:       Compiles many independent PBASIC sources at once by running one tokenizer object per worker thread.                           */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "tokenizer_pool.hpp"
+#include "tokenizer/tokenizer_batch.hpp"  /* Make sure this is the last include! */
+
+/*Define a worker's run of jobs.  The owner takes from Head, thieves take from Tail.*/
+struct TBatchRun
+{
+    std::mutex  Lock;
+    int         Head;
+    int         Tail;
+};
+
+/*------------------------------------------------------------------------------*/
+
+static bool TakeJob(TBatchRun *Run, bool Steal, int *JobIdx)
+/*Remove the next job from Run; from the front if we own it, from the back if we're stealing it.  Returns True if a job
+  was taken, False if Run is empty.*/
+{
+  std::lock_guard<std::mutex> Guard(Run->Lock);
+
+  if (Run->Head >= Run->Tail) return(False);
+  *JobIdx = (Steal ? --Run->Tail : Run->Head++);
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+BatchCompiler::BatchCompiler(int ThreadCount)
+{
+  Workers = PoolWorkers(ThreadCount);
+  #if defined(CompileStatistics)
+    Traces = NULL;
+  #endif
+}
+
+/*------------------------------------------------------------------------------*/
+
+BatchCompiler::~BatchCompiler() = default;
+
+/*------------------------------------------------------------------------------*/
+
+int BatchCompiler::ThreadCount(void)
+/*Return maximum number of worker threads*/
+{
+  return(Workers);
+}
+
+/*------------------------------------------------------------------------------*/
+
+#if defined(CompileStatistics)
+void BatchCompiler::SetTraces(TCompileTrace *WorkerTraces)
+/*Trace every following job into WorkerTraces[0..ThreadCount()-1], one trace per worker (see tokenizer::SetTrace and
+  WriteTraceFile).  NULL stops tracing.*/
+{
+  Traces = WorkerTraces;
+}
+#endif
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI BatchCompiler::Compile(TBatchJob *Jobs, TModuleRec *Results, int JobCount, TBatchStats *Stats)
+/*Compile Jobs[0..JobCount-1] into Results[0..JobCount-1] using up to ThreadCount() worker threads.  Each Results
+  element is filled exactly as tokenizer::Compile would fill it.  Stats may be NULL.  Returns True if every job
+  compiled successfully, False otherwise.*/
+{
+  int                                       Idx;
+  int                                       ThreadsUsed;
+  std::atomic<int>                          Succeeded(0);
+  std::atomic<int>                          Steals(0);
+  std::vector<TBatchRun>                    Runs;
+  std::chrono::steady_clock::time_point     StartTime;
+  double                                    Seconds;
+
+  StartTime = std::chrono::steady_clock::now();
+  ThreadsUsed = (JobCount < Workers ? JobCount : Workers);
+  if (ThreadsUsed < 1) ThreadsUsed = 1;
+  /*Create any worker tokenizers we haven't needed before*/
+  while ((int) Tokenizers.size() < ThreadsUsed) Tokenizers.emplace_back(new tokenizer);
+  /*Deal out contiguous runs of jobs, one per worker*/
+  Runs = std::vector<TBatchRun>(ThreadsUsed);
+  for (Idx = 0; Idx < ThreadsUsed; Idx++)
+    {
+    Runs[Idx].Head = (int) ((long long) JobCount * Idx / ThreadsUsed);
+    Runs[Idx].Tail = (int) ((long long) JobCount * (Idx+1) / ThreadsUsed);
+    }
+
+  auto Worker = [&](int WorkerIdx)
+    {
+    tokenizer  *Tokenizer = Tokenizers[WorkerIdx].get();
+    TBatchJob  *Job;
+    TModuleRec *Rec;
+    int        JobIdx;
+    int        Victim;
+    bool       Found;
+
+    #if defined(CompileStatistics)
+      Tokenizer->SetTrace(Traces != NULL ? &Traces[WorkerIdx] : NULL);
+    #endif
+    while (True)
+      {
+      Found = TakeJob(&Runs[WorkerIdx], False, &JobIdx);
+      for (Victim = 1; !Found && (Victim < ThreadsUsed); Victim++)
+        if ((Found = TakeJob(&Runs[(WorkerIdx+Victim) % ThreadsUsed], True, &JobIdx))) Steals++;
+      if (!Found) break; /*All runs are empty, we're done*/
+      Job = &Jobs[JobIdx];
+      Rec = &Results[JobIdx];
+      memset(Rec, 0, sizeof(TModuleRec));
+      Rec->SourceSize = Job->SourceSize;
+      if (!Job->ParseStampDirective) Rec->TargetModule = Job->TargetModule;
+      if (Job->SharedSource != NULL ?
+          Tokenizer->CompileView(Rec, Job->SharedSource, Job->SourceSize, Job->DirectivesOnly, Job->ParseStampDirective, Job->SrcTokReference, Job->Views) :
+          Tokenizer->Compile(Rec, Job->Source, Job->DirectivesOnly, Job->ParseStampDirective, Job->SrcTokReference)) Succeeded++;
+      }
+    };
+
+  /*The calling thread works the first run itself*/
+  RunWorkers(ThreadsUsed, Worker);
+
+  Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+  if (Stats != NULL)
+    {
+    Stats->JobCount = JobCount;
+    Stats->Succeeded = Succeeded;
+    Stats->ThreadCount = ThreadsUsed;
+    Stats->Steals = Steals;
+    Stats->Seconds = Seconds;
+    Stats->JobsPerSecond = (Seconds > 0 ? JobCount / Seconds : 0);
+    }
+  return(Succeeded == JobCount);
+}
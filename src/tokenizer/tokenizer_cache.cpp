@@ -0,0 +1,360 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_cache.cpp                                                                                                            */
+/*                                                                                                                                               */
+/* PURPOSE:       Keeps compile results on disk, addressed by a hash of what went into them, so unchanged sources needn't be compiled again.     */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+
+#include "tokenizer/tokenizer_cache.hpp"
+
+#define CacheMagic          0x43544250      /*"PBTC" in a little-endian file; a file from a machine of the other byte order won't match*/
+#define CacheFormatVersion  1               /*Bump when TCacheEntry or what follows it changes*/
+
+/*Define cache file header.  The file is laid out so it can be used in place (such as memory-mapped): this header, then
+  EEPROM[EEPROMSize], EEPROMFlags[EEPROMSize], PacketCount*18 bytes of PacketBuffer, ReferenceCount TSrcTokReference
+  records and StringsSize bytes of NUL-terminated strings (the Error, Port and ProjectFiles that aren't NULL).*/
+struct TCacheEntry
+{
+    unsigned int        Magic;
+    unsigned short      FormatVersion;
+    unsigned short      Version;                /*TokenizerVersion*/
+    unsigned long long  Key[2];                 /*Hash of source and compile inputs (see HashKey)*/
+    int                 SourceSize;
+    byte                Succeeded;
+    byte                DebugFlag;
+    byte                TargetModule;
+    byte                PacketCount;
+    byte                VarCounts[4];
+    int                 TargetStart;
+    int                 ProjectFilesStart[7];
+    int                 PortStart;
+    int                 LanguageVersion;
+    int                 LanguageStart;
+    int                 ErrorStart;
+    int                 ErrorLength;
+    TDirectiveViews     Views;
+    int                 ReferenceCount;         /*Number of references up to the last that isn't clear*/
+    int                 ErrorText;              /*Offsets of strings, -1 = NULL*/
+    int                 PortText;
+    int                 ProjectFileText[7];
+    int                 StringsSize;
+};
+
+#define PacketSize   18                     /*Bytes per packet in PacketBuffer*/
+
+/*------------------------------------------------------------------------------*/
+
+static unsigned long long Rotate(unsigned long long Value, int Bits)
+/*Return Value rotated left by Bits*/
+{
+  return((Value << Bits) | (Value >> (64-Bits)));
+}
+
+/*------------------------------------------------------------------------------*/
+
+static unsigned long long Finish(unsigned long long Value)
+/*Mix all bits of Value into each other*/
+{
+  Value ^= Value >> 33;
+  Value *= 0xFF51AFD7ED558CCDULL;
+  Value ^= Value >> 33;
+  Value *= 0xC4CEB9FE1A85EC53ULL;
+  Value ^= Value >> 33;
+  return(Value);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static void Hash128(const void *Data, int Size, unsigned long long Seed, unsigned long long *Hash)
+/*Set Hash[0..1] to the 128-bit MurmurHash3 (x64 variant) of Data[0..Size-1]*/
+{
+  const unsigned long long C1 = 0x87C37B91114253D5ULL;
+  const unsigned long long C2 = 0x4CF5AD432745937FULL;
+  const byte               *Bytes = (const byte *) Data;
+  unsigned long long       H1 = Seed;
+  unsigned long long       H2 = Seed;
+  unsigned long long       K1;
+  unsigned long long       K2;
+  int                      Idx;
+
+  /*Body, 16 bytes at a time*/
+  for (Idx = 0; Idx+16 <= Size; Idx += 16)
+    {
+    memcpy(&K1, &Bytes[Idx], 8);
+    memcpy(&K2, &Bytes[Idx+8], 8);
+    K1 *= C1; K1 = Rotate(K1, 31); K1 *= C2; H1 ^= K1;
+    H1 = Rotate(H1, 27); H1 += H2; H1 = H1*5+0x52DCE729;
+    K2 *= C2; K2 = Rotate(K2, 33); K2 *= C1; H2 ^= K2;
+    H2 = Rotate(H2, 31); H2 += H1; H2 = H2*5+0x38495AB5;
+    }
+  /*Tail, up to 15 bytes*/
+  K1 = K2 = 0;
+  switch (Size & 15)
+    {
+    case 15: K2 ^= (unsigned long long) Bytes[Idx+14] << 48;  /*Fall through*/
+    case 14: K2 ^= (unsigned long long) Bytes[Idx+13] << 40;  /*Fall through*/
+    case 13: K2 ^= (unsigned long long) Bytes[Idx+12] << 32;  /*Fall through*/
+    case 12: K2 ^= (unsigned long long) Bytes[Idx+11] << 24;  /*Fall through*/
+    case 11: K2 ^= (unsigned long long) Bytes[Idx+10] << 16;  /*Fall through*/
+    case 10: K2 ^= (unsigned long long) Bytes[Idx+9] << 8;    /*Fall through*/
+    case  9: K2 ^= (unsigned long long) Bytes[Idx+8];
+             K2 *= C2; K2 = Rotate(K2, 33); K2 *= C1; H2 ^= K2; /*Fall through*/
+    case  8: K1 ^= (unsigned long long) Bytes[Idx+7] << 56;   /*Fall through*/
+    case  7: K1 ^= (unsigned long long) Bytes[Idx+6] << 48;   /*Fall through*/
+    case  6: K1 ^= (unsigned long long) Bytes[Idx+5] << 40;   /*Fall through*/
+    case  5: K1 ^= (unsigned long long) Bytes[Idx+4] << 32;   /*Fall through*/
+    case  4: K1 ^= (unsigned long long) Bytes[Idx+3] << 24;   /*Fall through*/
+    case  3: K1 ^= (unsigned long long) Bytes[Idx+2] << 16;   /*Fall through*/
+    case  2: K1 ^= (unsigned long long) Bytes[Idx+1] << 8;    /*Fall through*/
+    case  1: K1 ^= (unsigned long long) Bytes[Idx];
+             K1 *= C1; K1 = Rotate(K1, 31); K1 *= C2; H1 ^= K1;
+    }
+  /*Finalization*/
+  H1 ^= (unsigned long long) Size;
+  H2 ^= (unsigned long long) Size;
+  H1 += H2;
+  H2 += H1;
+  H1 = Finish(H1);
+  H2 = Finish(H2);
+  H1 += H2;
+  H2 += H1;
+  Hash[0] = H1;
+  Hash[1] = H2;
+}
+
+/*------------------------------------------------------------------------------*/
+
+static void HashKey(const char *Src, int SrcSize, bool DirectivesOnly, bool ParseStampDirective, byte TargetModule, unsigned long long *Key)
+/*Set Key[0..1] to the hash of everything a CompileView result depends upon: the source, the flags, the TargetModule if
+  it isn't to come from a $STAMP directive and the version of this tokenizer.  The LanguageVersion always comes from
+  the source's $PBASIC directive (or its absence), so the source covers it.*/
+{
+  unsigned long long Inputs[4];
+
+  Hash128(Src, SrcSize, 0, Inputs);
+  Inputs[2] = ((unsigned long long) TokenizerVersion << 32) | ((unsigned long long) CacheFormatVersion << 16);
+  Inputs[3] = ((DirectivesOnly ? 1 : 0) | (ParseStampDirective ? 2 : 0) | (ParseStampDirective ? 0 : TargetModule << 8));
+  Hash128(Inputs, sizeof(Inputs), (unsigned long long) SrcSize, Key);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static int AddString(std::vector<char> &Strings, const char *Text)
+/*Append Text (and its NUL) to Strings and return its offset, or -1 if Text is NULL*/
+{
+  int  Offset;
+
+  if (Text == NULL) return(-1);
+  Offset = (int) Strings.size();
+  Strings.insert(Strings.end(), Text, Text+strlen(Text)+1);
+  return(Offset);
+}
+
+/*------------------------------------------------------------------------------*/
+
+static bool StringOK(const TCacheEntry *Entry, const char *Strings, int Offset)
+/*Return True if string Offset of Entry is NULL (-1) or lies, with its NUL, within its Strings*/
+{
+  if (Offset == -1) return(True);
+  if ((Offset < 0) || (Offset >= Entry->StringsSize)) return(False);
+  return(memchr(&Strings[Offset], 0, Entry->StringsSize-Offset) != NULL);
+}
+
+/*------------------------------------------------------------------------------*/
+
+CompileCache::CompileCache(const char *Directory)
+{
+  HitCount = 0;
+  MissCount = 0;
+  Path = Directory;
+}
+
+/*------------------------------------------------------------------------------*/
+
+CompileCache::~CompileCache() = default;
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI CompileCache::Compile(TModuleRec *Rec, const char *Src, int SrcSize, bool DirectivesOnly, bool ParseStampDirective, TSrcTokReference *Ref, TDirectiveViews *Views)
+/*Compile Src as tokenizer::CompileView would (with the same rules for Src, Ref and Views), from the cache if the same
+  compile is there, otherwise by compiling it and adding it to the cache.  After a hit, the TModuleRec pointer fields
+  point to this object's own copies of the strings, which are only good until the next Compile.  Returns True if
+  successful, False otherwise.*/
+{
+  unsigned long long  Key[2];
+  char                Name[40];
+  std::string         FileName;
+  TDirectiveViews     OwnViews;
+  bool                Result;
+
+  if (Tokenizer == nullptr) Tokenizer = std::make_unique<tokenizer>();
+  if ((SrcSize < 0) || (SrcSize >= MaxSourceSize)) return(Tokenizer->CompileView(Rec, Src, SrcSize, DirectivesOnly, ParseStampDirective, Ref, Views));
+  HashKey(Src, SrcSize, DirectivesOnly, ParseStampDirective, Rec->TargetModule, Key);
+  snprintf(Name, sizeof(Name), "/%016llx%016llx.pbc", Key[0], Key[1]);
+  FileName = Path + Name;
+  if (Load(FileName, Key, Rec, Ref, Views))
+    {
+    HitCount++;
+    return(Rec->Succeeded);
+    }
+  /*Miss; compile, keeping the references and views to store even if the caller didn't want them*/
+  MissCount++;
+  if (Ref == NULL)
+    {
+    References.resize(SrcTokRefSize);
+    Ref = References.data();
+    }
+  if (Views == NULL) Views = &OwnViews;
+  Result = Tokenizer->CompileView(Rec, Src, SrcSize, DirectivesOnly, ParseStampDirective, Ref, Views);
+  Store(FileName, Key, DirectivesOnly, Rec, Ref, Views);
+  return(Result);
+}
+
+/*------------------------------------------------------------------------------*/
+
+int CompileCache::Hits(void)
+/*Return the number of Compiles served from the cache*/
+{
+  return(HitCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+int CompileCache::Misses(void)
+/*Return the number of Compiles that had to compile*/
+{
+  return(MissCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+bool CompileCache::Load(const std::string &FileName, const unsigned long long *Key, TModuleRec *Rec, TSrcTokReference *Ref, TDirectiveViews *Views)
+/*Fill Rec, Ref and Views (if not NULL) from cache file FileName.  Returns False, leaving them alone, if there is no such
+  file or it isn't a whole cache file for Key.*/
+{
+  FILE                   *File;
+  TCacheEntry            Entry;
+  std::vector<byte>      Body;
+  size_t                 Size;
+  const TSrcTokReference *Stored;
+  const char             *Text;
+  int                    Idx;
+
+  if ((File = fopen(FileName.c_str(), "rb")) == NULL) return(False);
+  /*Read and check header, then read the rest, which must be just as long as the header says*/
+  if ( (fread(&Entry, sizeof(Entry), 1, File) != 1) || (Entry.Magic != CacheMagic) || (Entry.FormatVersion != CacheFormatVersion) ||
+       (Entry.Version != TokenizerVersion) || (Entry.Key[0] != Key[0]) || (Entry.Key[1] != Key[1]) ||
+       (Entry.PacketCount > EEPROMSize/16) || (Entry.ReferenceCount < 0) || (Entry.ReferenceCount > SrcTokRefSize) ||
+       (Entry.StringsSize < 0) || (Entry.StringsSize > MaxSourceSize) )
+    {
+    fclose(File);
+    return(False);
+    }
+  Size = EEPROMSize*2 + Entry.PacketCount*PacketSize + Entry.ReferenceCount*sizeof(TSrcTokReference) + Entry.StringsSize;
+  Body.resize(Size+1);
+  Size = (fread(Body.data(), 1, Size+1, File) == Size ? Size : 0);
+  fclose(File);
+  if (Size == 0) return(False);
+  Stored = (const TSrcTokReference *) &Body[EEPROMSize*2 + Entry.PacketCount*PacketSize];
+  Text = (const char *) &Body[Size-Entry.StringsSize];
+  if (!StringOK(&Entry, Text, Entry.ErrorText) || !StringOK(&Entry, Text, Entry.PortText)) return(False);
+  for (Idx = 0; Idx < 7; Idx++)
+    if (!StringOK(&Entry, Text, Entry.ProjectFileText[Idx])) return(False);
+  /*Restore results*/
+  Strings.assign(Text, Text+Entry.StringsSize);
+  Rec->Succeeded = (Entry.Succeeded != 0);
+  Rec->Error = (Entry.ErrorText < 0 ? NULL : &Strings[Entry.ErrorText]);
+  Rec->DebugFlag = (Entry.DebugFlag != 0);
+  Rec->TargetModule = Entry.TargetModule;
+  Rec->TargetStart = Entry.TargetStart;
+  for (Idx = 0; Idx < 7; Idx++)
+    {
+    Rec->ProjectFiles[Idx] = (Entry.ProjectFileText[Idx] < 0 ? NULL : &Strings[Entry.ProjectFileText[Idx]]);
+    Rec->ProjectFilesStart[Idx] = Entry.ProjectFilesStart[Idx];
+    }
+  Rec->Port = (Entry.PortText < 0 ? NULL : &Strings[Entry.PortText]);
+  Rec->PortStart = Entry.PortStart;
+  Rec->LanguageVersion = Entry.LanguageVersion;
+  Rec->LanguageStart = Entry.LanguageStart;
+  Rec->SourceSize = Entry.SourceSize;
+  Rec->ErrorStart = Entry.ErrorStart;
+  Rec->ErrorLength = Entry.ErrorLength;
+  memcpy(Rec->EEPROM, &Body[0], EEPROMSize);
+  memcpy(Rec->EEPROMFlags, &Body[EEPROMSize], EEPROMSize);
+  memcpy(Rec->VarCounts, Entry.VarCounts, sizeof(Rec->VarCounts));
+  Rec->PacketCount = Entry.PacketCount;
+  memcpy(Rec->PacketBuffer, &Body[EEPROMSize*2], Entry.PacketCount*PacketSize);
+  if (Ref != NULL)
+    {
+    memcpy(Ref, Stored, Entry.ReferenceCount*sizeof(TSrcTokReference));
+    memset(&Ref[Entry.ReferenceCount], 0, (SrcTokRefSize-Entry.ReferenceCount)*sizeof(TSrcTokReference));
+    }
+  if (Views != NULL) *Views = Entry.Views;
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void CompileCache::Store(const std::string &FileName, const unsigned long long *Key, bool DirectivesOnly, const TModuleRec *Rec, const TSrcTokReference *Ref, const TDirectiveViews *Views)
+/*Write Rec, Ref and Views to cache file FileName, by way of a temporary file renamed into place.  A DirectivesOnly
+  compile doesn't touch Rec's packets, so none are written for it.  If another process got there first, the rename
+  either replaces its file (POSIX) or fails and the temporary file is removed (Windows); both are harmless since both
+  files hold the results for the same key, and readers see one whole file or the other.  If anything fails, the cache
+  is just left as it was.*/
+{
+  TCacheEntry            Entry;
+  std::vector<char>      Text;
+  std::random_device     Random;
+  std::string            TempName;
+  FILE                   *File;
+  char                   Unique[24];
+  bool                   Written;
+  int                    Idx;
+
+  memset(&Entry, 0, sizeof(Entry));
+  Entry.Magic = CacheMagic;
+  Entry.FormatVersion = CacheFormatVersion;
+  Entry.Version = TokenizerVersion;
+  Entry.Key[0] = Key[0];
+  Entry.Key[1] = Key[1];
+  Entry.SourceSize = Rec->SourceSize;
+  Entry.Succeeded = Rec->Succeeded;
+  Entry.DebugFlag = Rec->DebugFlag;
+  Entry.TargetModule = Rec->TargetModule;
+  Entry.PacketCount = (DirectivesOnly ? 0 : Rec->PacketCount);
+  memcpy(Entry.VarCounts, Rec->VarCounts, sizeof(Entry.VarCounts));
+  Entry.TargetStart = Rec->TargetStart;
+  for (Idx = 0; Idx < 7; Idx++)
+    {
+    Entry.ProjectFilesStart[Idx] = Rec->ProjectFilesStart[Idx];
+    Entry.ProjectFileText[Idx] = AddString(Text, Rec->ProjectFiles[Idx]);
+    }
+  Entry.PortStart = Rec->PortStart;
+  Entry.PortText = AddString(Text, Rec->Port);
+  Entry.LanguageVersion = Rec->LanguageVersion;
+  Entry.LanguageStart = Rec->LanguageStart;
+  Entry.ErrorStart = Rec->ErrorStart;
+  Entry.ErrorLength = Rec->ErrorLength;
+  Entry.ErrorText = AddString(Text, Rec->Error);
+  Entry.Views = *Views;
+  /*Only references up to the last one set are kept; the rest are clear*/
+  for (Entry.ReferenceCount = SrcTokRefSize; Entry.ReferenceCount > 0; Entry.ReferenceCount--)
+    if ((Ref[Entry.ReferenceCount-1].SrcStart != 0) || (Ref[Entry.ReferenceCount-1].TokStart != 0)) break;
+  Entry.StringsSize = (int) Text.size();
+  /*Write temporary file, then rename it into place*/
+  snprintf(Unique, sizeof(Unique), ".%08x%08x.tmp", (unsigned int) Random(), (unsigned int) Random());
+  TempName = FileName + Unique;
+  if ((File = fopen(TempName.c_str(), "wb")) == NULL) return;
+  Written = (fwrite(&Entry, sizeof(Entry), 1, File) == 1) && (fwrite(Rec->EEPROM, 1, EEPROMSize, File) == EEPROMSize) &&
+            (fwrite(Rec->EEPROMFlags, 1, EEPROMSize, File) == EEPROMSize) &&
+            (fwrite(Rec->PacketBuffer, PacketSize, Entry.PacketCount, File) == (size_t) Entry.PacketCount) &&
+            (fwrite(Ref, sizeof(TSrcTokReference), Entry.ReferenceCount, File) == (size_t) Entry.ReferenceCount) &&
+            (Text.empty() || (fwrite(Text.data(), 1, Text.size(), File) == Text.size()));
+  if ((fclose(File) != 0) || !Written || (rename(TempName.c_str(), FileName.c_str()) != 0)) remove(TempName.c_str());
+}
@@ -0,0 +1,140 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_defines.cpp                                                                                                          */
+/*                                                                                                                                               */
+/* PURPOSE:       Compiles one source in several #DEFINE configurations, sharing the compile up to conditional compilation and the results of     */
+/*                configurations that leave the same code.                                                                                       */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include <string.h>
+
+#include <chrono>
+
+#include "tokenizer_pool.hpp"
+#include "tokenizer/tokenizer_defines.hpp"  /* Make sure this is the last include! */
+
+/*------------------------------------------------------------------------------*/
+
+DefineCompiler::DefineCompiler(int ThreadCount)
+{
+  Workers = PoolWorkers(ThreadCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+DefineCompiler::~DefineCompiler() = default;
+
+/*------------------------------------------------------------------------------*/
+
+int DefineCompiler::ThreadCount(void)
+/*Return maximum number of threads*/
+{
+  return(Workers);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI DefineCompiler::Compile(const char *Src, int SrcSize, bool ParseStampDirective, byte TargetModule, const TDefineSet *Sets, int SetCount,
+                               TModuleRec *Results, TSrcTokReference *Refs, int *SharedWith, TDefineStats *Stats)
+/*Compile Src[0..SrcSize-1] (which follows the rules of tokenizer::CompileView, as do ParseStampDirective and
+  TargetModule, which is the target when ParseStampDirective is False) with each of Sets[0..SetCount-1] DEFINE'd into
+  Results[0..SetCount-1].  Refs, if not NULL, is SetCount*SrcTokRefSize references, SrcTokRefSize for each
+  configuration.  SharedWith, if not NULL, is set to the first configuration each one's results are a copy of (itself
+  if they were compiled on their own).  The Results pointer fields are only good until the next Compile.  Stats may be
+  NULL.  Returns True if every configuration compiled successfully, False otherwise.*/
+{
+  std::chrono::steady_clock::time_point     StartTime;
+  std::vector<int>                          Work;
+  std::vector<int>                          Leader;
+  std::vector<char>                         Passed;
+  double                                    FrontSeconds;
+  int                                       Threads;
+  int                                       Compiled;
+  int                                       Succeeded;
+  int                                       Idx;
+  int                                       Other;
+
+  StartTime = std::chrono::steady_clock::now();
+  if (Front == NULL)
+    {
+    Front.reset(new tokenizer);
+    FrontRec.reset(new TModuleRec);
+    }
+  while ((int) Tokenizers.size() < SetCount) Tokenizers.emplace_back(new tokenizer);
+  memset(FrontRec.get(), 0, sizeof(TModuleRec));
+  FrontRec->TargetModule = TargetModule;
+  Leader.resize(SetCount);
+  Passed.assign(SetCount, False);
+  Threads = 0;
+  Compiled = 0;
+  if (!Front->ResolveFrontEnd(FrontRec.get(), Src, SrcSize, ParseStampDirective))
+    { /*Source fails the same way in every configuration*/
+    for (Idx = 0; Idx < SetCount; Idx++)
+      {
+      CopyResults(&Results[Idx], FrontRec.get());
+      if (Refs != NULL) memset(&Refs[Idx*SrcTokRefSize], 0, SrcTokRefSize*sizeof(TSrcTokReference));
+      Leader[Idx] = 0;
+      }
+    }
+  FrontSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+  if (FrontRec->Succeeded)
+    {
+    /*Compile each configuration's conditional-compile directives*/
+    for (Idx = 0; Idx < SetCount; Idx++) Work.push_back(Idx);
+    Threads = RunEach(Workers, (int) Work.size(), [&](int Taken)
+      {
+      int  Set = Work[Taken];
+
+      Passed[Set] = Tokenizers[Set]->CompileConditionals(Front.get(), &Results[Set], Sets[Set].Symbols, Sets[Set].Count, (Refs != NULL ? &Refs[Set*SrcTokRefSize] : NULL));
+      });
+    /*Compile the rest once for each configuration that leaves different code*/
+    Work.clear();
+    for (Idx = 0; Idx < SetCount; Idx++)
+      {
+      Leader[Idx] = Idx;
+      if (!Passed[Idx]) continue;
+      for (Other = 0; Other < Idx; Other++)
+        if ( Passed[Other] && (Leader[Other] == Other) && Tokenizers[Idx]->SameConditionals(Tokenizers[Other].get()) )
+          {
+          Leader[Idx] = Other;
+          break;
+          }
+      if (Leader[Idx] == Idx) Work.push_back(Idx);
+      }
+    Compiled = (int) Work.size();
+    RunEach(Workers, (int) Work.size(), [&](int Taken) { Tokenizers[Work[Taken]]->CompileRemainder(); });
+    for (Idx = 0; Idx < SetCount; Idx++)
+      if (Leader[Idx] != Idx)
+        { /*Share results*/
+        CopyResults(&Results[Idx], &Results[Leader[Idx]]);
+        if (Refs != NULL) memcpy(&Refs[Idx*SrcTokRefSize], &Refs[Leader[Idx]*SrcTokRefSize], SrcTokRefSize*sizeof(TSrcTokReference));
+        }
+    }
+  Succeeded = 0;
+  for (Idx = 0; Idx < SetCount; Idx++)
+    {
+    if (Results[Idx].Succeeded) Succeeded++;
+    if (SharedWith != NULL) SharedWith[Idx] = Leader[Idx];
+    }
+  if (Stats != NULL)
+    {
+    Stats->SetCount = SetCount;
+    Stats->Succeeded = Succeeded;
+    Stats->Compiled = Compiled;
+    Stats->ThreadCount = Threads;
+    Stats->FrontSeconds = FrontSeconds;
+    Stats->Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+    }
+  return(Succeeded == SetCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void DefineCompiler::CopyResults(TModuleRec *Rec, const TModuleRec *From)
+/*Set Rec to From's results, with its Error pointing into Rec's own PacketBuffer if From's did*/
+{
+  *Rec = *From;
+  if ( (From->Error != NULL) && (From->Error >= (char *)From->PacketBuffer) && (From->Error < (char *)From->PacketBuffer+sizeof(TPacketType)) )
+    Rec->Error = (char *)Rec->PacketBuffer + (From->Error-(char *)From->PacketBuffer);
+}
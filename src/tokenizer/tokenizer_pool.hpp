@@ -0,0 +1,59 @@
+#ifndef __TOKENIZER_POOL_H__
+#define __TOKENIZER_POOL_H__
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*The worker thread pool shared by the batch, project, target and define compilers (internal to the library).  Each
+  call starts its threads afresh; the calling thread is always one of the workers.*/
+
+/*------------------------------------------------------------------------------*/
+
+inline int PoolWorkers(int ThreadCount)
+/*Return the maximum number of worker threads for a compiler constructed with ThreadCount (0 = one per hardware thread)*/
+{
+  int  Workers;
+
+  Workers = ThreadCount;
+  if (Workers <= 0) Workers = (int) std::thread::hardware_concurrency();
+  if (Workers <= 0) Workers = 1;
+  return(Workers);
+}
+
+/*------------------------------------------------------------------------------*/
+
+template <typename TWorker>
+void RunWorkers(int Threads, TWorker Worker)
+/*Call Worker(WorkerIdx) for each WorkerIdx of 0..Threads-1, each on its own thread; the calling thread is worker 0 (and
+  runs even if Threads is 0).  Returns once every worker has.*/
+{
+  int                       Idx;
+  std::vector<std::thread>  Pool;
+
+  for (Idx = 1; Idx < Threads; Idx++) Pool.emplace_back(Worker, Idx);
+  Worker(0);
+  for (auto &Thread : Pool) Thread.join();
+}
+
+/*------------------------------------------------------------------------------*/
+
+template <typename TTask>
+int RunEach(int Workers, int Count, TTask Task)
+/*Call Task(Idx) for each Idx of 0..Count-1, in order of Idx, on up to Workers threads, the calling thread included;
+  each worker takes the next Idx as it finishes the last.  Returns the number of threads used.*/
+{
+  int               Threads;
+  std::atomic<int>  Next(0);
+
+  Threads = (Count < Workers ? Count : Workers);
+  RunWorkers(Threads, [&](int)
+    {
+    int  Taken;
+
+    while ((Taken = Next++) < Count) Task(Taken);
+    });
+  return(Threads);
+}
+
+#endif
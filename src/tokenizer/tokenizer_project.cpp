@@ -0,0 +1,159 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_project.cpp                                                                                                          */
+/*                                                                                                                                               */
+/* PURPOSE:       Compiles the program slots of a BS2e/BS2sx/BS2p/BS2pe multi-file project at once, one tokenizer object per slot.               */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "tokenizer_pool.hpp"
+#include "tokenizer/tokenizer_project.hpp"  /* Make sure this is the last include! */
+
+/*------------------------------------------------------------------------------*/
+
+ProjectCompiler::ProjectCompiler(int ThreadCount)
+{
+  Workers = PoolWorkers(ThreadCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+ProjectCompiler::~ProjectCompiler() = default;
+
+/*------------------------------------------------------------------------------*/
+
+int ProjectCompiler::ThreadCount(void)
+/*Return maximum number of threads*/
+{
+  return(Workers);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI ProjectCompiler::Compile(const char *Src, int SrcSize, TProjectLoader Loader, void *Context, TProjectSlot *Slots, TSrcTokReference *Refs, TProjectStats *Stats)
+/*Compile the project whose main source is Src[0..SrcSize-1] (which follows the rules of tokenizer::CompileView) into
+  Slots[0..SlotCount-1], where SlotCount is 1 plus the number of project files; Slots must have room for
+  ProjectSlotCount.  Refs, if not NULL, is ProjectSlotCount*SrcTokRefSize references, SrcTokRefSize for each slot.
+  The Rec pointer fields and FileNames are only good until the next Compile.  Stats may be NULL.  Returns True if every
+  slot loaded and compiled successfully, False otherwise.*/
+{
+  std::string                               Names[ProjectSlotCount];
+  std::chrono::steady_clock::time_point     StartTime;
+  double                                    Seconds;
+  int                                       SlotCount;
+  int                                       Count;
+  int                                       ThreadsUsed;
+  int                                       Succeeded;
+  int                                       Idx;
+  byte                                      Target;
+  bool                                      Same;
+
+  StartTime = std::chrono::steady_clock::now();
+  while ((int) Tokenizers.size() < ProjectSlotCount) Tokenizers.emplace_back(new tokenizer);
+  Sources.resize(ProjectSlotCount);
+  /*Find the project files from the editor directives at the head of the main source, so all slots can start at once*/
+  memset(&Slots[0].Rec, 0, sizeof(TModuleRec));
+  SlotCount = (Tokenizers[0]->ProbeDirectives(&Slots[0].Rec, Src, SrcSize, NULL) ? FindProjectFiles(&Slots[0].Rec, FileNames) : 1);
+  Target = Slots[0].Rec.TargetModule;
+  ThreadsUsed = 0;
+  CompileSlots(Src, SrcSize, 0, SlotCount, Target, Loader, Context, Slots, Refs, &ThreadsUsed);
+  /*ProbeDirectives doesn't see a $STAMP directive after code; if the whole main source named other project files (or
+    another target), compile those instead*/
+  if (Slots[0].Rec.Succeeded)
+    {
+    Count = FindProjectFiles(&Slots[0].Rec, Names);
+    Same = (Count == SlotCount) && ((SlotCount == 1) || (Target == Slots[0].Rec.TargetModule));
+    for (Idx = 1; Same && (Idx < Count); Idx++) Same = (Names[Idx] == FileNames[Idx]);
+    if (!Same)
+      {
+      SlotCount = Count;
+      for (Idx = 1; Idx < Count; Idx++) FileNames[Idx] = Names[Idx];
+      CompileSlots(Src, SrcSize, 1, SlotCount, Slots[0].Rec.TargetModule, Loader, Context, Slots, Refs, &ThreadsUsed);
+      }
+    }
+  Succeeded = 0;
+  for (Idx = 0; Idx < SlotCount; Idx++)
+    if (Slots[Idx].Loaded && Slots[Idx].Rec.Succeeded) Succeeded++;
+  Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+  if (Stats != NULL)
+    {
+    Stats->SlotCount = SlotCount;
+    Stats->Succeeded = Succeeded;
+    Stats->ThreadCount = ThreadsUsed;
+    Stats->Seconds = Seconds;
+    }
+  return(Succeeded == SlotCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+int ProjectCompiler::FindProjectFiles(const TModuleRec *Rec, std::string *Names)
+/*Set Names[1..] to the project files Rec's $STAMP directive named and return the number of slots they make (1 if the
+  target isn't multi-file capable)*/
+{
+  int  Count;
+
+  if (!IsMultiFileCapable(Rec->TargetModule)) return(1);
+  for (Count = 1; (Count < ProjectSlotCount) && (Rec->ProjectFiles[Count-1] != NULL); Count++) Names[Count] = Rec->ProjectFiles[Count-1];
+  return(Count);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void ProjectCompiler::CompileSlots(const char *Src, int SrcSize, int First, int SlotCount, byte TargetModule, TProjectLoader Loader, void *Context,
+                                   TProjectSlot *Slots, TSrcTokReference *Refs, int *ThreadsUsed)
+/*Load the project files of slots First..SlotCount-1 (slot 0 is Src), then compile them on up to ThreadCount() threads,
+  largest first, the project files for TargetModule.  Raises *ThreadsUsed to the number of threads used.*/
+{
+  int                       Order[ProjectSlotCount];
+  int                       Sizes[ProjectSlotCount];
+  int                       Count;
+  int                       Threads;
+  int                       Idx;
+
+  /*Load project files*/
+  Count = 0;
+  for (Idx = First; Idx < SlotCount; Idx++)
+    {
+    Slots[Idx].FileName = (Idx == 0 ? NULL : FileNames[Idx].c_str());
+    Slots[Idx].Loaded = True;
+    Sizes[Idx] = SrcSize;
+    if (Idx > 0)
+      {
+      if (Sources[Idx].empty()) Sources[Idx].resize(MaxSourceSize);
+      Sizes[Idx] = -1;
+      Slots[Idx].Loaded = (Loader != NULL) && Loader(Context, Slots[Idx].FileName, Sources[Idx].data(), &Sizes[Idx]) &&
+                          (Sizes[Idx] >= 0) && (Sizes[Idx] < MaxSourceSize);
+      if (!Slots[Idx].Loaded)
+        { /*Couldn't load; fail the slot*/
+        memset(&Slots[Idx].Rec, 0, sizeof(TModuleRec));
+        continue;
+        }
+      }
+    Order[Count++] = Idx;
+    }
+  std::stable_sort(Order, Order+Count, [&](int A, int B) { return(Sizes[A] > Sizes[B]); });
+
+  Threads = RunEach(Workers, Count, [&](int Taken)
+    {
+    TModuleRec *Rec;
+    int        Slot;
+
+    Slot = Order[Taken];
+    Rec = &Slots[Slot].Rec;
+    if (Slot == 0)
+      Tokenizers[0]->CompileView(Rec, Src, SrcSize, False, True, Refs, NULL);
+    else
+      {
+      memset(Rec, 0, sizeof(TModuleRec));
+      Rec->TargetModule = TargetModule;
+      Tokenizers[Slot]->CompileView(Rec, Sources[Slot].data(), Sizes[Slot], False, False, (Refs != NULL ? &Refs[Slot*SrcTokRefSize] : NULL), NULL);
+      }
+    });
+  if (Threads > *ThreadsUsed) *ThreadsUsed = Threads;
+}
@@ -0,0 +1,89 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_session.cpp                                                                                                          */
+/*                                                                                                                                               */
+/* PURPOSE:       Keeps a PBASIC source open for editing and recompiles it incrementally after each edit.                                        */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include "tokenizer/tokenizer_session.hpp"
+
+/*------------------------------------------------------------------------------*/
+
+CompileSession::CompileSession()
+{
+  ParseStamp = True;
+  Target = tmNone;
+}
+
+/*------------------------------------------------------------------------------*/
+
+CompileSession::~CompileSession() = default;
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI CompileSession::Open(const char *Src, int SrcSize, bool ParseStampDirective, byte TargetModule)
+/*Start a session with Src[0..SrcSize-1] (SrcSize must be less than MaxSourceSize).  ParseStampDirective and
+  TargetModule are as for tokenizer::CompileView; TargetModule is used only if ParseStampDirective is False.  Any source
+  already open is dropped.  Returns False if Src won't fit or we're out of memory.*/
+{
+  if ((SrcSize < 0) || (SrcSize >= MaxSourceSize)) return(False);
+  if (Tokenizer == nullptr) Tokenizer = std::make_unique<tokenizer>();
+  if (!Tokenizer->SetIncremental(True)) return(False);
+  Buffer.assign(Src, Src+SrcSize);
+  ParseStamp = ParseStampDirective;
+  Target = TargetModule;
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI CompileSession::Edit(int Offset, int RemovedLength, const char *Text, int TextLength)
+/*Replace the RemovedLength characters of the source at Offset with Text[0..TextLength-1].  Returns False, leaving the
+  source alone, if the removed characters aren't all in the source or the result won't fit in MaxSourceSize.*/
+{
+  if ( (Offset < 0) || (RemovedLength < 0) || (TextLength < 0) || (Offset > SourceSize()-RemovedLength) ||
+       (SourceSize()-RemovedLength+TextLength >= MaxSourceSize) ) return(False);
+  Buffer.erase(Buffer.begin()+Offset, Buffer.begin()+Offset+RemovedLength);
+  Buffer.insert(Buffer.begin()+Offset, Text, Text+TextLength);
+  return(True);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI CompileSession::Compile(TModuleRec *Rec, TSrcTokReference *Ref, TDirectiveViews *Views)
+/*Compile the source as it now stands into Rec, as tokenizer::CompileView would.  Ref and Views may be NULL.  Returns
+  True if successful, False otherwise (or if no source is open).*/
+{
+  if (Tokenizer == nullptr) return(False);
+  if (!ParseStamp) Rec->TargetModule = Target;
+  return(Tokenizer->CompileView(Rec, Buffer.data(), SourceSize(), False, ParseStamp, Ref, Views));
+}
+
+/*------------------------------------------------------------------------------*/
+
+const char *CompileSession::Source(void)
+/*Return the source as it now stands (not terminated)*/
+{
+  return(Buffer.data());
+}
+
+/*------------------------------------------------------------------------------*/
+
+int CompileSession::SourceSize(void)
+/*Return the length of the source as it now stands*/
+{
+  return((int) Buffer.size());
+}
+
+/*------------------------------------------------------------------------------*/
+
+#if defined(CompileStatistics)
+STDAPI CompileSession::GetCompileStats(TCompileStats *Stats)
+/*Sets Stats to the phase times and counts of the last Compile (see tokenizer::GetCompileStats).  Returns False if
+  nothing has been compiled.*/
+{
+  if (Tokenizer == nullptr) return(False);
+  return(Tokenizer->GetCompileStats(Stats));
+}
+#endif
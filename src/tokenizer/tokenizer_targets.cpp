@@ -0,0 +1,97 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_targets.cpp                                                                                                          */
+/*                                                                                                                                               */
+/* PURPOSE:       Compiles one source for several target modules, sharing the front end of the compile and running the rest per target at once.  */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include <string.h>
+
+#include <chrono>
+
+#include "tokenizer_pool.hpp"
+#include "tokenizer/tokenizer_targets.hpp"  /* Make sure this is the last include! */
+
+/*------------------------------------------------------------------------------*/
+
+TargetCompiler::TargetCompiler(int ThreadCount)
+{
+  Workers = PoolWorkers(ThreadCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+TargetCompiler::~TargetCompiler() = default;
+
+/*------------------------------------------------------------------------------*/
+
+int TargetCompiler::ThreadCount(void)
+/*Return maximum number of threads*/
+{
+  return(Workers);
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI TargetCompiler::Compile(const char *Src, int SrcSize, const byte *Targets, int TargetCount, TModuleRec *Results, TSrcTokReference *Refs, TTargetStats *Stats)
+/*Compile Src[0..SrcSize-1] (which follows the rules of tokenizer::CompileView) for each of Targets[0..TargetCount-1]
+  into Results[0..TargetCount-1].  Refs, if not NULL, is TargetCount*SrcTokRefSize references, SrcTokRefSize for each
+  target.  The Results pointer fields are only good until the next Compile.  Stats may be NULL.  Returns True if the
+  source compiled successfully for every target, False otherwise.*/
+{
+  std::chrono::steady_clock::time_point     StartTime;
+  double                                    FrontSeconds;
+  int                                       Threads;
+  int                                       Succeeded;
+  int                                       Idx;
+
+  StartTime = std::chrono::steady_clock::now();
+  if (Front == NULL)
+    {
+    Front.reset(new tokenizer);
+    FrontRec.reset(new TModuleRec);
+    }
+  while ((int) Tokenizers.size() < TargetCount) Tokenizers.emplace_back(new tokenizer);
+  memset(FrontRec.get(), 0, sizeof(TModuleRec));
+  FrontRec->TargetModule = (TargetCount > 0 ? Targets[0] : (byte) tmNone);
+  Threads = 0;
+  if (!Front->CompileFrontEnd(FrontRec.get(), Src, SrcSize))
+    { /*Source fails the same way for every target*/
+    for (Idx = 0; Idx < TargetCount; Idx++)
+      {
+      CopyFailure(&Results[Idx], Targets[Idx]);
+      if (Refs != NULL) memset(&Refs[Idx*SrcTokRefSize], 0, SrcTokRefSize*sizeof(TSrcTokReference));
+      }
+    }
+  FrontSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+  if (FrontRec->Succeeded)
+    Threads = RunEach(Workers, TargetCount, [&](int Taken)
+      {
+      Tokenizers[Taken]->CompileBackEnd(Front.get(), &Results[Taken], Targets[Taken], (Refs != NULL ? &Refs[Taken*SrcTokRefSize] : NULL));
+      });
+  Succeeded = 0;
+  for (Idx = 0; Idx < TargetCount; Idx++)
+    if (Results[Idx].Succeeded) Succeeded++;
+  if (Stats != NULL)
+    {
+    Stats->TargetCount = TargetCount;
+    Stats->Succeeded = Succeeded;
+    Stats->ThreadCount = Threads;
+    Stats->FrontSeconds = FrontSeconds;
+    Stats->Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+    }
+  return(Succeeded == TargetCount);
+}
+
+/*------------------------------------------------------------------------------*/
+
+void TargetCompiler::CopyFailure(TModuleRec *Rec, byte TargetModule)
+/*Set Rec to the front end's failed results, for TargetModule, with its Error pointing into Rec's own PacketBuffer if
+  the front end's did*/
+{
+  *Rec = *FrontRec;
+  Rec->TargetModule = TargetModule;
+  if ( (FrontRec->Error != NULL) && (FrontRec->Error >= (char *)FrontRec->PacketBuffer) && (FrontRec->Error < (char *)FrontRec->PacketBuffer+sizeof(TPacketType)) )
+    Rec->Error = (char *)Rec->PacketBuffer + (FrontRec->Error-(char *)FrontRec->PacketBuffer);
+}
@@ -0,0 +1,81 @@
+/*************************************************************************************************************************************************/
+/* FILE:          tokenizer_trace.cpp                                                                                                            */
+/*                                                                                                                                               */
+/* PURPOSE:       Writes compile traces recorded by tokenizer::SetTrace as Chrome trace-event JSON.                                              */
+/*                                                                                                                                               */
+/* TERMS OF USE:  MIT License (see tokenizer.cpp)                                                                                                */
+/*************************************************************************************************************************************************/
+
+#include <stdio.h>
+
+#include "tokenizer/tokenizer_trace.hpp"
+
+#if defined(CompileStatistics)
+
+/*------------------------------------------------------------------------------*/
+
+static const char *InstructionName(int Value)
+/*Return the reserved word of instruction type Value, or "LET" if Value is -1 (an assignment)*/
+{
+  int Idx;
+
+  if (Value < 0) return("LET");
+  for (Idx = 0; Idx < CommonSymbolTableSize; Idx++)
+    if ((CommonSymbols[Idx].ElementType == etInstruction) && (CommonSymbols[Idx].Value == Value)) return(CommonSymbols[Idx].Name);
+  for (Idx = 0; Idx < CustomSymbolTableSize; Idx++)
+    if ((CustomSymbols[Idx].Symbol.ElementType == etInstruction) && (CustomSymbols[Idx].Symbol.Value == Value)) return(CustomSymbols[Idx].Symbol.Name);
+  return("?");
+}
+
+/*------------------------------------------------------------------------------*/
+
+STDAPI WriteTraceFile(const char *FileName, const TCompileTrace *Traces, int TraceCount)
+/*Write Traces to FileName.  Span times are given in microseconds from the earliest span of all the traces.*/
+{
+  FILE              *File;
+  const TTraceEvent *Event;
+  const char        *Name;
+  const char        *Category;
+  long long         Origin;
+  int               Trace;
+  int               Idx;
+  bool              First;
+
+  if ((File = fopen(FileName, "w")) == NULL) return(False);
+  /*Find earliest span*/
+  Origin = 0;
+  First = True;
+  for (Trace = 0; Trace < TraceCount; Trace++)
+    for (Idx = 0; Idx < Traces[Trace].Count; Idx++)
+      if (First || (Traces[Trace].Events[Idx].Start < Origin))
+        {
+        Origin = Traces[Trace].Events[Idx].Start;
+        First = False;
+        }
+  fprintf(File, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  First = True;
+  for (Trace = 0; Trace < TraceCount; Trace++)
+    { /*Name the thread, then list its spans*/
+    fprintf(File, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"tokenizer %d\",\"dropped\":%d}}",
+            (First ? "" : ",\n"), Trace, Trace, Traces[Trace].Dropped);
+    First = False;
+    for (Idx = 0; Idx < Traces[Trace].Count; Idx++)
+      {
+      Event = &Traces[Trace].Events[Idx];
+      switch (Event->Kind)
+        {
+        case tkCompile : Name = "Compile"; Category = "compile"; break;
+        case tkPhase   : Name = ((Event->Value >= 0) && (Event->Value < cpNumElements) ? CompilePhases[Event->Value] : "?"); Category = "phase"; break;
+        default        : Name = InstructionName(Event->Value); Category = "instruction"; break;
+        }
+      fprintf(File, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+              Name, Category, Trace, (Event->Start - Origin) / 1000.0, Event->Duration / 1000.0);
+      if (Event->SrcLength > 0) fprintf(File, ",\"args\":{\"src_start\":%d,\"src_length\":%d}", Event->SrcStart, Event->SrcLength);
+      fprintf(File, "}");
+      }
+    }
+  fprintf(File, "\n]}\n");
+  return(fclose(File) == 0);
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "tokenizer/tokenizer_batch.hpp"
+
+namespace
+{
+
+const char *CounterSource =
+    "' {$STAMP BS2}\r"
+    "' {$PBASIC 2.5}\r"
+    "idx VAR Nib\r"
+    "FOR idx = 0 TO 7\r"
+    "  TOGGLE idx\r"
+    "  PAUSE 100\r"
+    "NEXT\r"
+    "END\r";
+
+const char *NoStampSource =
+    "x VAR Word\r"
+    "x = x + 1\r"
+    "END\r";
+
+const char *BrokenSource =
+    "' {$STAMP BS2}\r"
+    "GOTO Nowhere\r";
+
+std::vector<char> MakeBuffer(const char *Src)
+{
+  std::vector<char> Buffer(MaxSourceSize, 0);
+  std::memcpy(Buffer.data(), Src, std::strlen(Src));
+  return Buffer;
+}
+
+TBatchJob MakeJob(std::vector<char> &Buffer, const char *Src)
+{
+  TBatchJob Job;
+  std::memset(&Job, 0, sizeof(Job));
+  Job.Source = Buffer.data();
+  Job.SourceSize = (int) std::strlen(Src);
+  Job.ParseStampDirective = True;
+  return Job;
+}
+
+}  // namespace
+
+TEST(BatchTests, MatchesSerialCompile)
+{
+  const int JobCount = 64;
+  const char *Sources[3] = {CounterSource, NoStampSource, BrokenSource};
+  std::vector<std::vector<char>> Buffers;
+  std::vector<TBatchJob> Jobs;
+  std::vector<TModuleRec> Results(JobCount);
+  TBatchStats Stats;
+
+  for (int Idx = 0; Idx < JobCount; Idx++)
+    Buffers.push_back(MakeBuffer(Sources[Idx % 3]));
+  for (int Idx = 0; Idx < JobCount; Idx++)
+    {
+    Jobs.push_back(MakeJob(Buffers[Idx], Sources[Idx % 3]));
+    if (Idx % 3 == 1)
+      { /*No $STAMP directive; override the target instead*/
+      Jobs.back().ParseStampDirective = False;
+      Jobs.back().TargetModule = tmBS2p;
+      }
+    }
+
+  BatchCompiler Batch(4);
+  EXPECT_FALSE(Batch.Compile(Jobs.data(), Results.data(), JobCount, &Stats));
+  EXPECT_EQ(Stats.JobCount, JobCount);
+  EXPECT_EQ(Stats.ThreadCount, 4);
+  EXPECT_GT(Stats.JobsPerSecond, 0);
+
+  tokenizer Serial;
+  int Succeeded = 0;
+  for (int Idx = 0; Idx < JobCount; Idx++)
+    {
+    auto Expected = std::make_unique<TModuleRec>();
+    std::vector<char> Buffer = MakeBuffer(Sources[Idx % 3]);
+    std::memset(Expected.get(), 0, sizeof(TModuleRec));
+    Expected->SourceSize = Jobs[Idx].SourceSize;
+    if (!Jobs[Idx].ParseStampDirective) Expected->TargetModule = Jobs[Idx].TargetModule;
+    Serial.Compile(Expected.get(), Buffer.data(), False, Jobs[Idx].ParseStampDirective, NULL);
+
+    EXPECT_EQ(Results[Idx].Succeeded, Expected->Succeeded) << "job " << Idx;
+    EXPECT_EQ(Results[Idx].TargetModule, Expected->TargetModule) << "job " << Idx;
+    EXPECT_EQ(std::memcmp(Results[Idx].EEPROM, Expected->EEPROM, EEPROMSize), 0) << "job " << Idx;
+    if (Expected->Succeeded) Succeeded++;
+    }
+  EXPECT_EQ(Stats.Succeeded, Succeeded);
+  EXPECT_EQ(Succeeded, 2 * JobCount / 3 + 1);
+}
+
+TEST(BatchTests, SharedSource)
+{
+  const int JobCount = 16;
+  std::vector<TBatchJob> Jobs(JobCount);
+  std::vector<TModuleRec> Results(JobCount);
+  std::vector<TDirectiveViews> Views(JobCount);
+
+  /*Every job compiles the same read-only source*/
+  for (int Idx = 0; Idx < JobCount; Idx++)
+    {
+    std::memset(&Jobs[Idx], 0, sizeof(TBatchJob));
+    Jobs[Idx].SharedSource = CounterSource;
+    Jobs[Idx].SourceSize = (int) std::strlen(CounterSource);
+    Jobs[Idx].ParseStampDirective = True;
+    Jobs[Idx].Views = &Views[Idx];
+    }
+
+  BatchCompiler Batch(4);
+  EXPECT_TRUE(Batch.Compile(Jobs.data(), Results.data(), JobCount, NULL));
+  for (int Idx = 1; Idx < JobCount; Idx++)
+    EXPECT_EQ(std::memcmp(Results[Idx].EEPROM, Results[0].EEPROM, EEPROMSize), 0) << "job " << Idx;
+}
+
+TEST(BatchTests, DirectivesOnly)
+{
+  std::vector<char> Buffer = MakeBuffer(BrokenSource);
+  TBatchJob Job = MakeJob(Buffer, BrokenSource);
+  auto Result = std::make_unique<TModuleRec>();
+
+  Job.DirectivesOnly = True;
+  BatchCompiler Batch;
+  EXPECT_TRUE(Batch.Compile(&Job, Result.get(), 1, NULL));
+  EXPECT_EQ(Result->TargetModule, tmBS2);
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_cache.hpp"
+
+namespace
+{
+
+const char *Program =
+    "' {$STAMP BS2}\r"
+    "' {$PBASIC 2.5}\r"
+    "' {$PORT COM3}\r"
+    "idx VAR Byte\r"
+    "Table DATA 1, 2, WORD 300\r"
+    "FOR idx = 0 TO 9\r"
+    "  DEBUG DEC idx, CR\r"
+    "NEXT\r"
+    "END\r";
+
+/* A fresh, empty cache directory for each test */
+class CacheTests : public ::testing::Test
+{
+protected:
+  std::filesystem::path Directory;
+
+  void SetUp() override
+  {
+    Directory = std::filesystem::temp_directory_path() /
+                ("tokenizer_cache_test_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+    std::filesystem::remove_all(Directory);
+    std::filesystem::create_directories(Directory);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(Directory); }
+
+  int FileCount()
+  {
+    int Count = 0;
+    for (auto &Entry : std::filesystem::directory_iterator(Directory)) Count += (Entry.path().extension() == ".pbc");
+    return Count;
+  }
+};
+
+void ExpectSameResults(const TModuleRec &A, const TModuleRec &B)
+{
+  EXPECT_EQ(A.Succeeded, B.Succeeded);
+  EXPECT_EQ(A.Error == NULL, B.Error == NULL);
+  if ((A.Error != NULL) && (B.Error != NULL))
+    {
+    EXPECT_STREQ(A.Error, B.Error);
+    }
+  EXPECT_EQ(A.TargetModule, B.TargetModule);
+  EXPECT_EQ(A.LanguageVersion, B.LanguageVersion);
+  EXPECT_STREQ(A.Port, B.Port);
+  EXPECT_EQ(A.PortStart, B.PortStart);
+  EXPECT_EQ(A.ErrorStart, B.ErrorStart);
+  EXPECT_EQ(A.ErrorLength, B.ErrorLength);
+  EXPECT_EQ(std::memcmp(A.EEPROM, B.EEPROM, EEPROMSize), 0);
+  EXPECT_EQ(std::memcmp(A.EEPROMFlags, B.EEPROMFlags, EEPROMSize), 0);
+  EXPECT_EQ(std::memcmp(A.VarCounts, B.VarCounts, sizeof(A.VarCounts)), 0);
+  EXPECT_EQ(A.PacketCount, B.PacketCount);
+  EXPECT_EQ(std::memcmp(A.PacketBuffer, B.PacketBuffer, A.PacketCount * 18), 0);
+}
+
+}  // namespace
+
+TEST_F(CacheTests, HitMatchesCompile)
+{
+  CompileCache Cache(Directory.string().c_str());
+  tokenizer t;
+  auto Fresh = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<TSrcTokReference> FreshRef(SrcTokRefSize), Ref(SrcTokRefSize, TSrcTokReference{1, 1});
+  TDirectiveViews FreshViews, Views;
+  int Size = (int) std::strlen(Program);
+
+  std::memset(Fresh.get(), 0, sizeof(TModuleRec));
+  ASSERT_TRUE(t.CompileView(Fresh.get(), Program, Size, False, True, FreshRef.data(), &FreshViews)) << Fresh->Error;
+
+  /* A miss compiles (without references or views) and stores; a second cache on the same directory then hits */
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  ASSERT_TRUE(Cache.Compile(Rec.get(), Program, Size, False, True, NULL, NULL));
+  EXPECT_EQ(Cache.Misses(), 1);
+  EXPECT_EQ(FileCount(), 1);
+  CompileCache Other(Directory.string().c_str());
+  std::memset(Rec.get(), 0xA5, sizeof(TModuleRec));
+  ASSERT_TRUE(Other.Compile(Rec.get(), Program, Size, False, True, Ref.data(), &Views));
+  EXPECT_EQ(Other.Hits(), 1);
+  EXPECT_EQ(Other.Misses(), 0);
+  ExpectSameResults(*Rec, *Fresh);
+  EXPECT_EQ(Rec->SourceSize, Size);
+  EXPECT_EQ(std::memcmp(Ref.data(), FreshRef.data(), SrcTokRefSize * sizeof(TSrcTokReference)), 0);
+  EXPECT_EQ(Views.Port.Start, FreshViews.Port.Start);
+  EXPECT_EQ(Views.Port.Length, FreshViews.Port.Length);
+
+  /* Failures are cached as well */
+  std::string Broken = std::string(Program) + "GOTO Nowhere\r";
+  std::memset(Fresh.get(), 0, sizeof(TModuleRec));
+  ASSERT_FALSE(t.CompileView(Fresh.get(), Broken.data(), (int) Broken.size(), False, True, NULL, NULL));
+  for (int Pass = 0; Pass < 2; Pass++)
+    {
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    EXPECT_FALSE(Cache.Compile(Rec.get(), Broken.data(), (int) Broken.size(), False, True, NULL, NULL));
+    ExpectSameResults(*Rec, *Fresh);
+    }
+  EXPECT_EQ(Cache.Hits(), 1);
+  EXPECT_EQ(Cache.Misses(), 2);
+}
+
+TEST_F(CacheTests, KeyedByInputs)
+{
+  CompileCache Cache(Directory.string().c_str());
+  auto Rec = std::make_unique<TModuleRec>();
+  const char *Src = "x VAR Word\rx = x + 1\rEND\r";
+  int Size = (int) std::strlen(Src);
+
+  /* Each target module, and directives only, is its own entry */
+  for (byte Target : {tmBS2, tmBS2e, tmBS2})
+    {
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    Rec->TargetModule = Target;
+    EXPECT_TRUE(Cache.Compile(Rec.get(), Src, Size, False, False, NULL, NULL)) << Rec->Error;
+    EXPECT_EQ(Rec->TargetModule, Target);
+    }
+  EXPECT_TRUE(Cache.Compile(Rec.get(), Src, Size, True, False, NULL, NULL));
+  EXPECT_EQ(Cache.Hits(), 1);
+  EXPECT_EQ(FileCount(), 3);
+}
+
+TEST_F(CacheTests, DamagedFileIsMiss)
+{
+  CompileCache Cache(Directory.string().c_str());
+  auto Rec = std::make_unique<TModuleRec>();
+  int Size = (int) std::strlen(Program);
+
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  ASSERT_TRUE(Cache.Compile(Rec.get(), Program, Size, False, True, NULL, NULL));
+  for (auto &Entry : std::filesystem::directory_iterator(Directory))
+    std::filesystem::resize_file(Entry.path(), std::filesystem::file_size(Entry.path()) - 1);
+  ASSERT_TRUE(Cache.Compile(Rec.get(), Program, Size, False, True, NULL, NULL));
+  EXPECT_EQ(Cache.Misses(), 2);
+  ASSERT_TRUE(Cache.Compile(Rec.get(), Program, Size, False, True, NULL, NULL));
+  EXPECT_EQ(Cache.Hits(), 1);
+}
+
+TEST_F(CacheTests, DirectivesOnlyIgnoresStalePackets)
+{
+  CompileCache Cache(Directory.string().c_str());
+  auto Rec = std::make_unique<TModuleRec>();
+  int Size = (int) std::strlen(Program);
+
+  /* A directives-only compile leaves whatever packet count the caller's record held; it mustn't reach the cache file */
+  for (int Pass = 0; Pass < 2; Pass++)
+    {
+    std::memset(Rec.get(), 0xA5, sizeof(TModuleRec));
+    ASSERT_TRUE(Cache.Compile(Rec.get(), Program, Size, True, True, NULL, NULL));
+    EXPECT_EQ(Rec->LanguageVersion, 250);
+    }
+  EXPECT_EQ(Cache.Misses(), 1);
+  EXPECT_EQ(Cache.Hits(), 1);
+  EXPECT_EQ(Rec->PacketCount, 0);
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+
+namespace
+{
+
+const char *BlinkSource =
+    "' {$STAMP BS2}\r"
+    "' {$PBASIC 2.5}\r"
+    "LED     PIN  0\r"
+    "Delay   CON  250\r"
+    "counter VAR  Byte\r"
+    "Main:\r"
+    "  FOR counter = 1 TO 10\r"
+    "    HIGH LED\r"
+    "    PAUSE Delay\r"
+    "    LOW LED\r"
+    "    DEBUG DEC counter, CR\r"
+    "  NEXT\r"
+    "  GOTO Main\r";
+
+/* Compile Src into Rec using a private source buffer, as a caller would */
+bool CompileInto(tokenizer &t, TModuleRec &Rec, const char *Src)
+{
+  std::vector<char> Buffer(MaxSourceSize, 0);
+  std::memcpy(Buffer.data(), Src, std::strlen(Src));
+  std::memset(&Rec, 0, sizeof(TModuleRec));
+  Rec.SourceSize = (int) std::strlen(Src);
+  return t.Compile(&Rec, Buffer.data(), False, True, NULL);
+}
+
+}  // namespace
+
+TEST(ConcurrencyTests, InstancesCompileIndependently)
+{
+  auto Expected = std::make_unique<TModuleRec>();
+  auto t = std::make_unique<tokenizer>();
+  ASSERT_TRUE(CompileInto(*t, *Expected, BlinkSource));
+  ASSERT_EQ(Expected->TargetModule, tmBS2);
+  ASSERT_GT(Expected->PacketCount, 0);
+
+  const int ThreadCount = 8;
+  const int Iterations = 25;
+  std::vector<int> Mismatches(ThreadCount, 0);
+  std::vector<std::thread> Threads;
+
+  for (int Idx = 0; Idx < ThreadCount; Idx++)
+    Threads.emplace_back([&, Idx]() {
+      auto Local = std::make_unique<tokenizer>();
+      auto Rec = std::make_unique<TModuleRec>();
+      for (int Pass = 0; Pass < Iterations; Pass++)
+        {
+        if (!CompileInto(*Local, *Rec, BlinkSource) ||
+            (Rec->PacketCount != Expected->PacketCount) ||
+            (std::memcmp(Rec->EEPROM, Expected->EEPROM, EEPROMSize) != 0) ||
+            (std::memcmp(Rec->VarCounts, Expected->VarCounts, sizeof(Rec->VarCounts)) != 0))
+          Mismatches[Idx]++;
+        }
+    });
+  for (auto &Thread : Threads) Thread.join();
+
+  for (int Idx = 0; Idx < ThreadCount; Idx++) EXPECT_EQ(Mismatches[Idx], 0) << "thread " << Idx;
+}
+
+TEST(ConcurrencyTests, ErrorsStayWithTheirInstance)
+{
+  auto Good = std::make_unique<tokenizer>();
+  auto Bad = std::make_unique<tokenizer>();
+  auto GoodRec = std::make_unique<TModuleRec>();
+  auto BadRec = std::make_unique<TModuleRec>();
+  bool GoodResult = False;
+  bool BadResult = True;
+
+  std::thread A([&]() { GoodResult = CompileInto(*Good, *GoodRec, BlinkSource); });
+  std::thread B([&]() { BadResult = CompileInto(*Bad, *BadRec, "' {$STAMP BS2}\rGOTO Nowhere\r"); });
+  A.join();
+  B.join();
+
+  EXPECT_TRUE(GoodResult);
+  EXPECT_FALSE(BadResult);
+  ASSERT_NE(BadRec->Error, nullptr);
+  EXPECT_EQ(std::strncmp(BadRec->Error, "1", 1), 0);
+}
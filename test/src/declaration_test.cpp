@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+#include "test_helpers.hpp"
+
+TEST(DeclarationTests, ForwardReferencesBetweenIndexedLines)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  /*Declarations refer forward across kinds, share a line, and sit in a cancelled #IF branch and among instructions*/
+  ASSERT_TRUE(CompileSource(t, *Rec,
+      "' {$STAMP BS2}\r' {$PBASIC 2.5}\r"
+      "HIGH Led\r"
+      "Led PIN Offset + 1 : Offset CON Base * 2\r"
+      "#IF 0 #THEN\rBase CON 9\r#ELSE\rBase CON 3\r#ENDIF\r"
+      "Table DATA @Base * 2, Offset / 2, WORD 300\r"
+      "DATA 7\r"
+      "Total VAR Byte\r"
+      "Part VAR Total.LOWNIB\r"
+      "Total = Table + Part\r"
+      "END\r")) << Rec->Error;
+  EXPECT_EQ(Rec->EEPROM[6], 3);
+  EXPECT_EQ(Rec->EEPROM[7], 300 & 0xFF);
+  EXPECT_EQ(Rec->EEPROM[8], 300 >> 8);
+  EXPECT_EQ(Rec->EEPROM[9], 7);
+  EXPECT_EQ(Rec->VarCounts[2], 1);
+}
+
+TEST(DeclarationTests, GosubLimitReportedAtFirstOneTooMany)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Byte\r";
+  size_t Last;
+
+  for (int Count = 0; Count < 255; Count++) Src += "GOSUB Sub\r";
+  EXPECT_TRUE(CompileSource(t, *Rec, Src + "Sub: RETURN\r")) << Rec->Error;
+  Last = Src.size();
+  Src += "GOSUB Sub\rSub: RETURN\r";
+  EXPECT_FALSE(CompileSource(t, *Rec, Src));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "145");
+  EXPECT_EQ(Rec->ErrorStart, (int) Last);
+  EXPECT_EQ(Rec->ErrorLength, 5);
+}
+
+TEST(DeclarationTests, ConstantsResolvedInDependencyOrder)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  /*Each CON refers to a later one, a PIN to a later CON and a CON to a later DATA label*/
+  ASSERT_TRUE(CompileSource(t, *Rec,
+      "' {$STAMP BS2}\r' {$PBASIC 2.5}\r"
+      "First CON Second + 1\r"
+      "Second CON Third * 2\r"
+      "Led PIN Third + 2\r"
+      "Third CON Where + 5\r"
+      "Pad DATA 0, 0\r"
+      "Where DATA First, Second, Led\r"
+      "HIGH Led\r"
+      "END\r")) << Rec->Error;
+  EXPECT_EQ(Rec->EEPROM[2], 15);
+  EXPECT_EQ(Rec->EEPROM[3], 14);
+  EXPECT_EQ(Rec->EEPROM[4], 9);
+}
+
+TEST(DeclarationTests, SelfReferenceReportedAtReference)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rFirst CON Second + 1\rSecond CON ";
+
+  EXPECT_FALSE(CompileSource(t, *Rec, Src + "First\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "231");
+  EXPECT_EQ(Rec->ErrorStart, (int) Src.size());
+  EXPECT_EQ(Rec->ErrorLength, 5);
+
+  /*DATA addresses may not depend upon DATA laid out after them*/
+  Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rTable DATA @";
+  EXPECT_FALSE(CompileSource(t, *Rec, Src + "Where, 1\rWhere CON Later\rLater DATA 2\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "231");
+  EXPECT_EQ(Rec->ErrorStart, (int) Src.size());
+
+  /*Symbols declared nowhere are still undefined*/
+  EXPECT_FALSE(CompileSource(t, *Rec, "' {$STAMP BS2}\rFirst CON Missing\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "110");
+}
+
+TEST(DeclarationTests, DataOverlappingProgramReportedAtData)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = "' {$STAMP BS2}\rTable DATA @2045, 1, 2, ";
+
+  /*The program starts at EEPROM[2047], where the 3 is*/
+  EXPECT_FALSE(CompileSource(t, *Rec, Src + "3\rx VAR Byte\rx = x * 3 + 1\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "124");
+  EXPECT_EQ(Rec->ErrorStart, (int) Src.size());
+  EXPECT_EQ(Rec->ErrorLength, 1);
+}
+
+TEST(DeclarationTests, LongConstantChainResolvesOnSmallStack)
+{
+  struct TChain
+  {
+    std::string Src;
+    std::unique_ptr<TModuleRec> Rec;
+    bool Compiled;
+  } Chain;
+  const int Depth = 600;
+
+  /*Each CON refers to the next, so resolving the first walks the whole chain*/
+  Chain.Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rTable DATA WORD C0\r";
+  for (int Idx = 0; Idx < Depth-1; Idx++) Chain.Src += "C" + std::to_string(Idx) + " CON C" + std::to_string(Idx+1) + " + 1\r";
+  Chain.Src += "C" + std::to_string(Depth-1) + " CON 1\rEND\r";
+  Chain.Rec = std::make_unique<TModuleRec>();
+  Chain.Compiled = False;
+  auto Compile = [](void *Context) -> void *
+    {
+    TChain *Work = (TChain *) Context;
+    auto t = std::make_unique<tokenizer>();
+    Work->Compiled = CompileSource(*t, *Work->Rec, Work->Src);
+    return NULL;
+    };
+#if defined(__unix__) || defined(__APPLE__)
+  /*On a thread with a small stack, such as a worker thread may have*/
+  pthread_attr_t Attributes;
+  pthread_t Thread;
+  ASSERT_EQ(pthread_attr_init(&Attributes), 0);
+  ASSERT_EQ(pthread_attr_setstacksize(&Attributes, 128*1024), 0);
+  ASSERT_EQ(pthread_create(&Thread, &Attributes, Compile, &Chain), 0);
+  pthread_join(Thread, NULL);
+  pthread_attr_destroy(&Attributes);
+#else
+  Compile(&Chain);
+#endif
+  ASSERT_TRUE(Chain.Compiled) << Chain.Rec->Error;
+  EXPECT_EQ(Chain.Rec->EEPROM[0], Depth & 0xFF);
+  EXPECT_EQ(Chain.Rec->EEPROM[1], Depth >> 8);
+}
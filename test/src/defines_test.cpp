@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_defines.hpp"
+
+namespace
+{
+
+const std::string Pad(48, ' ');
+
+/* Compile Src alone, with its Pad replaced by #DEFINE lines for Set (so positions don't move), and expect the same
+   results as the DefineCompiler gave */
+void ExpectSameAsDefined(std::string Src, const TDefineSet &Set, const TModuleRec &Result, const TSrcTokReference *Refs)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<TSrcTokReference> Ref(SrcTokRefSize);
+  std::string Defines;
+
+  for (int Idx = 0; Idx < Set.Count; Idx++)
+    Defines += std::string("#DEFINE ") + Set.Symbols[Idx].Name + " = " + std::to_string(Set.Symbols[Idx].Value) + "\r";
+  ASSERT_LE(Defines.size(), Pad.size());
+  Defines += Pad.substr(Defines.size());
+  std::string Full = Src.replace(Src.find(Pad), Pad.size(), Defines);
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  EXPECT_EQ(t.CompileView(Rec.get(), Full.data(), (int) Full.size(), False, True, Ref.data(), NULL), Result.Succeeded);
+  EXPECT_EQ(Result.TargetModule, Rec->TargetModule);
+  EXPECT_EQ(Result.PacketCount, Rec->PacketCount);
+  EXPECT_EQ(std::memcmp(Result.EEPROM, Rec->EEPROM, EEPROMSize), 0);
+  EXPECT_EQ(Result.ErrorStart, Rec->ErrorStart);
+  EXPECT_EQ(Result.ErrorLength, Rec->ErrorLength);
+  EXPECT_STREQ(Result.Error, Rec->Error);
+  EXPECT_EQ(std::memcmp(Refs, Ref.data(), SrcTokRefSize * sizeof(TSrcTokReference)), 0);
+}
+
+}  // namespace
+
+TEST(DefineTests, EachConfigurationMatchesCompile)
+{
+  DefineCompiler Compiler(2);
+  const TDefineSymbol Debug[] = {{"Debug_Mode", 1}};
+  const TDefineSymbol Quiet[] = {{"Debug_Mode", 0}};
+  const TDefineSymbol Board[] = {{"debug_mode", 0}, {"Board", 2}};
+  const TDefineSymbol Led[] = {{"Board", 3}};
+  const TDefineSymbol Other[] = {{"Board", 2}};
+  const TDefineSet Sets[] = {{Debug, 1}, {Quiet, 1}, {Board, 2}, {Led, 1}, {Other, 1}, {NULL, 0}};
+  const int SetCount = sizeof(Sets) / sizeof(Sets[0]);
+  std::vector<TModuleRec> Results(SetCount);
+  std::vector<TSrcTokReference> Refs(SetCount * SrcTokRefSize);
+  int SharedWith[SetCount];
+  TDefineStats Stats;
+  std::string Src =
+      "' {$STAMP BS2}\r' {$PBASIC 2.5}\r" + Pad +
+      "x VAR Byte\r"
+      "#IF Debug_Mode #THEN\rDEBUG \"x\", CR\r#ENDIF\r"
+      "#SELECT Board\r#CASE 3\rHIGH 3\r#CASE #ELSE\rHIGH 0\r#ENDSELECT\r"
+      "x = x + 1\rEND\r";
+
+  ASSERT_TRUE(Compiler.Compile(Src.data(), (int) Src.size(), True, tmNone, Sets, SetCount, Results.data(), Refs.data(), SharedWith, &Stats)) << Results[0].Error;
+  EXPECT_EQ(Stats.SetCount, SetCount);
+  EXPECT_EQ(Stats.Succeeded, SetCount);
+  EXPECT_EQ(Stats.Compiled, 5);
+  for (int Idx = 0; Idx < SetCount; Idx++)
+    {
+    SCOPED_TRACE(Idx);
+    ExpectSameAsDefined(Src, Sets[Idx], Results[Idx], &Refs[Idx * SrcTokRefSize]);
+    }
+  /* Board = 2 leaves the same code as Debug_Mode = 0; with both DEFINE'd, or neither, there's a different amount of
+     room left in the symbol table, so those aren't shared */
+  EXPECT_EQ(SharedWith[0], 0);
+  EXPECT_EQ(SharedWith[1], 1);
+  EXPECT_EQ(SharedWith[2], 2);
+  EXPECT_EQ(SharedWith[3], 3);
+  EXPECT_EQ(SharedWith[4], 1);
+  EXPECT_EQ(SharedWith[5], 5);
+}
+
+TEST(DefineTests, DefinedSymbolsAreChecked)
+{
+  DefineCompiler Compiler(1);
+  const TDefineSymbol Declared[] = {{"Total", 1}};
+  const TDefineSymbol Reserved[] = {{"HIGH", 1}};
+  const TDefineSymbol Illegal[] = {{"2Fast", 1}};
+  const TDefineSymbol Used[] = {{"Limit", 1}};
+  const TDefineSet Sets[] = {{Declared, 1}, {Reserved, 1}, {Illegal, 1}, {Used, 1}, {NULL, 0}};
+  const int SetCount = sizeof(Sets) / sizeof(Sets[0]);
+  std::vector<TModuleRec> Results(SetCount);
+  std::vector<TSrcTokReference> Refs(SetCount * SrcTokRefSize);
+  int SharedWith[SetCount];
+  TDefineStats Stats;
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\r" + Pad + "Total CON 3\rx VAR Byte\rx = Limit\rEND\r";
+
+  EXPECT_FALSE(Compiler.Compile(Src.data(), (int) Src.size(), True, tmNone, Sets, SetCount, Results.data(), Refs.data(), SharedWith, &Stats));
+  EXPECT_EQ(Stats.Succeeded, 0);
+  EXPECT_EQ(std::string(Results[0].Error).substr(0, 3), "123");
+  EXPECT_EQ(std::string(Results[1].Error).substr(0, 3), "196");
+  EXPECT_EQ(std::string(Results[2].Error).substr(0, 3), "196");
+  /* A DEFINE'd symbol can't be used outside conditional-compile directives; the same code with Limit undefined fails
+     another way, so it isn't shared */
+  ExpectSameAsDefined(Src, Sets[3], Results[3], &Refs[3 * SrcTokRefSize]);
+  ExpectSameAsDefined(Src, Sets[4], Results[4], &Refs[4 * SrcTokRefSize]);
+  EXPECT_STRNE(Results[3].Error, Results[4].Error);
+  EXPECT_EQ(SharedWith[4], 4);
+  EXPECT_EQ(Stats.Compiled, 2);
+}
+
+TEST(DefineTests, IgnoredForPBasic20)
+{
+  DefineCompiler Compiler(2);
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  const TDefineSymbol Declared[] = {{"Total", 1}};
+  const TDefineSymbol Reserved[] = {{"HIGH", 1}};
+  const TDefineSet Sets[] = {{Declared, 1}, {Reserved, 1}, {NULL, 0}};
+  const int SetCount = sizeof(Sets) / sizeof(Sets[0]);
+  std::vector<TModuleRec> Results(SetCount);
+  int SharedWith[SetCount];
+  TDefineStats Stats;
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.0}\rTotal CON 3\rx VAR Byte\rx = Total\rEND\r";
+
+  /* PBASIC 2.0 has no #DEFINE; every configuration compiles as the source alone, even those 2.5 would reject */
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  ASSERT_TRUE(t.CompileView(Rec.get(), Src.data(), (int) Src.size(), False, True, NULL, NULL)) << Rec->Error;
+  ASSERT_TRUE(Compiler.Compile(Src.data(), (int) Src.size(), True, tmNone, Sets, SetCount, Results.data(), NULL, SharedWith, &Stats)) << Results[0].Error;
+  EXPECT_EQ(Stats.Compiled, 1);
+  for (int Idx = 0; Idx < SetCount; Idx++)
+    {
+    SCOPED_TRACE(Idx);
+    EXPECT_EQ(SharedWith[Idx], 0);
+    EXPECT_EQ(Results[Idx].PacketCount, Rec->PacketCount);
+    EXPECT_EQ(std::memcmp(Results[Idx].EEPROM, Rec->EEPROM, EEPROMSize), 0);
+    }
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+#include "test_helpers.hpp"
+
+TEST(ElementizeTests, DirectiveErrorsComeBeforeSourceErrors)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  /*The bad hex constant is found first, but a missing $STAMP directive must still be what's reported*/
+  EXPECT_FALSE(CompileSource(t, *Rec, "x VAR Byte\rx = $G\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "156");
+
+  EXPECT_FALSE(CompileSource(t, *Rec, "' {$STAMP BS2}\rx VAR Byte\rx = $G\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "104");
+  EXPECT_EQ(Rec->ErrorStart, 31);
+}
+
+TEST(ElementizeTests, LanguageDirectiveAfterCode)
+{
+  tokenizer t;
+  auto First = std::make_unique<TModuleRec>();
+  auto Last = std::make_unique<TModuleRec>();
+
+  /*A 2.5 comma continuation is elementized before $PBASIC is seen*/
+  ASSERT_TRUE(CompileSource(t, *First,
+      "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Word\rLOOKUP x, [1, 2,\r 3], x\rDO\rLOOP\r"));
+  ASSERT_TRUE(CompileSource(t, *Last,
+      "x VAR Word\rLOOKUP x, [1, 2,\r 3], x\rDO\rLOOP\r' {$STAMP BS2}\r' {$PBASIC 2.5}\r"));
+  EXPECT_EQ(Last->LanguageVersion, 250);
+  EXPECT_EQ(std::memcmp(First->EEPROM, Last->EEPROM, EEPROMSize), 0);
+}
+
+TEST(ElementizeTests, TargetSymbolsResolvedAfterDirectives)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  EXPECT_TRUE(CompileSource(t, *Rec,
+      "' {$STAMP BS2p}\r' {$PBASIC 2.5}\r"
+      "#IF $STAMP = BS2p #THEN\rp PIN 5\r#ENDIF\r"
+      "LCDOUT p, 1, [\"hi\"]\rEND\r"));
+  /*#IF isn't a directive in PBASIC 2.0*/
+  EXPECT_FALSE(CompileSource(t, *Rec, "' {$STAMP BS2}\r#IF 1 #THEN\r#ENDIF\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "103");
+}
+
+TEST(ElementizeTests, DirectiveScanSkipsLineAfterEmptyComment)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  /*Long-standing behavior: the directive scan steps over the end of an empty comment's line*/
+  EXPECT_FALSE(CompileSource(t, *Rec, "'\r' {$STAMP BS2}\rEND\r"));
+  EXPECT_EQ(Rec->TargetModule, tmNone);
+  EXPECT_TRUE(CompileSource(t, *Rec, "' x\r' {$STAMP BS2}\rEND\r"));
+  EXPECT_EQ(Rec->TargetModule, tmBS2);
+}
+
+TEST(ElementizeTests, BlanksAndCommentsOfAnyLength)
+{
+  tokenizer t;
+  auto Expected = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+
+  ASSERT_TRUE(CompileSource(t, *Expected, "' {$STAMP BS2}\rx VAR Byte\rx = 1\rEND\r"));
+  /*Runs of blanks and comments that start and end anywhere within a block of scanned bytes*/
+  for (int Length = 0; Length < 70; Length++)
+    {
+    std::string Blanks;
+    for (int Idx = 0; Idx < Length; Idx++) Blanks += " \t"[Idx % 2];
+    std::string Src = "' {$STAMP BS2}\r" + Blanks + "x VAR Byte" + Blanks + "\r'" + std::string(Length, 'c') +
+                      "\rx" + Blanks + "=" + Blanks + "1 '" + Blanks + "\rEND" + Blanks;
+    ASSERT_TRUE(CompileSource(t, *Rec, Src.c_str())) << Length << ": " << Rec->Error;
+    EXPECT_EQ(std::memcmp(Expected->EEPROM, Rec->EEPROM, EEPROMSize), 0) << Length;
+    }
+}
+
+TEST(ElementizeTests, ControlCharactersEndLines)
+{
+  tokenizer t;
+  auto Expected = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+
+  ASSERT_TRUE(CompileSource(t, *Expected, "' {$STAMP BS2}\rx VAR Byte\ry VAR Byte\rx = 1\ry = 2\rEND\r"));
+  for (int Length = 0; Length < 40; Length++)
+    for (char Control : {'\n', '\x01', '\x0B', '\x1F'})
+      {
+      std::string Src = "' {$STAMP BS2}\rx VAR Byte\ry VAR Byte\r" + std::string(Length, ' ') + "x = 1" + Control + "y = 2\rEND\r";
+      ASSERT_TRUE(CompileSource(t, *Rec, Src.c_str())) << Length << ": " << Rec->Error;
+      EXPECT_EQ(std::memcmp(Expected->EEPROM, Rec->EEPROM, EEPROMSize), 0) << Length;
+      }
+  /*Tabs and chars above 126 are not line ends*/
+  EXPECT_TRUE(CompileSource(t, *Rec, "' {$STAMP BS2}\rx VAR Byte\rx\t=\t1 ' caf\xE9\x7F\rEND\r"));
+  EXPECT_FALSE(CompileSource(t, *Rec, "' {$STAMP BS2}\rx VAR Byte\rx = 1 \x80\rEND\r"));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "103");
+}
+
+TEST(ElementizeTests, CancelledElementsCompactedAway)
+{
+  tokenizer t;
+  auto Expected = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Byte\rSELECT x\r#IF 0 #THEN\rx = 1\r#ENDIF\rLimit CON 3\rCASE 1\r";
+
+  /*Lines dropped between SELECT and its first CASE leave it just as if they'd never been there*/
+  ASSERT_TRUE(CompileSource(t, *Expected, "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Byte\rSELECT x\rCASE 1\rx = 3\rENDSELECT\rEND\r"));
+  ASSERT_TRUE(CompileSource(t, *Rec, (Src + "x = Limit\rENDSELECT\rEND\r").c_str())) << Rec->Error;
+  EXPECT_EQ(std::memcmp(Expected->EEPROM, Rec->EEPROM, EEPROMSize), 0);
+
+  /*Errors after them are still reported at their place in the source*/
+  EXPECT_FALSE(CompileSource(t, *Rec, (Src + "x = Missing\rENDSELECT\rEND\r").c_str()));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "110");
+  EXPECT_EQ(Rec->ErrorStart, (int) Src.size() + 4);
+  EXPECT_EQ(Rec->ErrorLength, 7);
+}
+
+TEST(ElementizeTests, ElementListGrowsWithProgram)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\r";
+  std::string Sum = "1";
+  std::string Small = Src + "Table DATA 7\rEND\r";
+
+  /*Far more elements than the list starts with, both live ones and ones cancelled by conditional compilation*/
+  for (int Count = 1; Count < 30; Count++) Sum += " + 1";
+  for (int Count = 0; Count < 200; Count++) Src += "Part" + std::to_string(Count) + " CON " + Sum + "\r";
+  Src += "#IF 0 #THEN\r";
+  for (int Count = 0; Count < 2000; Count++) Src += "HIGH 5 : LOW 5\r";
+  Src += "#ENDIF\rTable DATA Part199, Part0 + 1\rEND\r";
+  ASSERT_TRUE(CompileSource(t, *Rec, Src.c_str())) << Rec->Error;
+  EXPECT_EQ(Rec->EEPROM[0], 30);
+  EXPECT_EQ(Rec->EEPROM[1], 31);
+
+  /*The same tokenizer compiles small and large programs alike afterwards*/
+  ASSERT_TRUE(CompileSource(t, *Rec, Small.c_str())) << Rec->Error;
+  EXPECT_EQ(Rec->EEPROM[0], 7);
+  ASSERT_TRUE(CompileSource(t, *Rec, Src.c_str())) << Rec->Error;
+  EXPECT_EQ(Rec->EEPROM[1], 31);
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+#include "test_helpers.hpp"
+
+namespace
+{
+
+std::string SelectProgram(const std::string &Select)
+{
+  return "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Word\r"
+         "SELECT " + Select + "\r"
+         "  CASE 5\r    HIGH 1\r"
+         "  CASE 7 TO 9, > 300\r    LOW 1\r"
+         "  CASE ELSE\r    x = x - 1\r"
+         "ENDSELECT\rEND\r";
+}
+
+}  // namespace
+
+TEST(ExpressionTests, CaseExpressionsCopiedAndAppended)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  /*Each CASE appends the SELECT expression (which spans several expression words) to its own*/
+  const byte Program[] = {192, 7, 153, 233, 250, 103, 233, 250, 167, 233, 250, 231, 233, 251, 39, 226, 183, 6, 192, 44,
+                          36, 1, 188, 0, 162, 88, 91, 230, 122, 126, 153, 250, 126, 169, 250, 126, 185, 250, 126, 201,
+                          248, 189, 174, 103, 167, 233, 159, 167, 234, 159, 167, 235, 159, 167, 236, 159, 142, 109, 202, 230,
+                          122, 126, 153, 250, 126, 169, 250, 126, 185, 250, 126, 201, 250, 37, 151, 165, 141, 97, 68, 79,
+                          10, 184, 1, 196, 176, 183, 204, 240, 40, 123, 51, 64, 0, 0};
+
+  ASSERT_TRUE(CompileSource(t, *Rec, SelectProgram("x + 1001 + 1002 + 1003 + 1004"))) << Rec->Error;
+  for (int Idx = 0; Idx < (int) sizeof(Program); Idx++)
+    {
+    EXPECT_EQ(Rec->EEPROMFlags[2047-Idx] & 3, 3) << Idx;
+    EXPECT_EQ(Rec->EEPROM[2047-Idx], Program[Idx]) << Idx;
+    }
+  EXPECT_EQ(Rec->EEPROMFlags[2047-sizeof(Program)] & 3, 0);
+}
+
+TEST(ExpressionTests, TooComplexCaseReportedAtEndOfLine)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = SelectProgram("x + 1001 + 1002 + 1003 + 1004 + 1005 + 1006");
+
+  /*The second CASE's expression overflows once its last value is appended, at the end of its line*/
+  EXPECT_FALSE(CompileSource(t, *Rec, Src));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "144");
+  EXPECT_EQ(Rec->ErrorStart, (int) Src.find("300\r") + 3);
+  EXPECT_EQ(Rec->ErrorLength, 1);
+}
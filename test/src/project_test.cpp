@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_project.hpp"
+
+namespace
+{
+
+std::map<std::string, std::string> Files = {
+    {"Menu.bse", "' {$STAMP BS2e}\r' {$PBASIC 2.5}\rx VAR Byte\rDEBUG \"Menu\", CR\rRUN 2\r"},
+    {"Sensor.bse", "' {$STAMP BS2e}\rx VAR Word\rx = x + 1\rDEBUG DEC x\rRUN 0\r"},
+    {"Broken.bse", "' {$STAMP BS2e}\rGOTO Nowhere\r"}};
+
+bool LoadFile(void *Context, const char *FileName, char *Source, int *SourceSize)
+{
+  auto File = static_cast<std::map<std::string, std::string> *>(Context)->find(FileName);
+
+  if (File == Files.end()) return False;
+  std::memcpy(Source, File->second.data(), File->second.size());
+  *SourceSize = (int) File->second.size();
+  return True;
+}
+
+/* Compile one project file alone, as a slot of a Target project */
+void ExpectSameAsSlot(const TProjectSlot &Slot, byte Target)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  const std::string &Src = Files[Slot.FileName];
+
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  Rec->TargetModule = Target;
+  EXPECT_EQ(t.CompileView(Rec.get(), Src.data(), (int) Src.size(), False, False, NULL, NULL), Slot.Rec.Succeeded);
+  EXPECT_EQ(Slot.Rec.TargetModule, Target);
+  EXPECT_EQ(Slot.Rec.PacketCount, Rec->PacketCount);
+  EXPECT_EQ(std::memcmp(Slot.Rec.EEPROM, Rec->EEPROM, EEPROMSize), 0);
+  EXPECT_EQ(Slot.Rec.ErrorStart, Rec->ErrorStart);
+}
+
+}  // namespace
+
+TEST(ProjectTests, CompilesEverySlot)
+{
+  ProjectCompiler Project(4);
+  std::vector<TProjectSlot> Slots(ProjectSlotCount);
+  std::vector<TSrcTokReference> Refs(ProjectSlotCount * SrcTokRefSize);
+  TProjectStats Stats;
+  std::string Main = "' {$STAMP BS2e, Menu.bse, Sensor.bse}\r' {$PBASIC 2.5}\rDEBUG \"Main\", CR\rRUN 1\r";
+
+  ASSERT_TRUE(Project.Compile(Main.data(), (int) Main.size(), LoadFile, &Files, Slots.data(), Refs.data(), &Stats)) << Slots[0].Rec.Error;
+  EXPECT_EQ(Stats.SlotCount, 3);
+  EXPECT_EQ(Stats.Succeeded, 3);
+  EXPECT_EQ(Stats.ThreadCount, 3);
+  EXPECT_EQ(Slots[0].FileName, nullptr);
+  EXPECT_EQ(Slots[0].Rec.TargetModule, tmBS2e);
+  EXPECT_STREQ(Slots[1].FileName, "Menu.bse");
+  EXPECT_STREQ(Slots[2].FileName, "Sensor.bse");
+  ExpectSameAsSlot(Slots[1], tmBS2e);
+  ExpectSameAsSlot(Slots[2], tmBS2e);
+  EXPECT_NE(Refs[2 * SrcTokRefSize].SrcStart, 0);
+
+  /* A $STAMP directive after code is found by the main source's compile */
+  Main = "DEBUG \"Main\", CR\rRUN 1\r' {$STAMP BS2p, Sensor.bse}\r";
+  ASSERT_TRUE(Project.Compile(Main.data(), (int) Main.size(), LoadFile, &Files, Slots.data(), NULL, &Stats)) << Slots[0].Rec.Error;
+  EXPECT_EQ(Stats.SlotCount, 2);
+  EXPECT_STREQ(Slots[1].FileName, "Sensor.bse");
+  ExpectSameAsSlot(Slots[1], tmBS2p);
+}
+
+TEST(ProjectTests, ReportsEachSlot)
+{
+  ProjectCompiler Project(1);
+  std::vector<TProjectSlot> Slots(ProjectSlotCount);
+  TProjectStats Stats;
+  std::string Main = "' {$STAMP BS2sx, Missing.bsx, Broken.bse, Menu.bse}\rDEBUG \"Main\"\r";
+
+  EXPECT_FALSE(Project.Compile(Main.data(), (int) Main.size(), LoadFile, &Files, Slots.data(), NULL, &Stats));
+  EXPECT_EQ(Stats.SlotCount, 4);
+  EXPECT_EQ(Stats.Succeeded, 2);
+  EXPECT_EQ(Stats.ThreadCount, 1);
+  EXPECT_TRUE(Slots[0].Rec.Succeeded);
+  EXPECT_FALSE(Slots[1].Loaded);
+  EXPECT_FALSE(Slots[1].Rec.Succeeded);
+  EXPECT_TRUE(Slots[2].Loaded);
+  EXPECT_FALSE(Slots[2].Rec.Succeeded);
+  ExpectSameAsSlot(Slots[2], tmBS2sx);
+  ExpectSameAsSlot(Slots[3], tmBS2sx);
+
+  /* A BS2 has no project files */
+  Main = "' {$STAMP BS2}\rDEBUG \"Main\"\r";
+  EXPECT_TRUE(Project.Compile(Main.data(), (int) Main.size(), LoadFile, &Files, Slots.data(), NULL, &Stats));
+  EXPECT_EQ(Stats.SlotCount, 1);
+}
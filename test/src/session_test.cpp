@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_session.hpp"
+
+namespace
+{
+
+const char *Program =
+    "' {$STAMP BS2}\r"
+    "' {$PBASIC 2.5}\r"
+    "' Blinks a light\r"
+    "idx VAR Byte\r"
+    "Limit CON 10\r"
+    "Table DATA 1, 2, WORD 300\r"
+    "FOR idx = 0 TO Limit\r"
+    "  TOGGLE 5   ' the light\r"
+    "  DEBUG DEC idx, CR\r"
+    "NEXT\r"
+    "END\r";
+
+/* Compile the session's source afresh with CompileView, as the session's Compile should have */
+void ExpectSameAsFresh(CompileSession &Session, TModuleRec &Rec, std::vector<TSrcTokReference> &Ref, bool Succeeded)
+{
+  tokenizer t;
+  auto Fresh = std::make_unique<TModuleRec>();
+  std::vector<TSrcTokReference> FreshRef(SrcTokRefSize);
+
+  std::memset(Fresh.get(), 0, sizeof(TModuleRec));
+  std::memset(FreshRef.data(), 0, SrcTokRefSize * sizeof(TSrcTokReference));
+  ASSERT_EQ(t.CompileView(Fresh.get(), Session.Source(), Session.SourceSize(), False, True, FreshRef.data(), NULL), Succeeded);
+  EXPECT_EQ(Rec.Succeeded, Fresh->Succeeded);
+  EXPECT_STREQ(Rec.Error, Fresh->Error);
+  EXPECT_EQ(Rec.ErrorStart, Fresh->ErrorStart);
+  EXPECT_EQ(Rec.ErrorLength, Fresh->ErrorLength);
+  EXPECT_EQ(std::memcmp(Rec.EEPROM, Fresh->EEPROM, EEPROMSize), 0);
+  EXPECT_EQ(std::memcmp(Rec.EEPROMFlags, Fresh->EEPROMFlags, EEPROMSize), 0);
+  EXPECT_EQ(std::memcmp(Rec.VarCounts, Fresh->VarCounts, sizeof(Rec.VarCounts)), 0);
+  EXPECT_EQ(Rec.PacketCount, Fresh->PacketCount);
+  EXPECT_EQ(std::memcmp(Ref.data(), FreshRef.data(), SrcTokRefSize * sizeof(TSrcTokReference)), 0);
+}
+
+/* Replace the first Old in the session's source with New, and compile */
+bool EditAndCompile(CompileSession &Session, TModuleRec &Rec, std::vector<TSrcTokReference> &Ref, const char *Old, const char *New)
+{
+  std::string Src(Session.Source(), Session.SourceSize());
+  size_t Offset = Src.find(Old);
+
+  EXPECT_NE(Offset, std::string::npos) << Old;
+  EXPECT_TRUE(Session.Edit((int) Offset, (int) std::strlen(Old), New, (int) std::strlen(New)));
+  std::memset(&Rec, 0, sizeof(TModuleRec));
+  std::memset(Ref.data(), 0, SrcTokRefSize * sizeof(TSrcTokReference));
+  return Session.Compile(&Rec, Ref.data(), NULL);
+}
+
+}  // namespace
+
+TEST(SessionTests, EditsMatchFreshCompile)
+{
+  CompileSession Session;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<TSrcTokReference> Ref(SrcTokRefSize);
+  struct { const char *Old; const char *New; bool Succeeded; } Edits[] = {
+      {"TOGGLE 5", "TOGGLE 6", True},           /* an instruction */
+      {"Blinks", "Flashes", True},              /* a comment */
+      {"WORD 300", "WORD 300300", False},       /* a constant out of range, ahead of unchanged lines */
+      {"WORD 300300", "WORD 3000", True},
+      {"  DEBUG", "\r  HIGH idx\r  DEBUG", True},  /* new lines */
+      {"NEXT\r", "", False},                    /* an unterminated FOR */
+      {"END\r", "NEXT\rEND\r", True},
+      {"' {$PBASIC 2.5}", "' {$PBASIC 2.0}", True},  /* the language */
+      {"{$STAMP BS2}", "{$STAMP BS9}", False}};
+
+  ASSERT_TRUE(Session.Open(Program, (int) std::strlen(Program), True, tmNone));
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  ASSERT_TRUE(Session.Compile(Rec.get(), Ref.data(), NULL)) << Rec->Error;
+  for (auto &Edit : Edits)
+    {
+    SCOPED_TRACE(Edit.New);
+    EXPECT_EQ(EditAndCompile(Session, *Rec, Ref, Edit.Old, Edit.New), Edit.Succeeded);
+    ExpectSameAsFresh(Session, *Rec, Ref, Edit.Succeeded);
+    }
+  EXPECT_FALSE(Session.Edit(Session.SourceSize(), 1, "", 0));
+}
+
+#if defined(CompileStatistics)
+TEST(SessionTests, CommentEditReusesResults)
+{
+  CompileSession Session;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<TSrcTokReference> Ref(SrcTokRefSize);
+  TCompileStats Stats;
+
+  ASSERT_TRUE(Session.Open(Program, (int) std::strlen(Program), True, tmNone));
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  ASSERT_TRUE(Session.Compile(Rec.get(), Ref.data(), NULL));
+  ASSERT_TRUE(Session.GetCompileStats(&Stats));
+  EXPECT_EQ(Stats.ReusedLines, 0u);
+  EXPECT_FALSE(Stats.ReusedResults);
+
+  /* Only the comment's line is elementized again, and the passes after the editor directives are skipped */
+  ASSERT_TRUE(EditAndCompile(Session, *Rec, Ref, "the light", "the status light")) << Rec->Error;
+  ASSERT_TRUE(Session.GetCompileStats(&Stats));
+  EXPECT_EQ(Stats.ReusedLines, 10u);
+  EXPECT_GT(Stats.ReusedElements, 0u);
+  EXPECT_TRUE(Stats.ReusedResults);
+  ExpectSameAsFresh(Session, *Rec, Ref, True);
+
+  /* An instruction edit reuses the other lines but compiles again */
+  ASSERT_TRUE(EditAndCompile(Session, *Rec, Ref, "TOGGLE 5", "TOGGLE 7")) << Rec->Error;
+  ASSERT_TRUE(Session.GetCompileStats(&Stats));
+  EXPECT_EQ(Stats.ReusedLines, 10u);
+  EXPECT_FALSE(Stats.ReusedResults);
+  ExpectSameAsFresh(Session, *Rec, Ref, True);
+}
+#endif
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_batch.hpp"
+#include "tokenizer/tokenizer_trace.hpp"
+#include "test_helpers.hpp"
+
+#if defined(CompileStatistics)
+
+namespace
+{
+
+const char *Program =
+    "' {$STAMP BS2}\r"
+    "' {$PBASIC 2.5}\r"
+    "#DEFINE Fast = 0\r"
+    "idx VAR Byte\r"
+    "Limit CON 10\r"
+    "Table DATA 1, 2, 3\r"
+    "#IF Fast #THEN\r"
+    "  idx = 1\r"
+    "#ELSE\r"
+    "  idx = 2\r"
+    "#ENDIF\r"
+    "DEBUG DEC idx, CR\r"
+    "GOTO Done\r"
+    "idx = Limit\r"
+    "Done:\r"
+    "END\r";
+
+TCompileTrace MakeTrace(std::vector<TTraceEvent> &Events)
+{
+  TCompileTrace Trace;
+  std::memset(&Trace, 0, sizeof(Trace));
+  Trace.Events = Events.data();
+  Trace.Capacity = (int) Events.size();
+  return Trace;
+}
+
+std::string ReadFile(const char *FileName)
+{
+  std::ifstream File(FileName);
+  std::stringstream Text;
+  Text << File.rdbuf();
+  return Text.str();
+}
+
+}  // namespace
+
+TEST(StatsTests, CountsAndTimesEveryPhase)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  TCompileStats Stats;
+  TSymbolStats SymStats;
+  long long PhaseTotal = 0;
+
+  ASSERT_TRUE(CompileSource(t, *Rec, Program, False));
+  ASSERT_TRUE(t.GetCompileStats(&Stats));
+  ASSERT_TRUE(t.GetSymbolStats(&SymStats));
+  for (int Phase = 0; Phase < cpNumElements; Phase++)
+    {
+    EXPECT_GE(Stats.PhaseTime[Phase], 0) << CompilePhases[Phase];
+    PhaseTotal += Stats.PhaseTime[Phase];
+    }
+  EXPECT_GT(Stats.TotalTime, 0);
+  EXPECT_LE(PhaseTotal, Stats.TotalTime);
+  EXPECT_GT(Stats.Elements, 0u);
+  EXPECT_GT(Stats.CancelledSkips, 0u);   /*The #IF branch not taken*/
+  EXPECT_GT(Stats.CompactedElements, 0u); /*That branch and the declarations*/
+  EXPECT_EQ(Stats.PatchEntries, 1u);     /*GOTO Done*/
+  EXPECT_GT(Stats.EEPROMBits, 0u);
+  EXPECT_EQ(Stats.Packets, Rec->PacketCount);
+  EXPECT_EQ(Stats.Lookups, SymStats.Lookups);
+  EXPECT_EQ(Stats.Probes, SymStats.Probes);
+}
+
+TEST(StatsTests, DirectivesOnlyStopsAfterEditorDirectives)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  TCompileStats Stats;
+
+  ASSERT_TRUE(CompileSource(t, *Rec, Program, False));
+  ASSERT_TRUE(CompileSource(t, *Rec, Program, True));
+  ASSERT_TRUE(t.GetCompileStats(&Stats));
+  for (int Phase = cpAdjustSymbols; Phase < cpNumElements; Phase++)
+    EXPECT_EQ(Stats.PhaseTime[Phase], 0) << CompilePhases[Phase];
+  EXPECT_EQ(Stats.PatchEntries, 0u);
+  EXPECT_EQ(Stats.EEPROMBits, 0u);
+  EXPECT_EQ(Stats.Packets, 0);
+}
+
+TEST(StatsTests, TraceSpansPhasesAndInstructions)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<TTraceEvent> Events(256);
+  TCompileTrace Trace = MakeTrace(Events);
+  const TTraceEvent *Compile = NULL;
+  const TTraceEvent *Debug = NULL;
+  int Phases = 0;
+
+  t.SetTrace(&Trace);
+  ASSERT_TRUE(CompileSource(t, *Rec, Program, False));
+  t.SetTrace(NULL);
+  ASSERT_TRUE(CompileSource(t, *Rec, Program, False));   /*Not traced*/
+  EXPECT_EQ(Trace.Dropped, 0);
+  for (int Idx = 0; Idx < Trace.Count; Idx++)
+    switch (Events[Idx].Kind)
+      {
+      case tkCompile     : Compile = &Events[Idx]; break;
+      case tkPhase       : Phases++; break;
+      case tkInstruction : if (Events[Idx].Value == itDebug) Debug = &Events[Idx]; break;
+      }
+  ASSERT_NE(Compile, nullptr);
+  EXPECT_EQ(Compile->SrcLength, (int) std::strlen(Program));
+  EXPECT_EQ(Phases, 17);          /*Data and Var run twice*/
+  ASSERT_NE(Debug, nullptr);
+  EXPECT_EQ(std::string(Program).substr(Debug->SrcStart, Debug->SrcLength), "DEBUG DEC idx, CR");
+  EXPECT_GE(Debug->Start, Compile->Start);
+  EXPECT_LE(Debug->Start + Debug->Duration, Compile->Start + Compile->Duration);
+
+  std::string FileName = ::testing::TempDir() + "compile_trace.json";
+  ASSERT_TRUE(WriteTraceFile(FileName.c_str(), &Trace, 1));
+  std::string Json = ReadFile(FileName.c_str());
+  std::remove(FileName.c_str());
+  EXPECT_EQ(Json.substr(0, 2), "{\"");
+  EXPECT_NE(Json.find("\"name\":\"DEBUG\",\"cat\":\"instruction\""), std::string::npos);
+  EXPECT_NE(Json.find("\"name\":\"CompileInstructions\",\"cat\":\"phase\""), std::string::npos);
+  EXPECT_NE(Json.find("\"name\":\"LET\""), std::string::npos);
+}
+
+TEST(StatsTests, TraceSpansFailedInstruction)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<TTraceEvent> Events(256);
+  TCompileTrace Trace = MakeTrace(Events);
+  const char *Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Byte\rx = 1\rFREQOUT 0, x\rEND\r";
+  const TTraceEvent *Freqout = NULL;
+
+  t.SetTrace(&Trace);
+  EXPECT_FALSE(CompileSource(t, *Rec, Src, False));
+  for (int Idx = 0; Idx < Trace.Count; Idx++)
+    if ((Events[Idx].Kind == tkInstruction) && (Events[Idx].Value == itFreqout)) Freqout = &Events[Idx];
+  ASSERT_NE(Freqout, nullptr);   /*The instruction that failed is traced, up to where it failed*/
+  EXPECT_EQ(Freqout->SrcStart, (int) std::string(Src).find("FREQOUT"));
+  EXPECT_GT(Freqout->SrcLength, 0);
+}
+
+TEST(StatsTests, TraceCountsDroppedSpansAndWorkers)
+{
+  std::vector<TTraceEvent> Events(4);
+  TCompileTrace Trace = MakeTrace(Events);
+  std::vector<std::vector<char>> Buffers(8, std::vector<char>(MaxSourceSize, 0));
+  std::vector<TBatchJob> Jobs(8);
+  std::vector<TModuleRec> Results(8);
+
+  {
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  t.SetTrace(&Trace);
+  ASSERT_TRUE(CompileSource(t, *Rec, Program, False));
+  EXPECT_EQ(Trace.Count, 4);
+  EXPECT_GT(Trace.Dropped, 0);
+  }
+
+  BatchCompiler Batch(2);
+  std::vector<std::vector<TTraceEvent>> WorkerEvents(Batch.ThreadCount(), std::vector<TTraceEvent>(1024));
+  std::vector<TCompileTrace> WorkerTraces;
+  for (auto &Worker : WorkerEvents) WorkerTraces.push_back(MakeTrace(Worker));
+  for (int Idx = 0; Idx < 8; Idx++)
+    {
+    std::memcpy(Buffers[Idx].data(), Program, std::strlen(Program));
+    std::memset(&Jobs[Idx], 0, sizeof(TBatchJob));
+    Jobs[Idx].Source = Buffers[Idx].data();
+    Jobs[Idx].SourceSize = (int) std::strlen(Program);
+    Jobs[Idx].ParseStampDirective = True;
+    }
+  Batch.SetTraces(WorkerTraces.data());
+  ASSERT_TRUE(Batch.Compile(Jobs.data(), Results.data(), 8, NULL));
+  int Compiles = 0;
+  for (auto &Worker : WorkerTraces)
+    for (int Idx = 0; Idx < Worker.Count; Idx++)
+      if (Worker.Events[Idx].Kind == tkCompile) Compiles++;
+  EXPECT_EQ(Compiles, 8);
+
+  std::string FileName = ::testing::TempDir() + "batch_trace.json";
+  ASSERT_TRUE(WriteTraceFile(FileName.c_str(), WorkerTraces.data(), (int) WorkerTraces.size()));
+  std::string Json = ReadFile(FileName.c_str());
+  std::remove(FileName.c_str());
+  EXPECT_NE(Json.find("\"tid\":1"), std::string::npos);
+}
+
+#endif
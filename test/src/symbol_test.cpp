@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+#include "test_helpers.hpp"
+
+namespace
+{
+
+/* Return the reserved words reported for Module and Version */
+std::set<std::string> ReservedWords(tokenizer &t, byte Module, int Version)
+{
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Buffer(MaxSourceSize, 0);
+  std::set<std::string> Words;
+
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  Rec->TargetModule = Module;
+  Rec->LanguageVersion = Version;
+  if (!t.GetReservedWords(Rec.get(), Buffer.data())) return Words;
+  for (int Idx = 0; Idx < Rec->SourceSize; Idx += (int) std::strlen(&Buffer[Idx]) + 2)
+    Words.insert(&Buffer[Idx]);
+  return Words;
+}
+
+}  // namespace
+
+TEST(SymbolTests, ReservedWordsFollowTargetAndVersion)
+{
+  tokenizer t;
+
+  std::set<std::string> BS2v20 = ReservedWords(t, tmBS2, 200);
+  std::set<std::string> BS2v25 = ReservedWords(t, tmBS2, 250);
+  std::set<std::string> BS2pv25 = ReservedWords(t, tmBS2p, 250);
+
+  EXPECT_TRUE(BS2v20.count("DEBUG"));
+  EXPECT_FALSE(BS2v20.count("DO"));
+  EXPECT_FALSE(BS2v20.count("GET"));
+  EXPECT_TRUE(BS2v25.count("DO"));
+  EXPECT_FALSE(BS2v25.count("LCDOUT"));
+  EXPECT_TRUE(BS2pv25.count("LCDOUT"));
+  EXPECT_TRUE(BS2pv25.count("GET"));
+  /*Asking again must give the same answer regardless of what was asked in between*/
+  EXPECT_EQ(ReservedWords(t, tmBS2, 200), BS2v20);
+}
+
+TEST(SymbolTests, UserSymbolsDoNotLeakBetweenCompiles)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  ASSERT_TRUE(CompileSource(t, *Rec,
+      "' {$STAMP BS2}\r' {$PBASIC 2.5}\rMyCounter VAR Byte\rMyLimit CON 7\rMyCounter = MyLimit\rEND\r"));
+  std::set<std::string> Words = ReservedWords(t, tmBS2, 250);
+  EXPECT_FALSE(Words.count("MYCOUNTER"));
+  EXPECT_FALSE(Words.count("MYLIMIT"));
+
+  /*A second compile must not see the first compile's symbols*/
+  EXPECT_FALSE(CompileSource(t, *Rec, "' {$STAMP BS2}\r' {$PBASIC 2.5}\rMyCounter = 1\rEND\r"));
+}
+
+TEST(SymbolTests, DirectiveSymbolsKeepTheirValues)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  EXPECT_TRUE(CompileSource(t, *Rec,
+      "' {$STAMP BS2e}\r' {$PBASIC 2.5}\r"
+      "#IF ($STAMP = BS2e) AND ($PBASIC = 250) #THEN\rx VAR Byte\r#ELSE\r#ERROR \"wrong target\"\r#ENDIF\r"
+      "x = 1\rEND\r"));
+  EXPECT_TRUE(CompileSource(t, *Rec,
+      "' {$STAMP BS2pe}\r' {$PBASIC 2.5}\r"
+      "#IF $STAMP = BS2pe #THEN\rx VAR Byte\r#ELSE\r#ERROR \"wrong target\"\r#ENDIF\r"
+      "x = 1\rEND\r"));
+}
+
+TEST(SymbolTests, SimilarNamesSpreadAcrossVectors)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Word\r";
+  TSymbolStats Stats;
+
+  /*Numbered and anagrammed names all summed to a handful of vectors with the old additive hash*/
+  for (int Idx = 0; Idx < 300; Idx++)
+    {
+    char Name[16];
+    std::snprintf(Name, sizeof(Name), "LED_%03d", Idx);
+    Src += std::string(Name) + " CON " + std::to_string(Idx) + "\r";
+    }
+  Src += "ABC CON 1\rCBA CON 2\rBCA CON 3\r";
+  Src += "x = LED_000 + LED_150 + LED_299 + ABC + CBA + BCA\rEND\r";
+  ASSERT_TRUE(CompileSource(t, *Rec, Src.c_str()));
+
+  ASSERT_TRUE(t.GetSymbolStats(&Stats));
+  EXPECT_GT(Stats.Symbols, 300);
+  EXPECT_GT(Stats.Lookups, 0u);
+  EXPECT_LE(Stats.LongestChain, 8);
+  EXPECT_LE(Stats.MaxProbes, 8u);
+  EXPECT_LT((double) Stats.Probes / Stats.Lookups, 2.0);
+}
+
+TEST(SymbolTests, EveryReservedWordHasItsOwnSlot)
+{
+  std::set<int> Slots;
+  byte Length;
+
+  for (int Idx = 0; Idx < ReservedWordCount; Idx++)
+    {
+    const char *Name = (Idx < CommonSymbolTableSize ? CommonSymbols[Idx].Name : CustomSymbols[Idx-CommonSymbolTableSize].Symbol.Name);
+    unsigned int Hash = tokenizer().CalcSymbolHash(Name, &Length);
+    int Slot = tokenizer::FindReservedWord(Name, Hash, Length);
+    ASSERT_GE(Slot, 0) << Name;
+    EXPECT_TRUE(Slots.insert(Slot).second) << Name;
+    }
+  EXPECT_EQ((int) Slots.size(), ReservedWordCount);
+  EXPECT_EQ(tokenizer::FindReservedWord("LED_000", tokenizer().CalcSymbolHash("LED_000", &Length), Length), -1);
+}
+
+TEST(SymbolTests, WordsReservedOnOtherTargetsAreFreeNames)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  TSymbolStats Stats;
+
+  /*LCDOUT is only reserved on the BS2p family*/
+  EXPECT_TRUE(CompileSource(t, *Rec, "' {$STAMP BS2}\r' {$PBASIC 2.5}\rLCDOUT CON 5\rx VAR Byte\rx = LCDOUT\rEND\r"));
+  ASSERT_TRUE(t.GetSymbolStats(&Stats));
+  EXPECT_GT(Stats.ReservedHits, 0u);
+  EXPECT_FALSE(CompileSource(t, *Rec, "' {$STAMP BS2p}\r' {$PBASIC 2.5}\rLCDOUT CON 5\rEND\r"));
+}
+
+TEST(SymbolTests, UndefinedNamesLookedUpOnlyWhenElementized)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\rx VAR Byte\r";
+  TSymbolStats Fewer;
+  TSymbolStats More;
+
+  /*Forward references are resolved through the name table in every pass after Elementize, and when patched*/
+  ASSERT_TRUE(CompileSource(t, *Rec, (Src + std::string("GOTO Done\rx = Limit\r") + "Limit CON 3\rDone: END\r").c_str()));
+  ASSERT_TRUE(t.GetSymbolStats(&Fewer));
+  for (int Idx = 0; Idx < 10; Idx++) Src += "GOTO Done\rx = Limit\r";
+  ASSERT_TRUE(CompileSource(t, *Rec, (Src + "Limit CON 3\rDone: END\r").c_str()));
+  ASSERT_TRUE(t.GetSymbolStats(&More));
+  EXPECT_EQ(More.Lookups - Fewer.Lookups, 9u * 6);   /*GOTO, Done, x, Limit and = (twice, as "= " first), once each*/
+}
+
+TEST(SymbolTests, NamesBeyondNameTableStillResolve)
+{
+  tokenizer t;
+  auto Expected = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::string Program = "x VAR Byte\rGOTO Lab\r#DEFINE Dn = 1\r#DEFINE Dn = 3\r#IF Dn = 3 #THEN\rx = Cn\r#ENDIF\rLab: x = 2\rCn CON 4\rEND\r";
+  std::string Src = "' {$STAMP BS2}\r' {$PBASIC 2.5}\r#IF 0 #THEN\r";
+
+  /*Fill the name table with names in a branch not taken; the program's own names are then left out of it*/
+  ASSERT_TRUE(CompileSource(t, *Expected, ("' {$STAMP BS2}\r' {$PBASIC 2.5}\r" + Program).c_str())) << Expected->Error;
+  for (int Idx = 0; Idx < SymbolTableSize; Idx++) Src += "N" + std::to_string(Idx) + "\r";
+  Src += "#ENDIF\r";
+  ASSERT_TRUE(CompileSource(t, *Rec, (Src + Program).c_str())) << Rec->Error;
+  EXPECT_EQ(std::memcmp(Expected->EEPROM, Rec->EEPROM, EEPROMSize), 0);
+  EXPECT_FALSE(CompileSource(t, *Rec, (Src + "GOTO Nowhere\r" + Program).c_str()));
+  EXPECT_EQ(std::string(Rec->Error).substr(0, 3), "111");
+  EXPECT_EQ(Rec->ErrorStart, (int) Src.size() + 5);
+}
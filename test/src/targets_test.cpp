@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer_targets.hpp"
+
+namespace
+{
+
+const byte Targets[] = {tmBS2, tmBS2e, tmBS2sx, tmBS2p, tmBS2pe};
+const int TargetCount = sizeof(Targets);
+
+/* Compile Src for each target alone and expect the same results as the TargetCompiler gave */
+void ExpectSameAsEachTarget(const std::string &Src, const std::vector<TModuleRec> &Results, const std::vector<TSrcTokReference> &Refs)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<TSrcTokReference> Ref(SrcTokRefSize);
+
+  for (int Idx = 0; Idx < TargetCount; Idx++)
+    {
+    SCOPED_TRACE(Idx);
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    Rec->TargetModule = Targets[Idx];
+    EXPECT_EQ(t.CompileView(Rec.get(), Src.data(), (int) Src.size(), False, False, Ref.data(), NULL), Results[Idx].Succeeded);
+    EXPECT_EQ(Results[Idx].TargetModule, Targets[Idx]);
+    EXPECT_EQ(Results[Idx].LanguageVersion, Rec->LanguageVersion);
+    EXPECT_EQ(Results[Idx].PacketCount, Rec->PacketCount);
+    EXPECT_EQ(std::memcmp(Results[Idx].EEPROM, Rec->EEPROM, EEPROMSize), 0);
+    EXPECT_EQ(std::memcmp(Results[Idx].VarCounts, Rec->VarCounts, sizeof(Rec->VarCounts)), 0);
+    EXPECT_EQ(Results[Idx].ErrorStart, Rec->ErrorStart);
+    EXPECT_EQ(Results[Idx].ErrorLength, Rec->ErrorLength);
+    EXPECT_STREQ(Results[Idx].Error, Rec->Error);
+    EXPECT_EQ(std::memcmp(&Refs[Idx * SrcTokRefSize], Ref.data(), SrcTokRefSize * sizeof(TSrcTokReference)), 0);
+    }
+}
+
+}  // namespace
+
+TEST(TargetTests, EachTargetMatchesCompile)
+{
+  TargetCompiler Compiler(3);
+  std::vector<TModuleRec> Results(TargetCount);
+  std::vector<TSrcTokReference> Refs(TargetCount * SrcTokRefSize);
+  TTargetStats Stats;
+  std::string Src =
+      "' {$STAMP BS2}\r' {$PBASIC 2.5}\r"
+      "Led PIN 5\rx VAR Word\r"
+      "#IF $STAMP >= BS2P #THEN\rAUXIO\r#ELSE\rHIGH Led\r#ENDIF\r"
+      "x = x + 1\rDEBUG DEC x, CR\rEND\r";
+
+  /* Some targets have AUXIO, some don't, and $STAMP is each target's */
+  EXPECT_TRUE(Compiler.Compile(Src.data(), (int) Src.size(), Targets, TargetCount, Results.data(), Refs.data(), &Stats));
+  EXPECT_EQ(Stats.TargetCount, TargetCount);
+  EXPECT_EQ(Stats.Succeeded, TargetCount);
+  EXPECT_EQ(Stats.ThreadCount, 3);
+  ExpectSameAsEachTarget(Src, Results, Refs);
+  EXPECT_NE(std::memcmp(Results[0].EEPROM, Results[3].EEPROM, EEPROMSize), 0);
+
+  /* POLLIN is a BS2p and BS2pe command; elsewhere it's an undefined symbol */
+  Src = "' {$PBASIC 2.5}\rPOLLIN 0, 1\rEND\r";
+  EXPECT_FALSE(Compiler.Compile(Src.data(), (int) Src.size(), Targets, TargetCount, Results.data(), Refs.data(), &Stats));
+  EXPECT_EQ(Stats.Succeeded, 2);
+  ExpectSameAsEachTarget(Src, Results, Refs);
+
+  /* A $PBASIC directive after language-sensitive code elementizes the source again, for each target */
+  Src = "x VAR Byte\rx = 1 : DEBUG ? x\r' {$PBASIC 2.5}\r";
+  Compiler.Compile(Src.data(), (int) Src.size(), Targets, TargetCount, Results.data(), Refs.data(), NULL);
+  ExpectSameAsEachTarget(Src, Results, Refs);
+}
+
+TEST(TargetTests, FrontEndErrorGoesToEachTarget)
+{
+  TargetCompiler Compiler(2);
+  std::vector<TModuleRec> Results(TargetCount);
+  std::vector<TSrcTokReference> Refs(TargetCount * SrcTokRefSize);
+  TTargetStats Stats;
+  std::string Src = "' {$PBASIC 3.0}\rEND\r";
+
+  EXPECT_FALSE(Compiler.Compile(Src.data(), (int) Src.size(), Targets, TargetCount, Results.data(), Refs.data(), &Stats));
+  EXPECT_EQ(Stats.Succeeded, 0);
+  EXPECT_EQ(Stats.ThreadCount, 0);
+  ExpectSameAsEachTarget(Src, Results, Refs);
+  for (int Idx = 0; Idx < TargetCount; Idx++)
+    EXPECT_TRUE((Results[Idx].Error >= (char *) Results[Idx].PacketBuffer) && (Results[Idx].Error < (char *) Results[Idx].PacketBuffer + sizeof(TPacketType)));
+
+  /* An error held from the source is reported once symbols are adjusted for each target */
+  Src = "' {$STAMP BS2}\rx VAR Byte\rx = 99999\rEND\r";
+  EXPECT_FALSE(Compiler.Compile(Src.data(), (int) Src.size(), Targets, TargetCount, Results.data(), Refs.data(), &Stats));
+  ExpectSameAsEachTarget(Src, Results, Refs);
+}
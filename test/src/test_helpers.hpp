@@ -0,0 +1,20 @@
+#ifndef __TEST_HELPERS_H__
+#define __TEST_HELPERS_H__
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+
+/* Compile Src (with its $STAMP directive) into a freshly cleared Rec, from a MaxSourceSize buffer as Compile expects */
+inline bool CompileSource(tokenizer &t, TModuleRec &Rec, const std::string &Src, bool DirectivesOnly = False)
+{
+  std::vector<char> Buffer(MaxSourceSize, 0);
+  std::memcpy(Buffer.data(), Src.data(), Src.size());
+  std::memset(&Rec, 0, sizeof(TModuleRec));
+  Rec.SourceSize = (int) Src.size();
+  return t.Compile(&Rec, Buffer.data(), DirectivesOnly, True, NULL);
+}
+
+#endif
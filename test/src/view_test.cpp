@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tokenizer/tokenizer.hpp"
+
+namespace
+{
+
+const char *ProjectSource =
+    "' {$STAMP BS2e, Second.bse, \"Third Slot.bse\"}\r"
+    "' {$PORT COM3}\r"
+    "' {$PBASIC 2.5}\r"
+    "x VAR Byte\r"
+    "DO\r"
+    "  x = x + 1 ' count\x01"
+    "  DEBUG DEC x, CR\r"
+    "LOOP\r";
+
+/* Map Src into a read-only page, as a memory-mapped source file would be */
+const char *MapReadOnly(const char *Src, size_t *Size)
+{
+  *Size = std::strlen(Src);
+  void *Page = mmap(NULL, *Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (Page == MAP_FAILED) return NULL;
+  std::memcpy(Page, Src, *Size);
+  mprotect(Page, *Size, PROT_READ);
+  return (const char *) Page;
+}
+
+bool CompileCopy(tokenizer &t, TModuleRec &Rec, const char *Src, std::vector<char> &Buffer)
+{
+  Buffer.assign(MaxSourceSize, 0);
+  std::memcpy(Buffer.data(), Src, std::strlen(Src));
+  std::memset(&Rec, 0, sizeof(TModuleRec));
+  Rec.SourceSize = (int) std::strlen(Src);
+  return t.Compile(&Rec, Buffer.data(), False, True, NULL);
+}
+
+}  // namespace
+
+TEST(ViewTests, MatchesCompileWithoutWritingSource)
+{
+  tokenizer t;
+  auto Expected = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Buffer;
+  TDirectiveViews Views;
+  size_t Size;
+  const char *Src = MapReadOnly(ProjectSource, &Size);
+
+  ASSERT_NE(Src, nullptr);
+  ASSERT_TRUE(CompileCopy(t, *Expected, ProjectSource, Buffer));
+  std::memset(Rec.get(), 0, sizeof(TModuleRec));
+  ASSERT_TRUE(t.CompileView(Rec.get(), Src, (int) Size, False, True, NULL, &Views));
+  EXPECT_EQ(std::memcmp(Src, ProjectSource, Size), 0);
+  EXPECT_EQ(Rec->TargetModule, tmBS2e);
+  EXPECT_EQ(Rec->LanguageVersion, 250);
+  EXPECT_EQ(Rec->PacketCount, Expected->PacketCount);
+  EXPECT_EQ(std::memcmp(Rec->EEPROM, Expected->EEPROM, EEPROMSize), 0);
+
+  /*Views locate the same text the ProjectFiles and Port pointers do*/
+  EXPECT_EQ(std::string(Src + Views.ProjectFiles[0].Start, Views.ProjectFiles[0].Length), "Second.bse");
+  EXPECT_EQ(std::string(Rec->ProjectFiles[0]), "Second.bse");
+  EXPECT_EQ(std::string(Src + Views.ProjectFiles[1].Start, Views.ProjectFiles[1].Length), std::string(Rec->ProjectFiles[1]));
+  EXPECT_EQ(Views.ProjectFiles[2].Length, 0);
+  EXPECT_EQ(Rec->ProjectFiles[2], nullptr);
+  EXPECT_EQ(std::string(Src + Views.Port.Start, Views.Port.Length), "COM3");
+  EXPECT_EQ(std::string(Rec->Port), "COM3");
+  munmap((void *) Src, Size);
+}
+
+TEST(ViewTests, ErrorsMatchCompile)
+{
+  tokenizer t;
+  auto Expected = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Buffer;
+
+  for (const char *Src : {"' {$STAMP BS2}\rx VAR Byte\rx = $G\rEND\r",
+                          "' {$STAMP BS2}\r' {$PBASIC 2.5}\r#ERROR \"Not this board\"\r",
+                          "x = 1\r"})
+    {
+    EXPECT_FALSE(CompileCopy(t, *Expected, Src, Buffer));
+    std::string Error = Expected->Error;
+    std::memset(Rec.get(), 0, sizeof(TModuleRec));
+    EXPECT_FALSE(t.CompileView(Rec.get(), Src, (int) std::strlen(Src), False, True, NULL, NULL));
+    EXPECT_EQ(std::string(Rec->Error), Error);
+    EXPECT_EQ(Rec->ErrorStart, Expected->ErrorStart);
+    EXPECT_EQ(Rec->ErrorLength, Expected->ErrorLength);
+    }
+  EXPECT_FALSE(t.CompileView(Rec.get(), "END\r", MaxSourceSize, False, True, NULL, NULL));
+}
+
+TEST(ViewTests, ProbeMatchesDirectivesOnlyCompile)
+{
+  tokenizer t;
+  auto Expected = std::make_unique<TModuleRec>();
+  auto Rec = std::make_unique<TModuleRec>();
+  std::vector<char> Buffer(MaxSourceSize, 0);
+  TDirectiveViews Views;
+  size_t Size;
+  const char *Src = MapReadOnly(ProjectSource, &Size);
+
+  ASSERT_NE(Src, nullptr);
+  std::memcpy(Buffer.data(), ProjectSource, Size);
+  std::memset(Expected.get(), 0, sizeof(TModuleRec));
+  Expected->SourceSize = (int) Size;
+  ASSERT_TRUE(t.Compile(Expected.get(), Buffer.data(), True, True, NULL));
+
+  /*The probe leaves everything but the directive fields alone*/
+  std::memset(Rec.get(), 0xA5, sizeof(TModuleRec));
+  ASSERT_TRUE(t.ProbeDirectives(Rec.get(), Src, (int) Size, &Views));
+  EXPECT_EQ(Rec->TargetModule, Expected->TargetModule);
+  EXPECT_EQ(Rec->TargetStart, Expected->TargetStart);
+  EXPECT_EQ(Rec->LanguageVersion, Expected->LanguageVersion);
+  EXPECT_EQ(Rec->LanguageStart, Expected->LanguageStart);
+  EXPECT_EQ(std::string(Rec->Port), "COM3");
+  EXPECT_EQ(Rec->PortStart, Expected->PortStart);
+  EXPECT_EQ(std::string(Rec->ProjectFiles[0]), "Second.bse");
+  EXPECT_EQ(Rec->ProjectFilesStart[1], Expected->ProjectFilesStart[1]);
+  EXPECT_EQ(Rec->ProjectFiles[2], nullptr);
+  EXPECT_EQ(std::string(Src + Views.Port.Start, Views.Port.Length), "COM3");
+  EXPECT_EQ(Rec->EEPROM[0], 0xA5);
+  EXPECT_EQ(Rec->PacketCount, 0xA5);
+  munmap((void *) Src, Size);
+
+  /*Directive errors are found the same way*/
+  const char *Bad = "' {$STAMP BS2}\r' {$PBASIC 2.1}\rEND\r";
+  std::memcpy(Buffer.data(), Bad, std::strlen(Bad) + 1);
+  Expected->SourceSize = (int) std::strlen(Bad);
+  EXPECT_FALSE(t.Compile(Expected.get(), Buffer.data(), True, True, NULL));
+  EXPECT_FALSE(t.ProbeDirectives(Rec.get(), Bad, (int) std::strlen(Bad), NULL));
+  EXPECT_EQ(std::string(Rec->Error), std::string(Expected->Error));
+  EXPECT_EQ(Rec->ErrorStart, Expected->ErrorStart);
+}
+
+TEST(ViewTests, ProbeStopsAtCodeAfterHeader)
+{
+  tokenizer t;
+  auto Rec = std::make_unique<TModuleRec>();
+
+  /*$PORT is only looked for until the first line of code*/
+  const char *Late = "' {$STAMP BS2}\r\r' {$PBASIC 2.5}\rEND\r' {$PORT COM2}\r' {$STAMP BS2e}\r";
+  EXPECT_TRUE(t.ProbeDirectives(Rec.get(), Late, (int) std::strlen(Late), NULL));
+  EXPECT_EQ(Rec->TargetModule, tmBS2);
+  EXPECT_EQ(Rec->LanguageVersion, 250);
+  EXPECT_EQ(Rec->Port, nullptr);
+
+  /*Until $STAMP and $PBASIC are both found, code doesn't stop the search*/
+  const char *Split = "' {$STAMP BS2p}\rx VAR Byte ' {$PORT COM4}\rEND\r' {$PBASIC 2.5}\r";
+  EXPECT_TRUE(t.ProbeDirectives(Rec.get(), Split, (int) std::strlen(Split), NULL));
+  EXPECT_EQ(Rec->TargetModule, tmBS2p);
+  EXPECT_EQ(Rec->LanguageVersion, 250);
+  EXPECT_EQ(std::string(Rec->Port), "COM4");
+
+  EXPECT_TRUE(t.ProbeDirectives(Rec.get(), "", 0, NULL));
+  EXPECT_EQ(Rec->TargetModule, tmNone);
+}